@@ -0,0 +1,35 @@
+extends SceneTree
+
+# Runs SteamBenchmark and prints the results as JSON, needs a build made with
+# `scons benchmarks=yes` or CMake's STEAM_BENCHMARKS option. From the repo root:
+#   godot --headless --path demo -s benchmark/benchmark.gd -- [--iterations=N] [--packet-size=N] [--output=file.json] [names...]
+
+func _init():
+	if not ClassDB.class_exists("SteamBenchmark"):
+		printerr("SteamBenchmark is missing, rebuild with `scons benchmarks=yes` or -DSTEAM_BENCHMARKS=ON.")
+		quit(1)
+		return
+
+	var benchmark = ClassDB.instantiate("SteamBenchmark")
+	var names = PackedStringArray()
+	var output = ""
+	for arg in OS.get_cmdline_user_args():
+		if arg.begins_with("--iterations="):
+			benchmark.iterations = arg.get_slice("=", 1).to_int()
+		elif arg.begins_with("--packet-size="):
+			benchmark.packet_size = arg.get_slice("=", 1).to_int()
+		elif arg.begins_with("--lobby-count="):
+			benchmark.lobby_count = arg.get_slice("=", 1).to_int()
+		elif arg.begins_with("--output="):
+			output = arg.get_slice("=", 1)
+		else:
+			names.append(arg)
+
+	var report = benchmark.run(names)
+	report["engine"] = Engine.get_version_info()["string"]
+	var json = JSON.stringify(report, "\t")
+	print(json)
+	if output != "":
+		var file = FileAccess.open(output, FileAccess.WRITE)
+		file.store_string(json)
+	quit()
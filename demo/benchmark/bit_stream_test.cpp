@@ -0,0 +1,156 @@
+/*************************************************************************/
+/*  bit_stream_test.cpp                                                  */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+// Round-trip check for SteamBitWriter and SteamBitReader. Random sequences
+// of bit fields, varints, zig-zag values, byte runs and alignments are
+// written, read back and compared, then reading past the end has to set the
+// error flag rather than touch memory. Build it with AddressSanitizer and
+// UndefinedBehaviorSanitizer from the repo root:
+//   g++ -std=c++17 -O1 -g -fsanitize=address,undefined -fno-sanitize-recover=all -Isrc demo/benchmark/bit_stream_test.cpp src/steam_bit_stream.cpp -o bit_stream_test
+//   ./bit_stream_test
+
+#include "steam_bit_stream.h"
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#define ROUND_COUNT 2000
+
+#define CHECK(m_cond)                                                      \
+	if (!(m_cond)) {                                                       \
+		printf("FAIL: %s (line %d, round %d)\n", #m_cond, __LINE__, round); \
+		return 1;                                                          \
+	}
+
+enum OperationKind {
+	OPERATION_BITS,
+	OPERATION_VARINT,
+	OPERATION_SIGNED,
+	OPERATION_BYTES,
+	OPERATION_ALIGN,
+	OPERATION_MAX,
+};
+
+struct Operation {
+	int kind = OPERATION_BITS;
+	uint64_t value = 0;
+	int bits = 0;
+	std::vector<uint8_t> bytes;
+};
+
+int main() {
+	std::mt19937_64 random(1);
+	SteamBitWriter writer;
+	int round = 0;
+	for (round = 0; round < ROUND_COUNT; round++) {
+		writer.clear();
+		std::vector<Operation> operations(random() % 40);
+		for (size_t i = 0; i < operations.size(); i++) {
+			Operation &operation = operations[i];
+			operation.kind = random() % OPERATION_MAX;
+			operation.bits = 1 + random() % 64;
+			operation.value = random();
+			if (operation.bits < 64) {
+				operation.value &= (1ULL << operation.bits) - 1;
+			}
+			switch (operation.kind) {
+				case OPERATION_BITS:
+					writer.write_bits(operation.value, operation.bits);
+					break;
+				case OPERATION_VARINT:
+					operation.value >>= random() % 64;
+					writer.write_varint(operation.value);
+					break;
+				case OPERATION_SIGNED: {
+					uint64_t value = random() >> (random() % 64);
+					operation.value = (random() & 1) ? 0 - value : value;
+					writer.write_varint(SteamBitWriter::zigzag_encode((int64_t)operation.value));
+				} break;
+				case OPERATION_BYTES:
+					operation.bytes.resize(random() % 20);
+					for (size_t b = 0; b < operation.bytes.size(); b++) {
+						operation.bytes[b] = (uint8_t)random();
+					}
+					writer.write_bytes(operation.bytes.data(), operation.bytes.size());
+					break;
+				case OPERATION_ALIGN:
+					writer.align();
+					break;
+			}
+		}
+
+		// Read from an exactly sized copy so ASan catches any overread.
+		std::vector<uint8_t> data(writer.get_data(), writer.get_data() + writer.get_size());
+		SteamBitReader reader;
+		reader.set_data(data.data(), data.size());
+		for (size_t i = 0; i < operations.size(); i++) {
+			const Operation &operation = operations[i];
+			switch (operation.kind) {
+				case OPERATION_BITS:
+					CHECK(reader.read_bits(operation.bits) == operation.value);
+					break;
+				case OPERATION_VARINT:
+					CHECK(reader.read_varint() == operation.value);
+					break;
+				case OPERATION_SIGNED:
+					CHECK(SteamBitWriter::zigzag_decode(reader.read_varint()) == (int64_t)operation.value);
+					break;
+				case OPERATION_BYTES: {
+					std::vector<uint8_t> bytes(operation.bytes.size());
+					CHECK(reader.read_bytes(bytes.data(), bytes.size()));
+					CHECK(bytes == operation.bytes);
+				} break;
+				case OPERATION_ALIGN:
+					reader.align();
+					break;
+			}
+		}
+		CHECK(!reader.has_error());
+		CHECK(reader.get_remaining_bits() < 8);
+		reader.read_bits(9);
+		CHECK(reader.has_error());
+	}
+
+	round = -1;
+	CHECK(SteamBitWriter::quantize(-1.0f, 0.0f, 10.0f, 8) == 0);
+	CHECK(SteamBitWriter::quantize(11.0f, 0.0f, 10.0f, 8) == 255);
+	CHECK(SteamBitWriter::quantize(NAN, 0.0f, 10.0f, 8) == 0);
+	for (int bits = 1; bits <= 32; bits++) {
+		float value = SteamBitWriter::dequantize(SteamBitWriter::quantize(3.3f, -10.0f, 10.0f, bits), -10.0f, 10.0f, bits);
+		double step = 20.0 / (bits >= 32 ? 4294967295.0 : (double)((1u << bits) - 1));
+		CHECK(std::fabs(value - 3.3f) <= step / 2 + 1e-5);
+	}
+	printf("ok: %d rounds\n", ROUND_COUNT);
+	return 0;
+}
@@ -0,0 +1,95 @@
+/*************************************************************************/
+/*  mpsc_stress_test.cpp                                                 */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+// Stress test for SteamMPSCQueue, the queue behind send_p2p_packet_threaded().
+// Eight producers push into a small ring while one consumer drains it, which
+// checks every producer's values arrive once and in order. Build it with
+// ThreadSanitizer from the repo root:
+//   g++ -std=c++17 -O1 -g -fsanitize=thread -Isrc demo/benchmark/mpsc_stress_test.cpp -o mpsc_stress_test -lpthread
+//   ./mpsc_stress_test
+
+#include "steam_mpsc_queue.h"
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#define PRODUCER_COUNT 8
+#define VALUES_PER_PRODUCER 200000
+
+struct Value {
+	uint32_t producer = 0;
+	uint32_t sequence = 0;
+};
+
+int main() {
+	// Far smaller than the traffic, so producers keep wrapping the ring.
+	SteamMPSCQueue<Value> queue(1000);
+	std::vector<std::thread> producers;
+	for (uint32_t p = 0; p < PRODUCER_COUNT; p++) {
+		producers.emplace_back([&queue, p]() {
+			for (uint32_t i = 0; i < VALUES_PER_PRODUCER; i++) {
+				Value value;
+				value.producer = p;
+				value.sequence = i;
+				while (!queue.push(value)) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	std::vector<uint32_t> expected(PRODUCER_COUNT, 0);
+	uint64_t received = 0;
+	Value value;
+	while (received < (uint64_t)PRODUCER_COUNT * VALUES_PER_PRODUCER) {
+		if (!queue.pop(value)) {
+			std::this_thread::yield();
+			continue;
+		}
+		if (value.producer >= PRODUCER_COUNT || value.sequence != expected[value.producer]) {
+			printf("FAIL: producer %u sent %u, expected %u\n", value.producer, value.sequence, value.producer < PRODUCER_COUNT ? expected[value.producer] : 0);
+			return 1;
+		}
+		expected[value.producer]++;
+		received++;
+	}
+	for (size_t i = 0; i < producers.size(); i++) {
+		producers[i].join();
+	}
+	if (queue.pop(value) || queue.size() != 0) {
+		printf("FAIL: queue not empty after draining\n");
+		return 1;
+	}
+	printf("ok: %llu values from %d producers\n", (unsigned long long)received, PRODUCER_COUNT);
+	return 0;
+}
@@ -32,14 +32,23 @@
 
 #include <gdextension_interface.h>
 
+#include <godot_cpp/classes/engine.hpp>
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/core/defs.hpp>
 #include <godot_cpp/godot.hpp>
 
 #include "steam.h"
+#include "steam_benchmark.h"
+#include "steam_loopback_network.h"
+#include "steam_multiplayer_peer.h"
+#include "steam_packet_reader.h"
+#include "steam_packet_writer.h"
+#include "steam_snapshot_replicator.h"
 
 using namespace godot;
 
+static SteamRef *steam_ref = nullptr;
+
 void initialize_steam_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
@@ -47,12 +56,27 @@ void initialize_steam_module(ModuleInitializationLevel p_level) {
 
 	ClassDB::register_class<SteamRef>();
 	ClassDB::register_class<Steam>();
+	ClassDB::register_class<SteamMultiplayerPeer>();
+	ClassDB::register_class<SteamLoopbackNetwork>();
+	ClassDB::register_class<SteamSnapshotReplicator>();
+	ClassDB::register_class<SteamPacketWriter>();
+	ClassDB::register_class<SteamPacketReader>();
+#ifdef STEAM_BENCHMARKS
+	ClassDB::register_class<SteamBenchmark>();
+#endif
+
+	steam_ref = memnew(SteamRef);
+	Engine::get_singleton()->register_singleton("SteamRef", steam_ref);
 }
 
 void uninitialize_steam_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
+
+	Engine::get_singleton()->unregister_singleton("SteamRef");
+	memdelete(steam_ref);
+	steam_ref = nullptr;
 }
 
 extern "C" {
@@ -31,32 +31,257 @@
 #include "steam.h"
 
 #include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/error_macros.hpp>
 
+#include <godot_cpp/classes/engine.hpp>
 #include <godot_cpp/classes/global_constants.hpp>
 #include <godot_cpp/classes/label.hpp>
+#include <godot_cpp/classes/performance.hpp>
+#include <godot_cpp/classes/scene_tree.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 
+#include <chrono>
+#include <cstring>
+
 using namespace godot;
 
+static thread_local bool in_network_thread = false;
+
+static uint64_t get_ticks_usec() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+SteamRef *SteamRef::singleton = nullptr;
+
+void SteamRef::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_steam"), &SteamRef::get_steam);
+	ClassDB::bind_method(D_METHOD("set_pump_mode", "mode"), &SteamRef::set_pump_mode);
+	ClassDB::bind_method(D_METHOD("get_pump_mode"), &SteamRef::get_pump_mode);
+	ClassDB::bind_method(D_METHOD("set_pump_rate", "rate"), &SteamRef::set_pump_rate);
+	ClassDB::bind_method(D_METHOD("get_pump_rate"), &SteamRef::get_pump_rate);
+	ClassDB::bind_method(D_METHOD("_pump"), &SteamRef::_pump);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "pump_mode", PROPERTY_HINT_ENUM, "Manual,Process,Physics"), "set_pump_mode", "get_pump_mode");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "pump_rate"), "set_pump_rate", "get_pump_rate");
+	BIND_CONSTANT(PUMP_MANUAL);
+	BIND_CONSTANT(PUMP_PROCESS);
+	BIND_CONSTANT(PUMP_PHYSICS);
+}
+
 SteamRef::SteamRef() {
 	//UtilityFunctions::print("SteamRef created.");
+	singleton = this;
 }
 
 SteamRef::~SteamRef() {
 	//UtilityFunctions::print("SteamRef destroyed.");
+	disconnect_main_loop();
+	if (steam) {
+		memdelete(steam);
+	}
+	if (singleton == this) {
+		singleton = nullptr;
+	}
+}
+
+SteamRef *SteamRef::get_singleton() {
+	return singleton;
+}
+
+// Created on first use, by then the main loop exists and pumping can start.
+Steam *SteamRef::get_steam() {
+	if (!steam) {
+		steam = memnew(Steam);
+	}
+	connect_main_loop();
+	return steam;
+}
+
+void SteamRef::connect_main_loop() {
+	if (!steam || pump_mode == PUMP_MANUAL || !pump_signal.is_empty()) {
+		return;
+	}
+	SceneTree *tree = Object::cast_to<SceneTree>(Engine::get_singleton()->get_main_loop());
+	if (!tree) {
+		return;
+	}
+	pump_signal = pump_mode == PUMP_PHYSICS ? "physics_frame" : "process_frame";
+	tree->connect(pump_signal, Callable(this, "_pump"));
+}
+
+void SteamRef::disconnect_main_loop() {
+	if (pump_signal.is_empty()) {
+		return;
+	}
+	SceneTree *tree = Object::cast_to<SceneTree>(Engine::get_singleton()->get_main_loop());
+	if (tree && tree->is_connected(pump_signal, Callable(this, "_pump"))) {
+		tree->disconnect(pump_signal, Callable(this, "_pump"));
+	}
+	pump_signal = StringName();
+}
+
+// PUMP_MANUAL leaves calling run_callbacks() on get_steam() to the game.
+void SteamRef::set_pump_mode(int mode) {
+	ERR_FAIL_INDEX(mode, PUMP_PHYSICS + 1);
+	if (pump_mode == mode) {
+		return;
+	}
+	disconnect_main_loop();
+	pump_mode = mode;
+	connect_main_loop();
+}
+
+int SteamRef::get_pump_mode() {
+	return pump_mode;
+}
+
+// Caps pumping at `rate` runs per second regardless of frame rate, 0 runs
+// on every frame or tick.
+void SteamRef::set_pump_rate(int rate) {
+	pump_rate = MAX(rate, 0);
+	next_pump_usec = 0;
+}
+
+int SteamRef::get_pump_rate() {
+	return pump_rate;
+}
+
+void SteamRef::_pump() {
+	if (pump_rate > 0) {
+		uint64_t now = get_ticks_usec();
+		if (now < next_pump_usec) {
+			return;
+		}
+		// Keep the cadence, but don't burst to catch up after a stall.
+		uint64_t interval = 1000000 / pump_rate;
+		next_pump_usec = next_pump_usec + interval > now ? next_pump_usec + interval : now + interval;
+	}
+	steam->run_callbacks();
 }
 
 #define STEAM_LARGE_BUFFER_SIZE 8160
+// Binary lobby chat entries start with an empty string, which no text message
+// has anything after, then this marker and varint framed messages.
+#define STEAM_LOBBY_CHAT_BINARY_MARKER 0xB1
+#define STEAM_LOBBY_CHAT_HEADER_SIZE 2
+#define STEAM_LOBBY_CHAT_MAX_SIZE 4096
+
+// Column names for poll_events(), in the order queue_event() receives them.
+// Text goes in the column named by event_string_columns.
+static const char *event_names[Steam::EVENT_MAX] = {
+	"persona_state_change",
+	"lobby_created",
+	"lobby_joined",
+	"lobby_data_update",
+	"lobby_chat_update",
+	"lobby_chat_message",
+	"lobby_invite",
+	"lobby_join_requested",
+	"p2p_session_request",
+	"p2p_session_connect_fail",
+	"network_messages_session_request",
+	"network_messages_session_failed",
+	"user_stats_received",
+	"user_stats_stored",
+	"user_achievement_stored",
+};
+static const char *event_columns[Steam::EVENT_MAX][4] = {
+	{ "steam_id", "flags" },
+	{ "result", "lobby_id" },
+	{ "lobby", "permissions", "locked", "response" },
+	{ "success", "lobby_id", "member_id" },
+	{ "lobby_id", "changed_id", "making_change_id", "chat_state" },
+	{ "lobby_id", "user", "chat_type" },
+	{ "inviter", "lobby", "game" },
+	{ "lobby_id", "steam_id" },
+	{ "steam_id_remote" },
+	{ "steam_id_remote", "session_error" },
+	{ "steam_id_remote" },
+	{ "steam_id_remote", "end_reason" },
+	{ "game_id", "result", "steam_id" },
+	{ "game_id", "result" },
+	{ "game_id", "current_progress", "max_progress" },
+};
+static const char *event_string_columns[Steam::EVENT_MAX] = {
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	"message",
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	nullptr,
+	"achievement",
+};
+
+static const char *network_monitor_names[SteamNetworkStats::COUNTER_MAX] = {
+	"Steam/Packets Sent",
+	"Steam/Bytes Sent",
+	"Steam/Packets Received",
+	"Steam/Bytes Received",
+	"Steam/Send Failures",
+};
 
 void Steam::_bind_methods() {
 	// System
-	ClassDB::bind_method(D_METHOD("init"), &Steam::init);
+	ClassDB::bind_method(D_METHOD("init", "manual_dispatch"), &Steam::init, DEFVAL(false));
 	ClassDB::bind_method(D_METHOD("run_callbacks"), &Steam::run_callbacks);
+	ClassDB::bind_method(D_METHOD("start_network_thread", "rate", "channel_count"), &Steam::start_network_thread, DEFVAL(250), DEFVAL(1));
+	ClassDB::bind_method(D_METHOD("stop_network_thread"), &Steam::stop_network_thread);
+	ClassDB::bind_method(D_METHOD("is_network_thread_running"), &Steam::is_network_thread_running);
+	ClassDB::bind_method(D_METHOD("set_event_polling", "enabled"), &Steam::set_event_polling);
+	ClassDB::bind_method(D_METHOD("is_event_polling_enabled"), &Steam::is_event_polling_enabled);
+	ClassDB::bind_method(D_METHOD("poll_events"), &Steam::poll_events);
+	ClassDB::bind_method(D_METHOD("use_loopback_backend", "network", "steam_id"), &Steam::use_loopback_backend);
+	ClassDB::bind_method(D_METHOD("use_steamworks_backend"), &Steam::use_steamworks_backend);
+	ClassDB::bind_method(D_METHOD("is_using_loopback_backend"), &Steam::is_using_loopback_backend);
+	ClassDB::bind_method(D_METHOD("get_network_stats"), &Steam::get_network_stats);
+	ClassDB::bind_method(D_METHOD("reset_network_stats"), &Steam::reset_network_stats);
+	ClassDB::bind_method(D_METHOD("set_network_stats_enabled", "enabled"), &Steam::set_network_stats_enabled);
+	ClassDB::bind_method(D_METHOD("is_network_stats_enabled"), &Steam::is_network_stats_enabled);
+	ClassDB::bind_method(D_METHOD("add_network_monitors"), &Steam::add_network_monitors);
+	ClassDB::bind_method(D_METHOD("remove_network_monitors"), &Steam::remove_network_monitors);
+	ClassDB::bind_method(D_METHOD("_get_network_monitor", "counter"), &Steam::_get_network_monitor);
 
 	// User
 	ClassDB::bind_method(D_METHOD("get_steam_id"), &Steam::get_steam_id);
 	ClassDB::bind_method(D_METHOD("get_persona_name"), &Steam::get_persona_name);
 	ClassDB::bind_method(D_METHOD("get_friend_persona_name", "steam_id"), &Steam::get_friend_persona_name);
+	ClassDB::bind_method(D_METHOD("request_persona_names", "steam_ids"), &Steam::request_persona_names);
+	ClassDB::bind_method(D_METHOD("clear_persona_cache"), &Steam::clear_persona_cache);
+	ADD_SIGNAL(MethodInfo("persona_state_change", PropertyInfo(Variant::INT, "steam_id"), PropertyInfo(Variant::INT, "flags")));
+
+	// User stats
+	ClassDB::bind_method(D_METHOD("request_current_stats"), &Steam::request_current_stats);
+	ClassDB::bind_method(D_METHOD("are_stats_loaded"), &Steam::are_stats_loaded);
+	ClassDB::bind_method(D_METHOD("set_stat_int", "name", "value"), &Steam::set_stat_int);
+	ClassDB::bind_method(D_METHOD("set_stat_float", "name", "value"), &Steam::set_stat_float);
+	ClassDB::bind_method(D_METHOD("add_stat_int", "name", "delta"), &Steam::add_stat_int);
+	ClassDB::bind_method(D_METHOD("add_stat_float", "name", "delta"), &Steam::add_stat_float);
+	ClassDB::bind_method(D_METHOD("get_stat_int", "name"), &Steam::get_stat_int);
+	ClassDB::bind_method(D_METHOD("get_stat_float", "name"), &Steam::get_stat_float);
+	ClassDB::bind_method(D_METHOD("set_achievement", "name"), &Steam::set_achievement);
+	ClassDB::bind_method(D_METHOD("clear_achievement", "name"), &Steam::clear_achievement);
+	ClassDB::bind_method(D_METHOD("get_achievement", "name"), &Steam::get_achievement);
+	ClassDB::bind_method(D_METHOD("store_stats"), &Steam::store_stats);
+	ClassDB::bind_method(D_METHOD("set_stats_store_interval", "interval_msec"), &Steam::set_stats_store_interval);
+	ClassDB::bind_method(D_METHOD("get_stats_store_interval"), &Steam::get_stats_store_interval);
+	ClassDB::bind_method(D_METHOD("has_pending_stats"), &Steam::has_pending_stats);
+	ADD_SIGNAL(MethodInfo("user_stats_received", PropertyInfo(Variant::INT, "game_id"), PropertyInfo(Variant::INT, "result"), PropertyInfo(Variant::INT, "steam_id")));
+	ADD_SIGNAL(MethodInfo("user_stats_stored", PropertyInfo(Variant::INT, "game_id"), PropertyInfo(Variant::INT, "result")));
+	ADD_SIGNAL(MethodInfo("user_achievement_stored", PropertyInfo(Variant::INT, "game_id"), PropertyInfo(Variant::STRING, "achievement"), PropertyInfo(Variant::INT, "current_progress"), PropertyInfo(Variant::INT, "max_progress")));
+
+	// Cloud saves
+	ClassDB::bind_method(D_METHOD("write_cloud_file_async", "file_name", "data", "compress"), &Steam::write_cloud_file_async, DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("read_cloud_file_async", "file_name"), &Steam::read_cloud_file_async);
+	ClassDB::bind_method(D_METHOD("get_pending_cloud_requests"), &Steam::get_pending_cloud_requests);
+	ADD_SIGNAL(MethodInfo("cloud_file_written", PropertyInfo(Variant::INT, "request_id"), PropertyInfo(Variant::STRING, "file_name"), PropertyInfo(Variant::INT, "result")));
+	ADD_SIGNAL(MethodInfo("cloud_file_read", PropertyInfo(Variant::INT, "request_id"), PropertyInfo(Variant::STRING, "file_name"), PropertyInfo(Variant::INT, "result"), PropertyInfo(Variant::PACKED_BYTE_ARRAY, "data")));
 
 	// Lobby
 	ClassDB::bind_method(D_METHOD("create_lobby", "lobby_type", "max_members"), &Steam::create_lobby, DEFVAL(2));
@@ -69,6 +294,9 @@ void Steam::_bind_methods() {
 	ADD_SIGNAL(MethodInfo("lobby_match_list", PropertyInfo(Variant::ARRAY, "lobbies")));
 	ClassDB::bind_method(D_METHOD("add_request_lobby_list_string_filter", "key_to_match", "value_to_match", "comparison_type"), &Steam::add_request_lobby_list_string_filter);
 	ClassDB::bind_method(D_METHOD("add_request_lobby_list_distance_filter", "distance_filter"), &Steam::add_request_lobby_list_distance_filter);
+	ClassDB::bind_method(D_METHOD("request_lobby_search", "data_keys", "max_age_msec"), &Steam::request_lobby_search, DEFVAL(5000));
+	ClassDB::bind_method(D_METHOD("clear_lobby_search_cache"), &Steam::clear_lobby_search_cache);
+	ADD_SIGNAL(MethodInfo("lobby_search_result", PropertyInfo(Variant::DICTIONARY, "result")));
 	ADD_SIGNAL(MethodInfo("lobby_data_update", PropertyInfo(Variant::INT, "success"), PropertyInfo(Variant::INT, "lobby_id"), PropertyInfo(Variant::INT, "member_id")));
 	ADD_SIGNAL(MethodInfo("lobby_chat_update", PropertyInfo(Variant::INT, "lobby_id"), PropertyInfo(Variant::INT, "changed_id"), PropertyInfo(Variant::INT, "making_change_id"), PropertyInfo(Variant::INT, "chat_state")));
 	ADD_SIGNAL(MethodInfo("lobby_chat_message", PropertyInfo(Variant::INT, "lobby_id"), PropertyInfo(Variant::INT, "user"), PropertyInfo(Variant::STRING, "message"), PropertyInfo(Variant::INT, "chat_type")));
@@ -77,7 +305,14 @@ void Steam::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_lobby_owner", "steam_lobby_id"), &Steam::get_lobby_owner);
 	ClassDB::bind_method(D_METHOD("get_num_lobby_members", "steam_lobby_id"), &Steam::get_num_lobby_members);
 	ClassDB::bind_method(D_METHOD("get_lobby_member_by_index", "steam_lobby_id", "member"), &Steam::get_lobby_member_by_index);
+	ClassDB::bind_method(D_METHOD("get_lobby_members", "steam_lobby_id"), &Steam::get_lobby_members);
 	ClassDB::bind_method(D_METHOD("send_lobby_chat_message", "steam_lobby_id", "message_body"), &Steam::send_lobby_chat_message);
+	ClassDB::bind_method(D_METHOD("send_lobby_chat_bytes", "steam_lobby_id", "data"), &Steam::send_lobby_chat_bytes);
+	ClassDB::bind_method(D_METHOD("flush_lobby_chat"), &Steam::flush_lobby_chat);
+	ClassDB::bind_method(D_METHOD("set_lobby_chat_rate", "messages_per_second", "burst"), &Steam::set_lobby_chat_rate, DEFVAL(4.0));
+	ClassDB::bind_method(D_METHOD("get_lobby_chat_rate"), &Steam::get_lobby_chat_rate);
+	ClassDB::bind_method(D_METHOD("get_lobby_chat_queue_size"), &Steam::get_lobby_chat_queue_size);
+	ADD_SIGNAL(MethodInfo("lobby_chat_bytes", PropertyInfo(Variant::INT, "lobby_id"), PropertyInfo(Variant::INT, "user"), PropertyInfo(Variant::PACKED_BYTE_ARRAY, "data")));
 
 	// P2P
 	ClassDB::bind_method(D_METHOD("accept_p2p_session_with_user", "steam_id_remote"), &Steam::accept_p2p_session_with_user);
@@ -85,29 +320,78 @@ void Steam::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("close_p2p_session_with_user", "steam_id_remote"), &Steam::close_p2p_session_with_user);
 	ClassDB::bind_method(D_METHOD("get_available_p2p_packet_size", "channel"), &Steam::get_available_p2p_packet_size, DEFVAL(0));
 	ClassDB::bind_method(D_METHOD("read_p2p_packet", "packet", "channel"), &Steam::read_p2p_packet, DEFVAL(0));
-	ClassDB::bind_method(D_METHOD("send_p2p_packet", "steam_id_remote", "data", "send_type", "channel"), &Steam::send_p2p_packet, DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("read_p2p_packets", "channel", "max_packets"), &Steam::read_p2p_packets, DEFVAL(0), DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("set_p2p_receive_pool", "buffer_count", "max_packet_size"), &Steam::set_p2p_receive_pool, DEFVAL(1200));
+	ClassDB::bind_method(D_METHOD("read_p2p_packet_pooled", "channel"), &Steam::read_p2p_packet_pooled, DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("get_pooled_packet_data", "handle"), &Steam::get_pooled_packet_data);
+	ClassDB::bind_method(D_METHOD("get_pooled_packet_size", "handle"), &Steam::get_pooled_packet_size);
+	ClassDB::bind_method(D_METHOD("get_pooled_packet_sender", "handle"), &Steam::get_pooled_packet_sender);
+	ClassDB::bind_method(D_METHOD("release_pooled_packet", "handle"), &Steam::release_pooled_packet);
+	ClassDB::bind_method(D_METHOD("set_p2p_coalescing", "enabled", "max_packet_size"), &Steam::set_p2p_coalescing, DEFVAL(1200));
+	ClassDB::bind_method(D_METHOD("is_p2p_coalescing_enabled"), &Steam::is_p2p_coalescing_enabled);
+	ClassDB::bind_method(D_METHOD("flush_p2p_packets"), &Steam::flush_p2p_packets);
+	ClassDB::bind_method(D_METHOD("set_p2p_fragmentation", "enabled", "max_packet_size", "timeout_msec", "max_message_size"), &Steam::set_p2p_fragmentation, DEFVAL(1200), DEFVAL(500), DEFVAL(1048576));
+	ClassDB::bind_method(D_METHOD("is_p2p_fragmentation_enabled"), &Steam::is_p2p_fragmentation_enabled);
+	ClassDB::bind_method(D_METHOD("set_p2p_send_scheduler", "enabled", "bytes_per_second", "burst_bytes"), &Steam::set_p2p_send_scheduler, DEFVAL(65536), DEFVAL(16384));
+	ClassDB::bind_method(D_METHOD("is_p2p_send_scheduler_enabled"), &Steam::is_p2p_send_scheduler_enabled);
+	ClassDB::bind_method(D_METHOD("set_p2p_send_scheduler_limits", "aging_msec", "max_unreliable_age_msec", "max_queued_bytes"), &Steam::set_p2p_send_scheduler_limits, DEFVAL(50), DEFVAL(200), DEFVAL(262144));
+	ClassDB::bind_method(D_METHOD("set_p2p_peer_bandwidth", "steam_id_remote", "bytes_per_second", "burst_bytes"), &Steam::set_p2p_peer_bandwidth, DEFVAL(16384));
+	ClassDB::bind_method(D_METHOD("send_p2p_packet", "steam_id_remote", "data", "send_type", "channel", "priority"), &Steam::send_p2p_packet, DEFVAL(0), DEFVAL(P2P_PRIORITY_NORMAL));
+	ClassDB::bind_method(D_METHOD("send_p2p_writer", "steam_id_remote", "writer", "send_type", "channel", "priority"), &Steam::send_p2p_writer, DEFVAL(0), DEFVAL(P2P_PRIORITY_NORMAL));
+	ClassDB::bind_method(D_METHOD("read_p2p_packet_into", "reader", "channel"), &Steam::read_p2p_packet_into, DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("send_p2p_packet_threaded", "steam_id_remote", "data", "send_type", "channel", "priority"), &Steam::send_p2p_packet_threaded, DEFVAL(0), DEFVAL(P2P_PRIORITY_NORMAL));
+	ClassDB::bind_method(D_METHOD("get_threaded_send_capacity"), &Steam::get_threaded_send_capacity);
+	ClassDB::bind_method(D_METHOD("start_p2p_capture", "path"), &Steam::start_p2p_capture);
+	ClassDB::bind_method(D_METHOD("stop_p2p_capture"), &Steam::stop_p2p_capture);
+	ClassDB::bind_method(D_METHOD("is_p2p_capturing"), &Steam::is_p2p_capturing);
+	ClassDB::bind_method(D_METHOD("start_p2p_replay", "path", "speed"), &Steam::start_p2p_replay, DEFVAL(1.0));
+	ClassDB::bind_method(D_METHOD("stop_p2p_replay"), &Steam::stop_p2p_replay);
+	ClassDB::bind_method(D_METHOD("is_p2p_replaying"), &Steam::is_p2p_replaying);
+	ClassDB::bind_method(D_METHOD("get_p2p_replay_remaining"), &Steam::get_p2p_replay_remaining);
+	ADD_SIGNAL(MethodInfo("p2p_replay_finished"));
+	BIND_CONSTANT(P2P_PRIORITY_CRITICAL);
+	BIND_CONSTANT(P2P_PRIORITY_HIGH);
+	BIND_CONSTANT(P2P_PRIORITY_NORMAL);
+	BIND_CONSTANT(P2P_PRIORITY_LOW);
 	ADD_SIGNAL(MethodInfo("p2p_session_request", PropertyInfo(Variant::INT, "steam_id_remote")));
 	ADD_SIGNAL(MethodInfo("p2p_session_connect_fail", PropertyInfo(Variant::INT, "steam_id_remote"), PropertyInfo(Variant::INT, "session_error")));
+
+	// Networking messages
+	ClassDB::bind_method(D_METHOD("accept_session_with_user", "steam_id_remote"), &Steam::accept_session_with_user);
+	ClassDB::bind_method(D_METHOD("close_session_with_user", "steam_id_remote"), &Steam::close_session_with_user);
+	ClassDB::bind_method(D_METHOD("send_message_to_user", "steam_id_remote", "data", "flags", "channel"), &Steam::send_message_to_user, DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("send_messages_to_user", "steam_id_remote", "data", "sizes", "flags", "channel"), &Steam::send_messages_to_user, DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("receive_messages_on_channel", "channel", "max_messages"), &Steam::receive_messages_on_channel, DEFVAL(0), DEFVAL(32));
+	ADD_SIGNAL(MethodInfo("network_messages_session_request", PropertyInfo(Variant::INT, "steam_id_remote")));
+	ADD_SIGNAL(MethodInfo("network_messages_session_failed", PropertyInfo(Variant::INT, "steam_id_remote"), PropertyInfo(Variant::INT, "end_reason")));
 }
 
-Steam::Steam() :
-	callbackLobbyMatchList(this, &Steam::lobby_match_list),
-	callbackLobbyCreated(this, &Steam::lobby_created),
-	callbackLobbyJoined(this, &Steam::lobby_joined),
-	callbackLobbyDataUpdate(this, &Steam::lobby_data_update),
-	callbackLobbyChatUpdate(this, &Steam::lobby_chat_update),
-	callbackLobbyMessage(this, &Steam::lobby_chat_message),
-	callbackLobbyInvite(this, &Steam::lobby_invite),
-	callbackLobbyJoinRequested(this, &Steam::lobby_join_requested),
-	
-	callbackP2PSessionRequest(this, &Steam::p2p_session_request),
-	callbackP2PSessionConnectFail(this, &Steam::p2p_session_connect_fail)
-{
+Steam::Steam() {
 	//UtilityFunctions::print("Constructor.");
+	backend = SteamworksBackend::get_singleton();
+	send_coalescer.set_send_func(&Steam::send_coalesced_batch, this);
+	send_scheduler.set_send_func(&Steam::send_scheduled_message, this);
+	fragment_reassembler.set_pool(&receive_pool);
+	threaded_sends.reset(new SteamMPSCQueue<ThreadedSend>(STEAM_THREADED_SEND_CAPACITY));
+	// Handlers defer their signals when they run on the network thread.
+	SteamworksBackend::get_singleton()->add_sink(this, true);
 }
 
 Steam::~Steam() {
 	//UtilityFunctions::print("Destructor.");
+	// Last chance for pending stats, the store interval could lose a minute.
+	flush_user_stats(true);
+	stop_network_thread();
+	cloud_streamer.stop();
+	SteamworksBackend::get_singleton()->remove_sink(this);
+	detach_loopback_backend();
+	remove_network_monitors();
+}
+
+void Steam::_notification(int p_what) {
+	if (p_what == NOTIFICATION_WM_CLOSE_REQUEST) {
+		flush_user_stats(true);
+	}
 }
 
 // Internal
@@ -120,268 +404,2060 @@ CSteamID Steam::createSteamID(uint64_t steam_id, int account_type){
 	return converted_steam_id;
 }
 
-// System
-bool Steam::init() {
-	return SteamAPI_Init();
+// Callbacks that do nothing but raise a signal or a polled event. The others
+// also keep caches (persona names, lobby members, lobby searches) up to date
+// and always run.
+struct CallbackSubscription {
+	int callback;
+	const char *signals[2];
+};
+
+static const CallbackSubscription callback_subscriptions[] = {
+	{ LobbyCreated_t::k_iCallback, { "lobby_created" } },
+	{ LobbyDataUpdate_t::k_iCallback, { "lobby_data_update" } },
+	{ LobbyChatMsg_t::k_iCallback, { "lobby_chat_message", "lobby_chat_bytes" } },
+	{ LobbyInvite_t::k_iCallback, { "lobby_invite" } },
+	{ GameLobbyJoinRequested_t::k_iCallback, { "lobby_join_requested" } },
+	{ P2PSessionRequest_t::k_iCallback, { "p2p_session_request" } },
+	{ P2PSessionConnectFail_t::k_iCallback, { "p2p_session_connect_fail" } },
+	{ SteamNetworkingMessagesSessionRequest_t::k_iCallback, { "network_messages_session_request" } },
+	{ SteamNetworkingMessagesSessionFailed_t::k_iCallback, { "network_messages_session_failed" } },
+	{ UserAchievementStored_t::k_iCallback, { "user_achievement_stored" } },
+};
+
+// Whether anything would see the callback. Connections are looked up the
+// first time a callback type arrives in a pump and reused for the rest of it.
+// Polling and the network thread get everything, as polled events don't
+// need signals and connection lists belong to the main thread.
+bool Steam::is_callback_subscribed(int callback){
+	static_assert(sizeof(callback_subscriptions) / sizeof(callback_subscriptions[0]) == CALLBACK_SUBSCRIPTION_MAX, "Update CALLBACK_SUBSCRIPTION_MAX.");
+	for (int i = 0; i < CALLBACK_SUBSCRIPTION_MAX; i++) {
+		const CallbackSubscription &subscription = callback_subscriptions[i];
+		if (subscription.callback != callback) {
+			continue;
+		}
+		if (event_polling.load(std::memory_order_acquire) || is_network_thread()) {
+			return true;
+		}
+		if (subscription_checked[i] != callback_pump) {
+			subscription_checked[i] = callback_pump;
+			subscription_connected[i] = false;
+			for (int s = 0; s < 2 && subscription.signals[s]; s++) {
+				if (!get_signal_connection_list(subscription.signals[s]).is_empty()) {
+					subscription_connected[i] = true;
+					break;
+				}
+			}
+		}
+		return subscription_connected[i];
+	}
+	return true;
 }
 
-void Steam::run_callbacks() {
-	SteamAPI_RunCallbacks();
+// Every backend delivers its callbacks here.
+void Steam::dispatch_callback(int callback, void *data){
+	if (!is_callback_subscribed(callback)) {
+		return;
+	}
+	switch (callback) {
+		case PersonaStateChange_t::k_iCallback:
+			persona_state_change((PersonaStateChange_t *)data);
+			break;
+		case LobbyMatchList_t::k_iCallback:
+			lobby_match_list((LobbyMatchList_t *)data);
+			break;
+		case LobbyCreated_t::k_iCallback:
+			lobby_created((LobbyCreated_t *)data);
+			break;
+		case LobbyEnter_t::k_iCallback:
+			lobby_joined((LobbyEnter_t *)data);
+			break;
+		case LobbyDataUpdate_t::k_iCallback:
+			lobby_data_update((LobbyDataUpdate_t *)data);
+			break;
+		case LobbyChatUpdate_t::k_iCallback:
+			lobby_chat_update((LobbyChatUpdate_t *)data);
+			break;
+		case LobbyChatMsg_t::k_iCallback:
+			lobby_chat_message((LobbyChatMsg_t *)data);
+			break;
+		case LobbyInvite_t::k_iCallback:
+			lobby_invite((LobbyInvite_t *)data);
+			break;
+		case GameLobbyJoinRequested_t::k_iCallback:
+			lobby_join_requested((GameLobbyJoinRequested_t *)data);
+			break;
+		case P2PSessionRequest_t::k_iCallback:
+			p2p_session_request((P2PSessionRequest_t *)data);
+			break;
+		case P2PSessionConnectFail_t::k_iCallback:
+			p2p_session_connect_fail((P2PSessionConnectFail_t *)data);
+			break;
+		case SteamNetworkingMessagesSessionRequest_t::k_iCallback:
+			network_messages_session_request((SteamNetworkingMessagesSessionRequest_t *)data);
+			break;
+		case SteamNetworkingMessagesSessionFailed_t::k_iCallback:
+			network_messages_session_failed((SteamNetworkingMessagesSessionFailed_t *)data);
+			break;
+		case UserStatsReceived_t::k_iCallback:
+			user_stats_received((UserStatsReceived_t *)data);
+			break;
+		case UserStatsStored_t::k_iCallback:
+			user_stats_stored((UserStatsStored_t *)data);
+			break;
+		case UserAchievementStored_t::k_iCallback:
+			user_achievement_stored((UserAchievementStored_t *)data);
+			break;
+		default:
+			break;
+	}
 }
 
-// User
-uint64_t Steam::get_steam_id(){
-	if(SteamUser() == NULL){
-		return 0;
+// Cloud reads are the only call results waited on, they may arrive on the
+// network thread.
+void Steam::dispatch_call_result(uint64_t call, int callback, void *data, bool io_failure){
+	if (callback == RemoteStorageFileReadAsyncComplete_t::k_iCallback) {
+		cloud_streamer.complete_read(call, data, io_failure);
 	}
-	CSteamID steam_id = SteamUser()->GetSteamID();
-	return steam_id.ConvertToUint64();
 }
 
-String Steam::get_persona_name(){
-	if(SteamFriends() == NULL){
-		return "";
+// System
+// `manual_dispatch` hands Steam's callback pipe to this extension for the
+// whole process, which lets the network thread run callbacks. Any other
+// Steam code in the process (STEAM_CALLBACK, CCallResult,
+// SteamAPI_RunCallbacks()) stops working though, so leave it off when
+// another plugin talks to Steam.
+bool Steam::init(bool manual_dispatch) {
+	ERR_FAIL_COND_V_MSG(manual_dispatch && network_thread_active.load(std::memory_order_acquire), false, "Manual dispatch can't be enabled while the network thread is running.");
+	if (!SteamAPI_Init()) {
+		return false;
 	}
-	return String::utf8(SteamFriends()->GetPersonaName());
+	if (manual_dispatch) {
+		SteamworksBackend::get_singleton()->init_manual_dispatch();
+	}
+	return true;
 }
 
-String Steam::get_friend_persona_name(uint64_t steam_id){
-	if(SteamFriends() != NULL && steam_id > 0){
-		CSteamID user_id = (uint64)steam_id;
-		bool is_data_loading = SteamFriends()->RequestUserInformation(user_id, true);
-		if(!is_data_loading){
-			return String::utf8(SteamFriends()->GetFriendPersonaName(user_id));
+void Steam::run_callbacks() {
+	flush_p2p_packets();
+	flush_lobby_chat();
+	flush_user_stats(false);
+	flush_cloud_results();
+	callback_pump++;
+	if (traffic_replay.is_active() && traffic_replay.get_remaining() == 0) {
+		stop_p2p_replay();
+		emit_signal("p2p_replay_finished");
+	}
+	if (loopback_endpoint) {
+		// The loopback only stands in for networking and lobbies, stats and
+		// cloud results still come from Steam itself.
+		SteamworksBackend::get_singleton()->run_callbacks(true);
+	}
+	// The network thread owns callback dispatch while it runs, if the backend
+	// allows it. Callbacks for main thread sinks are handed over here.
+	if (network_thread_active.load(std::memory_order_acquire) && backend->can_run_callbacks_off_main_thread()) {
+		backend->dispatch_deferred();
+		return;
+	}
+	backend->run_callbacks(true);
+}
+
+// Drains P2P channels [0, channel_count) on a dedicated thread at `rate`
+// ticks per second. Received packets are parked in the receive pool and the
+// regular read functions pick them up from there. With manual dispatch or
+// the loopback backend callbacks run there too, main thread only sinks such
+// as SteamMultiplayerPeer still get theirs from run_callbacks().
+// `rate` is capped at 1000, past that the loop would just spin.
+bool Steam::start_network_thread(int rate, int channel_count){
+	if (network_thread_active.load(std::memory_order_acquire) || rate <= 0 || channel_count <= 0) {
+		return false;
+	}
+	ERR_FAIL_COND_V_MSG(traffic_replay.is_active(), false, "The network thread can't run during a replay.");
+	if (!receive_pool.is_configured()) {
+		receive_pool.configure(256, 1200);
+	}
+	int buffer_count = receive_pool.get_buffer_count();
+	network_thread_free.reset(new SteamSPSCQueue<int>(buffer_count));
+	network_thread_received.clear();
+	for (int i = 0; i < channel_count; i++) {
+		network_thread_received.emplace_back(new SteamSPSCQueue<int>(buffer_count));
+	}
+	// Keep a quarter of the buffers, at least one, on the main thread for
+	// coalesced pooled reads.
+	for (int i = buffer_count - MAX(1, buffer_count / 4); i > 0; i--) {
+		int handle = receive_pool.detach();
+		if (handle < 0) {
+			break;
+		}
+		network_thread_free->push(handle);
+	}
+	network_thread_rate = MIN(rate, 1000);
+	network_thread_spare = -1;
+	network_thread_active.store(true, std::memory_order_release);
+	network_thread = std::thread(&Steam::network_thread_loop, this);
+	return true;
+}
+
+// Pending packets that were not read yet are discarded.
+void Steam::stop_network_thread(){
+	if (!network_thread_active.load(std::memory_order_acquire)) {
+		return;
+	}
+	network_thread_active.store(false, std::memory_order_release);
+	network_thread.join();
+	reset_p2p_receive_cursors();
+	int handle;
+	if (network_thread_spare >= 0) {
+		receive_pool.attach(network_thread_spare);
+		network_thread_spare = -1;
+	}
+	while (network_thread_free->pop(handle)) {
+		receive_pool.attach(handle);
+	}
+	for (size_t i = 0; i < network_thread_received.size(); i++) {
+		while (network_thread_received[i]->pop(handle)) {
+			receive_pool.attach(handle);
 		}
 	}
-	return "";
+	network_thread_received.clear();
+	network_thread_free.reset();
 }
 
+bool Steam::is_network_thread_running(){
+	return network_thread_active.load(std::memory_order_acquire);
+}
 
-// Lobby
-void Steam::create_lobby(int lobby_type, int max_members){
-	if(SteamMatchmaking() != NULL){
-		SteamMatchmaking()->CreateLobby((ELobbyType)lobby_type, max_members);
+// Backend
+// Routes P2P, lobbies and get_steam_id() through a simulated user on
+// `network` instead of the Steam client, so many Steam objects in one
+// process can talk to each other without Steam running. Friends and persona
+// names still come from Steam.
+bool Steam::use_loopback_backend(const Ref<SteamLoopbackNetwork>& network, uint64_t steam_id){
+	ERR_FAIL_COND_V_MSG(network.is_null(), false, "A SteamLoopbackNetwork is required.");
+	ERR_FAIL_COND_V_MSG(network_thread_active.load(std::memory_order_acquire), false, "The backend can't be changed while the network thread is running.");
+	detach_loopback_backend();
+	loopback_network = network;
+	loopback_endpoint = network->get_endpoint(steam_id);
+	loopback_endpoint->add_sink(this, true);
+	backend = loopback_endpoint;
+	return true;
+}
+
+void Steam::use_steamworks_backend(){
+	ERR_FAIL_COND_MSG(network_thread_active.load(std::memory_order_acquire), "The backend can't be changed while the network thread is running.");
+	detach_loopback_backend();
+}
+
+bool Steam::is_using_loopback_backend(){
+	return loopback_endpoint != nullptr;
+}
+
+// Network stats
+// Counted per remote Steam ID and channel at the wire level, so coalesced
+// batches and fragments count as the packets Steam actually carries. The
+// snapshot also holds the current queue depths:
+// "receive_queue" (per channel, only while the network thread runs),
+// "pooled_packets" (receive buffers held by the game) and
+// "send_queue" (coalesced bytes not flushed yet),
+// "scheduled_bytes" (bytes held back by the send scheduler) and
+// "scheduler_dropped" (unreliable messages the scheduler dropped),
+// "scheduler_failed" (messages Steam rejected that the scheduler gave up on) and
+// "threaded_send_queue" (sends from other threads not drained yet).
+Dictionary Steam::get_network_stats(){
+	Dictionary stats = network_stats.get_snapshot();
+	PackedInt32Array receive_queue;
+	for (size_t i = 0; i < network_thread_received.size(); i++) {
+		receive_queue.append(network_thread_received[i]->size());
 	}
+	stats["receive_queue"] = receive_queue;
+	stats["pooled_packets"] = receive_pool.get_buffer_count() - receive_pool.get_free_count();
+	stats["send_queue"] = (int64_t)send_coalescer.get_pending_bytes();
+	stats["scheduled_bytes"] = (int64_t)send_scheduler.get_queued_bytes();
+	stats["scheduler_dropped"] = (int64_t)send_scheduler.get_dropped_count();
+	stats["scheduler_failed"] = (int64_t)send_scheduler.get_failed_count();
+	stats["threaded_send_queue"] = (int64_t)threaded_sends->size();
+	return stats;
 }
-void Steam::lobby_created(LobbyCreated_t *lobbyData){
-	int result = lobbyData->m_eResult;
-	CSteamID lobby_id = lobbyData->m_ulSteamIDLobby;
-	uint64_t lobby = lobby_id.ConvertToUint64();
-	emit_signal("lobby_created", result, lobby);
+
+void Steam::reset_network_stats(){
+	network_stats.reset();
 }
 
-bool Steam::set_lobby_data(uint64_t steam_lobby_id, const String& key, const String& value){
-	if(SteamMatchmaking() == NULL){
-		return false;
+void Steam::set_network_stats_enabled(bool enabled){
+	network_stats.set_enabled(enabled);
+}
+
+bool Steam::is_network_stats_enabled(){
+	return network_stats.is_enabled();
+}
+
+// Registers the totals under "Steam/" in the debugger's monitors.
+void Steam::add_network_monitors(){
+	Performance *performance = Performance::get_singleton();
+	for (int i = 0; i < SteamNetworkStats::COUNTER_MAX; i++) {
+		if (!performance->has_custom_monitor(network_monitor_names[i])) {
+			Array arguments;
+			arguments.append(i);
+			performance->add_custom_monitor(network_monitor_names[i], Callable(this, "_get_network_monitor"), arguments);
+		}
 	}
-	CSteamID lobby_id = (uint64)steam_lobby_id;
-	return SteamMatchmaking()->SetLobbyData(lobby_id, key.utf8().get_data(), value.utf8().get_data());
+	network_monitors = true;
 }
 
-void Steam::join_lobby(uint64_t steam_lobby_id){
-	if(SteamMatchmaking() != NULL){
-		CSteamID lobby_id = (uint64)steam_lobby_id;
-		SteamMatchmaking()->JoinLobby(lobby_id);
+void Steam::remove_network_monitors(){
+	if (!network_monitors) {
+		return;
+	}
+	Performance *performance = Performance::get_singleton();
+	for (int i = 0; i < SteamNetworkStats::COUNTER_MAX; i++) {
+		if (performance->has_custom_monitor(network_monitor_names[i])) {
+			performance->remove_custom_monitor(network_monitor_names[i]);
+		}
 	}
+	network_monitors = false;
 }
-void Steam::lobby_joined(LobbyEnter_t* lobbyData){
-	CSteamID steam_lobby_id = lobbyData->m_ulSteamIDLobby;
-	uint64_t lobby_id = steam_lobby_id.ConvertToUint64();
-	uint32_t permissions = lobbyData->m_rgfChatPermissions;
-	bool locked = lobbyData->m_bLocked;
-	uint32_t response = lobbyData->m_EChatRoomEnterResponse;
-	emit_signal("lobby_joined", lobby_id, permissions, locked, response);
+
+int64_t Steam::_get_network_monitor(int counter){
+	ERR_FAIL_INDEX_V(counter, SteamNetworkStats::COUNTER_MAX, 0);
+	return network_stats.get_total((SteamNetworkStats::Counter)counter);
 }
 
-void Steam::leave_lobby(uint64_t steam_lobby_id){
-	if(SteamMatchmaking() != NULL){
-		CSteamID lobby_id = (uint64)steam_lobby_id;
-		SteamMatchmaking()->LeaveLobby(lobby_id);
+// Sends what is still queued on the old backend and drops state that
+// belongs to it.
+void Steam::detach_loopback_backend(){
+	flush_threaded_sends();
+	send_scheduler.drain(get_ticks_usec());
+	send_scheduler.clear();
+	flush_p2p_packets();
+	reset_p2p_receive_cursors();
+	fragment_reassembler.clear();
+	{
+		std::lock_guard<std::mutex> lock(lobby_members_mutex);
+		lobby_members.clear();
+	}
+	{
+		std::lock_guard<std::mutex> lock(lobby_search_mutex);
+		lobby_searches.clear();
+		lobby_search_cache.clear();
 	}
+	if (loopback_endpoint) {
+		loopback_endpoint->remove_sink(this);
+		loopback_endpoint = nullptr;
+	}
+	loopback_network.unref();
+	backend = SteamworksBackend::get_singleton();
 }
 
-void Steam::request_lobby_list(){
-	if(SteamMatchmaking() != NULL){
-		SteamMatchmaking()->RequestLobbyList();
+// Event polling
+// While enabled, callbacks append their values to a per type column buffer
+// instead of emitting signals, and poll_events() hands everything queued
+// since the last poll over at once. lobby_match_list and lobby_search_result
+// are rare and structured, they keep using signals.
+void Steam::set_event_polling(bool enabled){
+	event_polling.store(enabled, std::memory_order_release);
+	if (!enabled) {
+		std::lock_guard<std::mutex> lock(event_mutex);
+		for (int i = 0; i < EVENT_MAX; i++) {
+			queued_events[i].values.clear();
+			queued_events[i].strings.clear();
+			queued_events[i].count = 0;
+		}
 	}
 }
 
-void Steam::lobby_match_list(LobbyMatchList_t *call_data){
-	int lobby_count = call_data->m_nLobbiesMatching;
-	Array lobbies;
-	for(int i = 0; i < lobby_count; i++){
-		CSteamID lobby_id = SteamMatchmaking()->GetLobbyByIndex(i);
-		uint64_t lobby = lobby_id.ConvertToUint64();
-		lobbies.append(lobby);
-	}
-	emit_signal("lobby_match_list", lobbies);
+bool Steam::is_event_polling_enabled(){
+	return event_polling.load(std::memory_order_acquire);
 }
 
-void Steam::add_request_lobby_list_string_filter(const String& key_to_match, const String& value_to_match, int comparison_type){
-	if(SteamMatchmaking() != NULL){
-		SteamMatchmaking()->AddRequestLobbyListStringFilter(key_to_match.utf8().get_data(), value_to_match.utf8().get_data(), (ELobbyComparison)comparison_type);
+bool Steam::queue_event(EventType type, std::initializer_list<int64_t> values, const String *text){
+	if (!event_polling.load(std::memory_order_acquire)) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(event_mutex);
+	EventColumns &columns = queued_events[type];
+	columns.values.insert(columns.values.end(), values.begin(), values.end());
+	if (text) {
+		columns.strings.push_back(*text);
 	}
+	columns.count++;
+	return true;
 }
 
-void Steam::add_request_lobby_list_distance_filter(int distance_filter){
-	if(SteamMatchmaking() != NULL){
-		SteamMatchmaking()->AddRequestLobbyListDistanceFilter((ELobbyDistanceFilter)distance_filter);
+// Returns { event name: { column name: Packed*Array, ... }, ... } for every
+// event type that fired since the last call. Row i of every column belongs
+// to the same event, in arrival order.
+Dictionary Steam::poll_events(){
+	Dictionary result;
+	{
+		// Swap the buffers out so callbacks on the network thread never wait on us.
+		std::lock_guard<std::mutex> lock(event_mutex);
+		for (int i = 0; i < EVENT_MAX; i++) {
+			std::swap(queued_events[i], polled_events[i]);
+		}
+	}
+	for (int i = 0; i < EVENT_MAX; i++) {
+		EventColumns &columns = polled_events[i];
+		if (columns.count == 0) {
+			continue;
+		}
+		int width = columns.values.size() / columns.count;
+		Dictionary event;
+		for (int c = 0; c < width; c++) {
+			PackedInt64Array column;
+			column.resize(columns.count);
+			int64_t *ptr = column.ptrw();
+			for (int row = 0; row < columns.count; row++) {
+				ptr[row] = columns.values[row * width + c];
+			}
+			event[event_columns[i][c]] = column;
+		}
+		if (!columns.strings.empty()) {
+			PackedStringArray strings;
+			strings.resize(columns.strings.size());
+			for (size_t row = 0; row < columns.strings.size(); row++) {
+				strings.set(row, columns.strings[row]);
+			}
+			event[event_string_columns[i]] = strings;
+		}
+		result[event_names[i]] = event;
+		// Keep the capacity for the next round.
+		columns.values.clear();
+		columns.strings.clear();
+		columns.count = 0;
 	}
+	return result;
 }
 
-void Steam::lobby_data_update(LobbyDataUpdate_t* call_data){
-	uint64_t member_id = call_data->m_ulSteamIDMember;
-	uint64_t lobby_id = call_data->m_ulSteamIDLobby;
-	uint8 success = call_data->m_bSuccess;
-	emit_signal("lobby_data_update", success, lobby_id, member_id);
+bool Steam::is_network_thread(){
+	return in_network_thread;
 }
 
-void Steam::lobby_chat_update(LobbyChatUpdate_t* call_data){
-	uint64_t lobby_id = call_data->m_ulSteamIDLobby;
-	uint64_t changed_id = call_data->m_ulSteamIDUserChanged;
-	uint64_t making_change_id = call_data->m_ulSteamIDMakingChange;
-	uint32 chat_state = call_data->m_rgfChatMemberStateChange;
-	emit_signal("lobby_chat_update", lobby_id, changed_id, making_change_id, chat_state);
+void Steam::network_thread_loop(){
+	in_network_thread = true;
+	const std::chrono::microseconds interval(1000000 / network_thread_rate);
+	std::chrono::steady_clock::time_point next_tick = std::chrono::steady_clock::now();
+	while (network_thread_active.load(std::memory_order_acquire)) {
+		if (backend->can_run_callbacks_off_main_thread()) {
+			backend->run_callbacks(false);
+		}
+		network_thread_pump_packets();
+		next_tick += interval;
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (next_tick < now) {
+			// Don't try to catch up after a stall.
+			next_tick = now;
+		}
+		std::this_thread::sleep_until(next_tick);
+	}
+	in_network_thread = false;
 }
 
-void Steam::lobby_chat_message(LobbyChatMsg_t* call_data){
-	CSteamID lobby_id = call_data->m_ulSteamIDLobby;
-	CSteamID user_id = call_data->m_ulSteamIDUser;
-	uint8 chat_type = call_data->m_eChatEntryType;
-	// Convert the chat type over
-	EChatEntryType type = (EChatEntryType)chat_type;
-	// Get the chat message data
-	char buffer[STEAM_LARGE_BUFFER_SIZE];
-	int size = SteamMatchmaking()->GetLobbyChatEntry(lobby_id, call_data->m_iChatID, &user_id, &buffer, STEAM_LARGE_BUFFER_SIZE, &type);
-	uint64_t lobby = lobby_id.ConvertToUint64();
-	uint64_t user = user_id.ConvertToUint64();
-	emit_signal("lobby_chat_message", lobby, user, String::utf8(buffer, size), chat_type);
+void Steam::network_thread_pump_packets(){
+	for (int channel = 0; channel < (int)network_thread_received.size(); channel++) {
+		uint32_t packet_size = 0;
+		while (is_raw_p2p_packet_available(&packet_size, channel)) {
+			int handle = network_thread_spare;
+			network_thread_spare = -1;
+			if (handle < 0 && !network_thread_free->pop(handle)) {
+				// Every buffer is waiting on the main thread, leave the rest with Steam.
+				return;
+			}
+			SteamPacketPool::Slot &slot = receive_pool.get(handle);
+			uint64_t steam_id = 0;
+			uint32_t bytesRead = 0;
+			if (!read_raw_p2p_packet(receive_pool.reserve(handle, packet_size), packet_size, &bytesRead, &steam_id, channel)) {
+				network_thread_spare = handle;
+				break;
+			}
+			slot.size = bytesRead;
+			slot.steam_id_remote = steam_id;
+			slot.channel = channel;
+			network_thread_received[channel]->push(handle);
+		}
+	}
 }
 
-void Steam::lobby_invite(LobbyInvite_t* lobbyData){
-	CSteamID inviter_id = lobbyData->m_ulSteamIDUser;
-	uint64_t inviter = inviter_id.ConvertToUint64();
-	CSteamID lobby_id = lobbyData->m_ulSteamIDLobby;
-	uint64_t lobby = lobby_id.ConvertToUint64();
-	CSteamID game_id = lobbyData->m_ulGameID;
-	uint64_t game = game_id.ConvertToUint64();
-	emit_signal("lobby_invite", inviter, lobby, game);
+int Steam::pop_network_thread_packet(int channel){
+	if (channel < 0 || channel >= (int)network_thread_received.size()) {
+		return -1;
+	}
+	int handle;
+	if (!network_thread_received[channel]->pop(handle)) {
+		return -1;
+	}
+	receive_pool.mark_in_use(handle);
+	return handle;
 }
 
-void Steam::lobby_join_requested(GameLobbyJoinRequested_t* call_data){
-	CSteamID lobby_id = call_data->m_steamIDLobby;
-	uint64_t lobby = lobby_id.ConvertToUint64();
-	CSteamID friend_id = call_data->m_steamIDFriend;
-	uint64_t steam_id = friend_id.ConvertToUint64();
-	emit_signal("lobby_join_requested", lobby, steam_id);
+// User
+uint64_t Steam::get_steam_id(){
+	return backend->get_steam_id();
 }
 
-uint64_t Steam::get_lobby_owner(uint64_t steam_lobby_id){
-	if(SteamMatchmaking() == NULL){
-		return 0;
+String Steam::get_persona_name(){
+	if(SteamFriends() == NULL){
+		return "";
 	}
-	CSteamID lobby_id = (uint64)steam_lobby_id;
-	CSteamID owner_id = SteamMatchmaking()->GetLobbyOwner(lobby_id);
-	return owner_id.ConvertToUint64();
+	return String::utf8(SteamFriends()->GetPersonaName());
 }
 
-int Steam::get_num_lobby_members(uint64_t steam_lobby_id){
-	if(SteamMatchmaking() == NULL){
-		return 0;
+// Served from the persona cache once known. Otherwise the name is requested
+// (only once) and persona_state_change fires when it arrives.
+String Steam::get_friend_persona_name(uint64_t steam_id){
+	if(steam_id == 0){
+		return "";
+	}
+	{
+		std::lock_guard<std::mutex> lock(persona_mutex);
+		std::unordered_map<uint64_t, String>::const_iterator cached = persona_names.find(steam_id);
+		if(cached != persona_names.end()){
+			return cached->second;
+		}
 	}
-	CSteamID lobby_id = (uint64)steam_lobby_id;
-	return SteamMatchmaking()->GetNumLobbyMembers(lobby_id);
+	return request_persona_name(steam_id);
 }
 
-uint64_t Steam::get_lobby_member_by_index(uint64_t steam_lobby_id, int member){
-	if(SteamMatchmaking() == NULL){
-		return 0;
+// Kicks off name lookups for every ID not cached yet, in one call.
+void Steam::request_persona_names(const PackedInt64Array& steam_ids){
+	for(int i = 0; i < steam_ids.size(); i++){
+		uint64_t steam_id = steam_ids[i];
+		if(steam_id == 0){
+			continue;
+		}
+		{
+			std::lock_guard<std::mutex> lock(persona_mutex);
+			if(persona_names.count(steam_id)){
+				continue;
+			}
+		}
+		request_persona_name(steam_id);
 	}
-	CSteamID lobby_id = (uint64)steam_lobby_id;
-	CSteamID lobbyMember = SteamMatchmaking()->GetLobbyMemberByIndex(lobby_id, member);
-	return lobbyMember.ConvertToUint64();
 }
 
-bool Steam::send_lobby_chat_message(uint64_t steam_lobby_id, const String& message_body){
-	if(SteamMatchmaking() == NULL){
-		return false;
+void Steam::clear_persona_cache(){
+	std::lock_guard<std::mutex> lock(persona_mutex);
+	persona_names.clear();
+	persona_requests.clear();
+}
+
+// A lookup Steam hasn't answered within STEAM_PERSONA_REQUEST_TIMEOUT_MSEC
+// is sent again the next time the name is asked for.
+String Steam::request_persona_name(uint64_t steam_id){
+	if(SteamFriends() == NULL){
+		return "";
+	}
+	CSteamID user_id = (uint64)steam_id;
+	uint64_t now = get_ticks_usec();
+	{
+		std::lock_guard<std::mutex> lock(persona_mutex);
+		std::unordered_map<uint64_t, uint64_t>::const_iterator pending = persona_requests.find(steam_id);
+		if(pending != persona_requests.end() && now - pending->second < STEAM_PERSONA_REQUEST_TIMEOUT_MSEC * 1000ULL){
+			return "";
+		}
+	}
+	bool is_data_loading = SteamFriends()->RequestUserInformation(user_id, true);
+	if(is_data_loading){
+		std::lock_guard<std::mutex> lock(persona_mutex);
+		// Forget lookups that timed out and were never asked for again.
+		for(std::unordered_map<uint64_t, uint64_t>::iterator it = persona_requests.begin(); it != persona_requests.end();){
+			if(now - it->second >= STEAM_PERSONA_REQUEST_TIMEOUT_MSEC * 1000ULL){
+				it = persona_requests.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+		persona_requests[steam_id] = now;
+		return "";
 	}
-	CSteamID lobby_id = (uint64)steam_lobby_id;
-	return SteamMatchmaking()->SendLobbyChatMsg(lobby_id, message_body.utf8().get_data(), message_body.length() + 1);
+	String name = String::utf8(SteamFriends()->GetFriendPersonaName(user_id));
+	std::lock_guard<std::mutex> lock(persona_mutex);
+	persona_names[steam_id] = name;
+	persona_requests.erase(steam_id);
+	return name;
 }
 
-// P2P
-bool Steam::accept_p2p_session_with_user(uint64_t steam_id_remote) {
-	if (SteamNetworking() == NULL) {
-		return false;
+void Steam::persona_state_change(PersonaStateChange_t* call_data){
+	uint64_t steam_id = call_data->m_ulSteamID;
+	int flags = call_data->m_nChangeFlags;
+	if(SteamFriends() != NULL && (flags & k_EPersonaChangeName)){
+		String name = String::utf8(SteamFriends()->GetFriendPersonaName(CSteamID((uint64)steam_id)));
+		std::lock_guard<std::mutex> lock(persona_mutex);
+		persona_names[steam_id] = name;
+		persona_requests.erase(steam_id);
+	}
+	if (queue_event(EVENT_PERSONA_STATE_CHANGE, { (int64_t)steam_id, (int64_t)flags })) {
+		return;
 	}
-	CSteamID steam_id = createSteamID(steam_id_remote);
-	return SteamNetworking()->AcceptP2PSessionWithUser(steam_id);
+	dispatch_signal("persona_state_change", steam_id, flags);
 }
 
-bool Steam::allow_p2p_packet_relay(bool allow) {
-	if (SteamNetworking() == NULL) {
+
+// User stats
+// Stat and achievement changes are kept in memory, merged per name, and
+// written to Steam with one StoreStats() call when the store interval has
+// passed since the last one, from run_callbacks(). store_stats() writes
+// them right away for moments that matter, like the end of a match.
+// Call these on the main thread.
+bool Steam::request_current_stats(){
+	if (SteamUserStats() == NULL) {
 		return false;
 	}
-	return SteamNetworking()->AllowP2PPacketRelay(allow);
+	return SteamUserStats()->RequestCurrentStats();
 }
 
-bool Steam::close_p2p_session_with_user(uint64_t steam_id_remote) {
-	if (SteamNetworking() == NULL) {
-		return false;
+bool Steam::are_stats_loaded(){
+	return stats_loaded.load(std::memory_order_acquire);
+}
+
+Steam::PendingStat &Steam::get_pending_stat(const std::string &name, bool is_float){
+	PendingStat &stat = pending_stats[name];
+	if (stat.is_float != is_float) {
+		// Switching types starts over, Steam will reject one of them anyway.
+		stat = PendingStat();
+		stat.is_float = is_float;
 	}
-	CSteamID steam_id = createSteamID(steam_id_remote);
-	return SteamNetworking()->CloseP2PSessionWithUser(steam_id);
+	return stat;
 }
 
-uint32_t Steam::get_available_p2p_packet_size(int channel){
-	if (SteamNetworking() == NULL) {
-		return 0;
+// The value `stat` amounts to: its own if it was set, Steam's plus the
+// deltas otherwise. Fails if Steam has no such stat of that type.
+bool Steam::resolve_stat(const std::string &name, const PendingStat &stat, PendingStat &r_value){
+	r_value = stat;
+	if (!stat.has_value) {
+		bool found = false;
+		if (SteamUserStats() != NULL) {
+			found = stat.is_float ? SteamUserStats()->GetStat(name.c_str(), &r_value.float_value) : SteamUserStats()->GetStat(name.c_str(), &r_value.int_value);
+		}
+		if (!found) {
+			return false;
+		}
 	}
-	uint32_t messageSize = 0;
-	return (SteamNetworking()->IsP2PPacketAvailable(&messageSize, channel)) ? messageSize : 0;
+	r_value.int_value += stat.int_delta;
+	r_value.float_value += stat.float_delta;
+	return true;
 }
 
-Dictionary Steam::read_p2p_packet(uint32_t packet, int channel){
-	Dictionary result;
-	if (SteamNetworking() == NULL) {
-		return result;
+void Steam::set_stat_int(const String& name, int value){
+	PendingStat &stat = get_pending_stat(name.utf8().get_data(), false);
+	stat.has_value = true;
+	stat.int_value = value;
+	stat.int_delta = 0;
+}
+
+void Steam::set_stat_float(const String& name, double value){
+	PendingStat &stat = get_pending_stat(name.utf8().get_data(), true);
+	stat.has_value = true;
+	stat.float_value = value;
+	stat.float_delta = 0.0;
+}
+
+// Safe before stats are loaded, the increment is applied to the loaded value.
+void Steam::add_stat_int(const String& name, int delta){
+	get_pending_stat(name.utf8().get_data(), false).int_delta += delta;
+}
+
+void Steam::add_stat_float(const String& name, double delta){
+	get_pending_stat(name.utf8().get_data(), true).float_delta += delta;
+}
+
+// Until stats are loaded only pending changes are known.
+int Steam::get_stat_int(const String& name){
+	std::string key = name.utf8().get_data();
+	PendingStat stat;
+	std::unordered_map<std::string, PendingStat>::iterator pending = pending_stats.find(key);
+	if (pending != pending_stats.end() && !pending->second.is_float) {
+		stat = pending->second;
 	}
-	PackedByteArray data;
-	data.resize(packet);
-	CSteamID steam_id;
-	uint32_t bytesRead = 0;
-	void* ptr;
-	ptr = data.ptrw();
-	if (SteamNetworking()->ReadP2PPacket(ptr, packet, &bytesRead, &steam_id, channel)){
-		data.resize(bytesRead);
-		uint64_t steam_id_remote = steam_id.ConvertToUint64();
-		result["data"] = data;
-		result["steam_id_remote"] = steam_id_remote;
+	PendingStat value;
+	if (!resolve_stat(key, stat, value)) {
+		return stat.int_delta;
 	}
-	else {
-		data.resize(0);
+	return value.int_value;
+}
+
+double Steam::get_stat_float(const String& name){
+	std::string key = name.utf8().get_data();
+	PendingStat stat;
+	stat.is_float = true;
+	std::unordered_map<std::string, PendingStat>::iterator pending = pending_stats.find(key);
+	if (pending != pending_stats.end() && pending->second.is_float) {
+		stat = pending->second;
 	}
-	return result;
+	PendingStat value;
+	if (!resolve_stat(key, stat, value)) {
+		return stat.float_delta;
+	}
+	return value.float_value;
 }
 
-bool Steam::send_p2p_packet(uint64_t steam_id_remote, PackedByteArray data, int send_type, int channel){
-	if (SteamNetworking() == NULL) {
-		return false;
+void Steam::set_achievement(const String& name){
+	pending_achievements[name.utf8().get_data()] = true;
+}
+
+void Steam::clear_achievement(const String& name){
+	pending_achievements[name.utf8().get_data()] = false;
+}
+
+bool Steam::get_achievement(const String& name){
+	std::string key = name.utf8().get_data();
+	std::unordered_map<std::string, bool>::iterator pending = pending_achievements.find(key);
+	if (pending != pending_achievements.end()) {
+		return pending->second;
+	}
+	bool achieved = false;
+	if (SteamUserStats() != NULL) {
+		SteamUserStats()->GetAchievement(key.c_str(), &achieved);
 	}
-	CSteamID steam_id = createSteamID(steam_id_remote);
-	const void* ptr;
-	ptr = data.ptr();
-	return SteamNetworking()->SendP2PPacket(steam_id, ptr, data.size(), EP2PSend(send_type), channel);
+	return achieved;
 }
 
-void Steam::p2p_session_request(P2PSessionRequest_t* call_data){
-	uint64_t steam_id_remote = call_data->m_steamIDRemote.ConvertToUint64();
-	emit_signal("p2p_session_request", steam_id_remote);
+// Returns false if nothing could be stored yet, the changes stay pending.
+bool Steam::store_stats(){
+	return flush_user_stats(true);
 }
 
-void Steam::p2p_session_connect_fail(P2PSessionConnectFail_t* call_data) {
-	uint64_t steam_id_remote = call_data->m_steamIDRemote.ConvertToUint64();
-	uint8_t session_error = call_data->m_eP2PSessionError;
-	emit_signal("p2p_session_connect_fail", steam_id_remote, session_error);
-}
\ No newline at end of file
+void Steam::set_stats_store_interval(int interval_msec){
+	stats_store_interval_usec = (uint64_t)MAX(interval_msec, 0) * 1000;
+}
+
+int Steam::get_stats_store_interval(){
+	return stats_store_interval_usec / 1000;
+}
+
+bool Steam::has_pending_stats(){
+	return stats_unstored || !pending_stats.empty() || !pending_achievements.empty();
+}
+
+// Nothing is flushed before stats are loaded. After that, changes Steam
+// rejects (unknown names, wrong types) are dropped with an error, they
+// would never go through. Only one StoreStats() is in flight at a time,
+// changes made meanwhile go out with the next one.
+bool Steam::flush_user_stats(bool force){
+	if (!has_pending_stats() || SteamUserStats() == NULL || !stats_loaded.load(std::memory_order_acquire)) {
+		return false;
+	}
+	uint64_t now = get_ticks_usec();
+	if (!force && (stats_store_in_flight.load(std::memory_order_acquire) || now - stats_last_store_usec < stats_store_interval_usec)) {
+		return false;
+	}
+	ISteamUserStats *user_stats = SteamUserStats();
+	for (std::unordered_map<std::string, PendingStat>::iterator it = pending_stats.begin(); it != pending_stats.end(); ++it) {
+		PendingStat value;
+		bool set = resolve_stat(it->first, it->second, value);
+		if (set) {
+			set = value.is_float ? user_stats->SetStat(it->first.c_str(), value.float_value) : user_stats->SetStat(it->first.c_str(), value.int_value);
+		}
+		if (set) {
+			stats_unstored = true;
+		} else {
+			ERR_PRINT("Steam rejected stat '" + String::utf8(it->first.c_str()) + "', check its name and type.");
+		}
+	}
+	pending_stats.clear();
+	for (std::unordered_map<std::string, bool>::iterator it = pending_achievements.begin(); it != pending_achievements.end(); ++it) {
+		bool set = it->second ? user_stats->SetAchievement(it->first.c_str()) : user_stats->ClearAchievement(it->first.c_str());
+		if (set) {
+			stats_unstored = true;
+		} else {
+			ERR_PRINT("Steam rejected achievement '" + String::utf8(it->first.c_str()) + "', check its name.");
+		}
+	}
+	pending_achievements.clear();
+	if (!stats_unstored || !user_stats->StoreStats()) {
+		return false;
+	}
+	stats_unstored = false;
+	stats_last_store_usec = now;
+	stats_store_in_flight.store(true, std::memory_order_release);
+	return true;
+}
+
+void Steam::user_stats_received(UserStatsReceived_t* call_data){
+	uint64_t game_id = call_data->m_nGameID;
+	int result = call_data->m_eResult;
+	uint64_t steam_id = call_data->m_steamIDUser.ConvertToUint64();
+	// RequestCurrentStats() always asks Steam for the local user, whichever
+	// backend simulates the network, so compare against Steam's own ID.
+	if (result == k_EResultOK && SteamUser() != NULL && steam_id == SteamUser()->GetSteamID().ConvertToUint64()) {
+		stats_loaded.store(true, std::memory_order_release);
+	}
+	if (queue_event(EVENT_USER_STATS_RECEIVED, { (int64_t)game_id, (int64_t)result, (int64_t)steam_id })) {
+		return;
+	}
+	dispatch_signal("user_stats_received", game_id, result, steam_id);
+}
+
+// Cloud saves
+// Writes are streamed to Steam Cloud in chunks on a background thread,
+// `compress` stores them zstd compressed. Returns the request id passed to
+// cloud_file_written.
+int Steam::write_cloud_file_async(const String& file_name, const PackedByteArray& data, bool compress){
+	ERR_FAIL_COND_V_MSG(file_name.is_empty(), 0, "Cloud file name is empty.");
+	return cloud_streamer.queue_write(file_name, data, compress);
+}
+
+// Compressed files are inflated before cloud_file_read is emitted.
+int Steam::read_cloud_file_async(const String& file_name){
+	ERR_FAIL_COND_V_MSG(file_name.is_empty(), 0, "Cloud file name is empty.");
+	return cloud_streamer.queue_read(file_name);
+}
+
+int Steam::get_pending_cloud_requests(){
+	return cloud_streamer.get_pending_count();
+}
+
+void Steam::flush_cloud_results(){
+	std::vector<SteamCloudStreamer::Result> results;
+	cloud_streamer.take_results(results);
+	for (size_t i = 0; i < results.size(); i++) {
+		const SteamCloudStreamer::Result &result = results[i];
+		if (result.operation == SteamCloudStreamer::OPERATION_WRITE) {
+			emit_signal("cloud_file_written", result.request_id, result.file_name, result.result);
+		} else {
+			emit_signal("cloud_file_read", result.request_id, result.file_name, result.result, result.data);
+		}
+	}
+}
+
+void Steam::user_stats_stored(UserStatsStored_t* call_data){
+	uint64_t game_id = call_data->m_nGameID;
+	int result = call_data->m_eResult;
+	stats_store_in_flight.store(false, std::memory_order_release);
+	if (queue_event(EVENT_USER_STATS_STORED, { (int64_t)game_id, (int64_t)result })) {
+		return;
+	}
+	dispatch_signal("user_stats_stored", game_id, result);
+}
+
+void Steam::user_achievement_stored(UserAchievementStored_t* call_data){
+	uint64_t game_id = call_data->m_nGameID;
+	String achievement = String::utf8(call_data->m_rgchAchievementName);
+	int current_progress = call_data->m_nCurProgress;
+	int max_progress = call_data->m_nMaxProgress;
+	if (queue_event(EVENT_USER_ACHIEVEMENT_STORED, { (int64_t)game_id, (int64_t)current_progress, (int64_t)max_progress }, &achievement)) {
+		return;
+	}
+	dispatch_signal("user_achievement_stored", game_id, achievement, current_progress, max_progress);
+}
+
+
+// Lobby
+void Steam::create_lobby(int lobby_type, int max_members){
+	backend->create_lobby(lobby_type, max_members);
+}
+void Steam::lobby_created(LobbyCreated_t *lobbyData){
+	int result = lobbyData->m_eResult;
+	CSteamID lobby_id = lobbyData->m_ulSteamIDLobby;
+	uint64_t lobby = lobby_id.ConvertToUint64();
+	if (queue_event(EVENT_LOBBY_CREATED, { (int64_t)result, (int64_t)lobby })) {
+		return;
+	}
+	dispatch_signal("lobby_created", result, lobby);
+}
+
+bool Steam::set_lobby_data(uint64_t steam_lobby_id, const String& key, const String& value){
+	return backend->set_lobby_data(steam_lobby_id, key.utf8().get_data(), value.utf8().get_data());
+}
+
+void Steam::join_lobby(uint64_t steam_lobby_id){
+	backend->join_lobby(steam_lobby_id);
+}
+void Steam::lobby_joined(LobbyEnter_t* lobbyData){
+	CSteamID steam_lobby_id = lobbyData->m_ulSteamIDLobby;
+	uint64_t lobby_id = steam_lobby_id.ConvertToUint64();
+	uint32_t permissions = lobbyData->m_rgfChatPermissions;
+	bool locked = lobbyData->m_bLocked;
+	uint32_t response = lobbyData->m_EChatRoomEnterResponse;
+	if (response == k_EChatRoomEnterResponseSuccess) {
+		refresh_lobby_members(lobby_id);
+	}
+	if (queue_event(EVENT_LOBBY_JOINED, { (int64_t)lobby_id, (int64_t)permissions, (int64_t)locked, (int64_t)response })) {
+		return;
+	}
+	dispatch_signal("lobby_joined", lobby_id, permissions, locked, response);
+}
+
+void Steam::leave_lobby(uint64_t steam_lobby_id){
+	{
+		std::lock_guard<std::mutex> lock(lobby_members_mutex);
+		lobby_members.erase(steam_lobby_id);
+	}
+	for (size_t i = 0; i < lobby_chat_queues.size(); i++) {
+		if (lobby_chat_queues[i].lobby_id == steam_lobby_id) {
+			lobby_chat_queues.erase(lobby_chat_queues.begin() + i);
+			break;
+		}
+	}
+	backend->leave_lobby(steam_lobby_id);
+}
+
+// Steam answers one lobby list request at a time and drops the previous
+// one when a new one comes in, so requests are queued and sent one by one.
+void Steam::request_lobby_list(){
+	LobbySearch search;
+	search.plain = true;
+	queue_lobby_search(search);
+}
+
+// Like request_lobby_list(), but lobby_search_result also carries the
+// requested lobby data keys, read while Steam still has them at hand.
+// An identical search (same filters and keys) answered less than
+// max_age_msec ago is served from cache without asking Steam again;
+// returns true in that case. The signal is always emitted deferred.
+// Cached results are kept for at most STEAM_LOBBY_SEARCH_CACHE_TTL_MSEC.
+bool Steam::request_lobby_search(const PackedStringArray& data_keys, int max_age_msec){
+	std::string signature = lobby_filter_signature;
+	for(int i = 0; i < data_keys.size(); i++){
+		signature += "|k:" + std::string(data_keys[i].utf8().get_data());
+	}
+	uint64_t now = get_ticks_usec();
+	{
+		std::lock_guard<std::mutex> lock(lobby_search_mutex);
+		prune_lobby_search_cache(now);
+		std::unordered_map<std::string, LobbySearchEntry>::iterator cached = lobby_search_cache.find(signature);
+		if(cached != lobby_search_cache.end() && now - cached->second.time_usec <= (uint64_t)MAX(max_age_msec, 0) * 1000){
+			lobby_filters.clear();
+			lobby_filter_signature.clear();
+			call_deferred("emit_signal", "lobby_search_result", cached->second.result.duplicate(true));
+			return true;
+		}
+	}
+	LobbySearch search;
+	search.signature = signature;
+	search.keys = data_keys;
+	queue_lobby_search(search);
+	return false;
+}
+
+void Steam::clear_lobby_search_cache(){
+	std::lock_guard<std::mutex> lock(lobby_search_mutex);
+	lobby_search_cache.clear();
+}
+
+// Takes the filters added since the last request along. A request Steam
+// never answered is given up after STEAM_LOBBY_SEARCH_TIMEOUT_MSEC.
+void Steam::queue_lobby_search(LobbySearch &p_search){
+	p_search.filters.swap(lobby_filters);
+	lobby_filters.clear();
+	lobby_filter_signature.clear();
+	std::lock_guard<std::mutex> lock(lobby_search_mutex);
+	if(!lobby_searches.empty() && get_ticks_usec() - lobby_searches.front().start_usec > STEAM_LOBBY_SEARCH_TIMEOUT_MSEC * 1000ULL){
+		lobby_searches.pop_front();
+		if(!lobby_searches.empty()){
+			start_lobby_search();
+		}
+	}
+	lobby_searches.push_back(p_search);
+	if(lobby_searches.size() == 1){
+		start_lobby_search();
+	}
+}
+
+// Called with lobby_search_mutex held.
+void Steam::start_lobby_search(){
+	LobbySearch &search = lobby_searches.front();
+	for(size_t i = 0; i < search.filters.size(); i++){
+		const LobbyFilter &filter = search.filters[i];
+		if(filter.distance){
+			backend->add_lobby_list_distance_filter(filter.comparison);
+		}
+		else {
+			backend->add_lobby_list_string_filter(filter.key.c_str(), filter.value.c_str(), filter.comparison);
+		}
+	}
+	search.start_usec = get_ticks_usec();
+	backend->request_lobby_list();
+}
+
+// Called with lobby_search_mutex held. Drops expired results, then the
+// oldest ones while the cache is over STEAM_LOBBY_SEARCH_CACHE_SIZE.
+void Steam::prune_lobby_search_cache(uint64_t now){
+	for(std::unordered_map<std::string, LobbySearchEntry>::iterator it = lobby_search_cache.begin(); it != lobby_search_cache.end();){
+		if(now - it->second.time_usec > STEAM_LOBBY_SEARCH_CACHE_TTL_MSEC * 1000ULL){
+			it = lobby_search_cache.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	while(lobby_search_cache.size() > STEAM_LOBBY_SEARCH_CACHE_SIZE){
+		std::unordered_map<std::string, LobbySearchEntry>::iterator oldest = lobby_search_cache.begin();
+		for(std::unordered_map<std::string, LobbySearchEntry>::iterator it = lobby_search_cache.begin(); it != lobby_search_cache.end(); ++it){
+			if(it->second.time_usec < oldest->second.time_usec){
+				oldest = it;
+			}
+		}
+		lobby_search_cache.erase(oldest);
+	}
+}
+
+void Steam::lobby_match_list(LobbyMatchList_t *call_data){
+	int lobby_count = call_data->m_nLobbiesMatching;
+	Array lobbies;
+	for(int i = 0; i < lobby_count; i++){
+		uint64_t lobby = backend->get_lobby_by_index(i);
+		lobbies.append(lobby);
+	}
+	Dictionary search_result;
+	bool searched = false;
+	{
+		std::lock_guard<std::mutex> lock(lobby_search_mutex);
+		if(!lobby_searches.empty()){
+			const LobbySearch &search = lobby_searches.front();
+			if(!search.plain){
+				search_result = build_lobby_search_result(lobbies, search.keys);
+				uint64_t now = get_ticks_usec();
+				LobbySearchEntry &entry = lobby_search_cache[search.signature];
+				entry.time_usec = now;
+				entry.result = search_result.duplicate(true);
+				prune_lobby_search_cache(now);
+				searched = true;
+			}
+			lobby_searches.pop_front();
+			if(!lobby_searches.empty()){
+				start_lobby_search();
+			}
+		}
+	}
+	dispatch_signal("lobby_match_list", lobbies);
+	if(searched){
+		dispatch_signal("lobby_search_result", search_result);
+	}
+}
+
+// Column oriented: "lobby_id" and "member_count" hold one entry per lobby,
+// "data" maps every requested key to a PackedStringArray in the same order.
+Dictionary Steam::build_lobby_search_result(const Array& lobbies, const PackedStringArray& data_keys){
+	int lobby_count = lobbies.size();
+	PackedInt64Array lobby_ids;
+	PackedInt32Array member_counts;
+	PackedInt32Array member_limits;
+	lobby_ids.resize(lobby_count);
+	member_counts.resize(lobby_count);
+	member_limits.resize(lobby_count);
+	for(int i = 0; i < lobby_count; i++){
+		uint64_t lobby_id = lobbies[i];
+		lobby_ids.set(i, lobby_id);
+		member_counts.set(i, backend->get_num_lobby_members(lobby_id));
+		member_limits.set(i, backend->get_lobby_member_limit(lobby_id));
+	}
+	Dictionary data;
+	for(int k = 0; k < data_keys.size(); k++){
+		CharString key = data_keys[k].utf8();
+		PackedStringArray values;
+		values.resize(lobby_count);
+		for(int i = 0; i < lobby_count; i++){
+			values.set(i, String::utf8(backend->get_lobby_data(lobby_ids[i], key.get_data())));
+		}
+		data[data_keys[k]] = values;
+	}
+	Dictionary result;
+	result["lobby_id"] = lobby_ids;
+	result["member_count"] = member_counts;
+	result["member_limit"] = member_limits;
+	result["data"] = data;
+	return result;
+}
+
+// Filters are only handed to Steam right before a request goes out, so a
+// search answered from cache doesn't leave them applied to the next one.
+void Steam::add_request_lobby_list_string_filter(const String& key_to_match, const String& value_to_match, int comparison_type){
+	LobbyFilter filter;
+	filter.key = key_to_match.utf8().get_data();
+	filter.value = value_to_match.utf8().get_data();
+	filter.comparison = comparison_type;
+	lobby_filters.push_back(filter);
+	lobby_filter_signature += "|s:" + filter.key + "=" + filter.value + ":" + std::to_string(comparison_type);
+}
+
+void Steam::add_request_lobby_list_distance_filter(int distance_filter){
+	LobbyFilter filter;
+	filter.distance = true;
+	filter.comparison = distance_filter;
+	lobby_filters.push_back(filter);
+	lobby_filter_signature += "|d:" + std::to_string(distance_filter);
+}
+
+void Steam::lobby_data_update(LobbyDataUpdate_t* call_data){
+	uint64_t member_id = call_data->m_ulSteamIDMember;
+	uint64_t lobby_id = call_data->m_ulSteamIDLobby;
+	uint8 success = call_data->m_bSuccess;
+	if (queue_event(EVENT_LOBBY_DATA_UPDATE, { (int64_t)success, (int64_t)lobby_id, (int64_t)member_id })) {
+		return;
+	}
+	dispatch_signal("lobby_data_update", success, lobby_id, member_id);
+}
+
+void Steam::lobby_chat_update(LobbyChatUpdate_t* call_data){
+	uint64_t lobby_id = call_data->m_ulSteamIDLobby;
+	uint64_t changed_id = call_data->m_ulSteamIDUserChanged;
+	uint64_t making_change_id = call_data->m_ulSteamIDMakingChange;
+	uint32 chat_state = call_data->m_rgfChatMemberStateChange;
+	update_lobby_members(lobby_id, changed_id, chat_state);
+	if (queue_event(EVENT_LOBBY_CHAT_UPDATE, { (int64_t)lobby_id, (int64_t)changed_id, (int64_t)making_change_id, (int64_t)chat_state })) {
+		return;
+	}
+	dispatch_signal("lobby_chat_update", lobby_id, changed_id, making_change_id, chat_state);
+}
+
+void Steam::lobby_chat_message(LobbyChatMsg_t* call_data){
+	uint64_t lobby = call_data->m_ulSteamIDLobby;
+	uint64_t user = call_data->m_ulSteamIDUser;
+	uint8 chat_type = call_data->m_eChatEntryType;
+	int type = chat_type;
+	// Get the chat message data
+	char buffer[STEAM_LARGE_BUFFER_SIZE];
+	int size = backend->get_lobby_chat_entry(lobby, call_data->m_iChatID, &user, buffer, STEAM_LARGE_BUFFER_SIZE, &type);
+	if (size >= STEAM_LOBBY_CHAT_HEADER_SIZE && buffer[0] == 0 && (uint8_t)buffer[1] == STEAM_LOBBY_CHAT_BINARY_MARKER) {
+		emit_lobby_chat_bytes(lobby, user, (const uint8_t *)buffer, size);
+		return;
+	}
+	// Text messages carry their terminator.
+	if (size > 0 && buffer[size - 1] == 0) {
+		size--;
+	}
+	String message = String::utf8(buffer, size);
+	if (queue_event(EVENT_LOBBY_CHAT_MESSAGE, { (int64_t)lobby, (int64_t)user, (int64_t)chat_type }, &message)) {
+		return;
+	}
+	dispatch_signal("lobby_chat_message", lobby, user, message, chat_type);
+}
+
+void Steam::lobby_invite(LobbyInvite_t* lobbyData){
+	CSteamID inviter_id = lobbyData->m_ulSteamIDUser;
+	uint64_t inviter = inviter_id.ConvertToUint64();
+	CSteamID lobby_id = lobbyData->m_ulSteamIDLobby;
+	uint64_t lobby = lobby_id.ConvertToUint64();
+	CSteamID game_id = lobbyData->m_ulGameID;
+	uint64_t game = game_id.ConvertToUint64();
+	if (queue_event(EVENT_LOBBY_INVITE, { (int64_t)inviter, (int64_t)lobby, (int64_t)game })) {
+		return;
+	}
+	dispatch_signal("lobby_invite", inviter, lobby, game);
+}
+
+void Steam::lobby_join_requested(GameLobbyJoinRequested_t* call_data){
+	CSteamID lobby_id = call_data->m_steamIDLobby;
+	uint64_t lobby = lobby_id.ConvertToUint64();
+	CSteamID friend_id = call_data->m_steamIDFriend;
+	uint64_t steam_id = friend_id.ConvertToUint64();
+	if (queue_event(EVENT_LOBBY_JOIN_REQUESTED, { (int64_t)lobby, (int64_t)steam_id })) {
+		return;
+	}
+	dispatch_signal("lobby_join_requested", lobby, steam_id);
+}
+
+uint64_t Steam::get_lobby_owner(uint64_t steam_lobby_id){
+	return backend->get_lobby_owner(steam_lobby_id);
+}
+
+int Steam::get_num_lobby_members(uint64_t steam_lobby_id){
+	{
+		std::lock_guard<std::mutex> lock(lobby_members_mutex);
+		std::unordered_map<uint64_t, PackedInt64Array>::const_iterator cached = lobby_members.find(steam_lobby_id);
+		if (cached != lobby_members.end()) {
+			return cached->second.size();
+		}
+	}
+	return backend->get_num_lobby_members(steam_lobby_id);
+}
+
+uint64_t Steam::get_lobby_member_by_index(uint64_t steam_lobby_id, int member){
+	{
+		std::lock_guard<std::mutex> lock(lobby_members_mutex);
+		std::unordered_map<uint64_t, PackedInt64Array>::const_iterator cached = lobby_members.find(steam_lobby_id);
+		if (cached != lobby_members.end()) {
+			return (member >= 0 && member < cached->second.size()) ? (uint64_t)cached->second[member] : 0;
+		}
+	}
+	return backend->get_lobby_member_by_index(steam_lobby_id, member);
+}
+
+// Members of lobbies we are in are cached when joining and kept up to date
+// from lobby_chat_update, so this doesn't touch Steam in steady state.
+// Other lobbies are queried directly.
+PackedInt64Array Steam::get_lobby_members(uint64_t steam_lobby_id){
+	{
+		std::lock_guard<std::mutex> lock(lobby_members_mutex);
+		std::unordered_map<uint64_t, PackedInt64Array>::const_iterator cached = lobby_members.find(steam_lobby_id);
+		if (cached != lobby_members.end()) {
+			return cached->second;
+		}
+	}
+	return query_lobby_members(steam_lobby_id);
+}
+
+PackedInt64Array Steam::query_lobby_members(uint64_t steam_lobby_id){
+	PackedInt64Array members;
+	int count = backend->get_num_lobby_members(steam_lobby_id);
+	members.resize(count);
+	for(int i = 0; i < count; i++){
+		members.set(i, backend->get_lobby_member_by_index(steam_lobby_id, i));
+	}
+	return members;
+}
+
+void Steam::refresh_lobby_members(uint64_t steam_lobby_id){
+	PackedInt64Array members = query_lobby_members(steam_lobby_id);
+	std::lock_guard<std::mutex> lock(lobby_members_mutex);
+	lobby_members[steam_lobby_id] = members;
+}
+
+void Steam::update_lobby_members(uint64_t steam_lobby_id, uint64_t changed_id, uint32_t chat_state){
+	std::lock_guard<std::mutex> lock(lobby_members_mutex);
+	std::unordered_map<uint64_t, PackedInt64Array>::iterator cached = lobby_members.find(steam_lobby_id);
+	if (cached == lobby_members.end()) {
+		return;
+	}
+	PackedInt64Array &members = cached->second;
+	int64_t index = members.find(changed_id);
+	if (chat_state & k_EChatMemberStateChangeEntered) {
+		if (index < 0) {
+			members.append(changed_id);
+		}
+	} else if (index >= 0) {
+		// Left, disconnected, kicked or banned.
+		members.remove_at(index);
+	}
+}
+
+bool Steam::send_lobby_chat_message(uint64_t steam_lobby_id, const String& message_body){
+	CharString message = message_body.utf8();
+	return backend->send_lobby_chat_message(steam_lobby_id, message.get_data(), message.length() + 1);
+}
+
+// Queues raw bytes for the lobby. Messages queued for the same lobby are
+// packed into as few chat entries as fit, and flush_lobby_chat() (called from
+// run_callbacks()) sends them no faster than the lobby chat rate, so bursts
+// don't run into Steam's chat rate limit. Receivers get lobby_chat_bytes
+// instead of lobby_chat_message, which also bypasses event polling.
+bool Steam::send_lobby_chat_bytes(uint64_t steam_lobby_id, const PackedByteArray& data){
+	uint8_t header[5];
+	size_t header_size = SteamSendCoalescer::encode_varint(data.size(), header);
+	ERR_FAIL_COND_V_MSG(STEAM_LOBBY_CHAT_HEADER_SIZE + header_size + data.size() > STEAM_LOBBY_CHAT_MAX_SIZE, false, "Lobby chat messages are limited to 4KB.");
+	LobbyChatQueue &queue = get_lobby_chat_queue(steam_lobby_id);
+	if (queue.pending.size() + header_size + data.size() > STEAM_LOBBY_CHAT_MAX_SIZE) {
+		queue.ready.push_back(std::move(queue.pending));
+		queue.pending.clear();
+	}
+	if (queue.pending.empty()) {
+		queue.pending.push_back(0);
+		queue.pending.push_back(STEAM_LOBBY_CHAT_BINARY_MARKER);
+	}
+	queue.pending.insert(queue.pending.end(), header, header + header_size);
+	queue.pending.insert(queue.pending.end(), data.ptr(), data.ptr() + data.size());
+	return true;
+}
+
+Steam::LobbyChatQueue &Steam::get_lobby_chat_queue(uint64_t steam_lobby_id){
+	for (size_t i = 0; i < lobby_chat_queues.size(); i++) {
+		if (lobby_chat_queues[i].lobby_id == steam_lobby_id) {
+			return lobby_chat_queues[i];
+		}
+	}
+	lobby_chat_queues.emplace_back();
+	lobby_chat_queues.back().lobby_id = steam_lobby_id;
+	return lobby_chat_queues.back();
+}
+
+// Sends queued chat entries while the token bucket allows, taking turns
+// between lobbies. Returns how many entries went out.
+int Steam::flush_lobby_chat(){
+	if (lobby_chat_queues.empty()) {
+		return 0;
+	}
+	uint64_t now = get_ticks_usec();
+	if (lobby_chat_refill_usec != 0) {
+		lobby_chat_tokens = MIN(lobby_chat_burst, lobby_chat_tokens + (now - lobby_chat_refill_usec) * lobby_chat_rate / 1000000.0);
+	}
+	lobby_chat_refill_usec = now;
+	int sent = 0;
+	while (lobby_chat_tokens >= 1.0 && !lobby_chat_queues.empty()) {
+		lobby_chat_next %= lobby_chat_queues.size();
+		LobbyChatQueue &queue = lobby_chat_queues[lobby_chat_next];
+		if (queue.ready.empty() && !queue.pending.empty()) {
+			queue.ready.push_back(std::move(queue.pending));
+			queue.pending.clear();
+		}
+		if (queue.ready.empty()) {
+			lobby_chat_queues.erase(lobby_chat_queues.begin() + lobby_chat_next);
+			continue;
+		}
+		const std::vector<uint8_t> &entry = queue.ready.front();
+		// A failed send (left the lobby, not a member) is not retried.
+		backend->send_lobby_chat_message(queue.lobby_id, entry.data(), entry.size());
+		queue.ready.pop_front();
+		lobby_chat_tokens -= 1.0;
+		sent++;
+		lobby_chat_next++;
+	}
+	return sent;
+}
+
+void Steam::set_lobby_chat_rate(double messages_per_second, double burst){
+	lobby_chat_rate = MAX(messages_per_second, 0.01);
+	lobby_chat_burst = MAX(burst, 1.0);
+	lobby_chat_tokens = MIN(lobby_chat_tokens, lobby_chat_burst);
+}
+
+double Steam::get_lobby_chat_rate(){
+	return lobby_chat_rate;
+}
+
+// Chat entries waiting to be sent, partially filled ones included.
+int Steam::get_lobby_chat_queue_size(){
+	int size = 0;
+	for (size_t i = 0; i < lobby_chat_queues.size(); i++) {
+		size += lobby_chat_queues[i].ready.size() + (lobby_chat_queues[i].pending.empty() ? 0 : 1);
+	}
+	return size;
+}
+
+void Steam::emit_lobby_chat_bytes(uint64_t lobby_id, uint64_t user, const uint8_t *data, int size){
+	int offset = STEAM_LOBBY_CHAT_HEADER_SIZE;
+	while (offset < size) {
+		uint32_t length = 0;
+		size_t used = SteamSendCoalescer::decode_varint(data + offset, size - offset, &length);
+		if (used == 0 || offset + used + length > (uint32_t)size) {
+			return;
+		}
+		offset += used;
+		PackedByteArray message;
+		message.resize(length);
+		if (length > 0) {
+			memcpy(message.ptrw(), data + offset, length);
+		}
+		offset += length;
+		dispatch_signal("lobby_chat_bytes", lobby_id, user, message);
+	}
+}
+
+// P2P
+bool Steam::accept_p2p_session_with_user(uint64_t steam_id_remote) {
+	return backend->accept_p2p_session(steam_id_remote);
+}
+
+bool Steam::allow_p2p_packet_relay(bool allow) {
+	return backend->allow_p2p_packet_relay(allow);
+}
+
+bool Steam::close_p2p_session_with_user(uint64_t steam_id_remote) {
+	send_scheduler.remove_peer(steam_id_remote);
+	return backend->close_p2p_session(steam_id_remote);
+}
+
+uint32_t Steam::get_available_p2p_packet_size(int channel){
+	if (uses_p2p_message_path()) {
+		P2PMessage message;
+		return peek_p2p_message(channel, message) ? message.size : 0;
+	}
+	uint32_t messageSize = 0;
+	return (is_raw_p2p_packet_available(&messageSize, channel)) ? messageSize : 0;
+}
+
+Dictionary Steam::read_p2p_packet(uint32_t packet, int channel){
+	Dictionary result;
+	if (uses_p2p_message_path()) {
+		P2PMessage message;
+		if (peek_p2p_message(channel, message)) {
+			// Left queued, so it can be read again with the right size.
+			ERR_FAIL_COND_V_MSG(message.size > packet, result, "The P2P message is larger than the requested size, get its size from get_available_p2p_packet_size().");
+			PackedByteArray data;
+			data.resize(message.size);
+			memcpy(data.ptrw(), message.data, message.size);
+			result["data"] = data;
+			result["steam_id_remote"] = message.steam_id_remote;
+			consume_p2p_message(channel);
+		}
+		return result;
+	}
+	PackedByteArray data;
+	data.resize(packet);
+	uint64_t steam_id_remote = 0;
+	uint32_t bytesRead = 0;
+	void* ptr;
+	ptr = data.ptrw();
+	if (read_raw_p2p_packet(ptr, packet, &bytesRead, &steam_id_remote, channel)){
+		data.resize(bytesRead);
+		result["data"] = data;
+		result["steam_id_remote"] = steam_id_remote;
+	}
+	else {
+		data.resize(0);
+	}
+	return result;
+}
+
+// Drains up to max_packets (0 = all pending) from the channel in one call.
+// Payloads are packed back to back in "data", packet i spans
+// data[offsets[i]] .. data[offsets[i] + sizes[i]] and came from steam_id_remote[i].
+Dictionary Steam::read_p2p_packets(int channel, int max_packets){
+	Dictionary result;
+	PackedByteArray data;
+	PackedInt64Array steam_ids;
+	PackedInt32Array offsets;
+	PackedInt32Array sizes;
+	int64_t total = 0;
+	if (uses_p2p_message_path()) {
+		P2PMessage message;
+		while ((max_packets <= 0 || sizes.size() < max_packets) && peek_p2p_message(channel, message)) {
+			data.resize(total + message.size);
+			memcpy(data.ptrw() + total, message.data, message.size);
+			steam_ids.append(message.steam_id_remote);
+			offsets.append(total);
+			sizes.append(message.size);
+			total += message.size;
+			consume_p2p_message(channel);
+		}
+	}
+	else {
+		uint32_t packet_size = 0;
+		while ((max_packets <= 0 || sizes.size() < max_packets) && is_raw_p2p_packet_available(&packet_size, channel)) {
+			// PackedByteArray grows its allocation geometrically, so this stays amortized.
+			data.resize(total + packet_size);
+			uint64_t steam_id = 0;
+			uint32_t bytesRead = 0;
+			if (!read_raw_p2p_packet(data.ptrw() + total, packet_size, &bytesRead, &steam_id, channel)) {
+				break;
+			}
+			steam_ids.append(steam_id);
+			offsets.append(total);
+			sizes.append(bytesRead);
+			total += bytesRead;
+		}
+		data.resize(total);
+	}
+	result["data"] = data;
+	result["steam_id_remote"] = steam_ids;
+	result["offsets"] = offsets;
+	result["sizes"] = sizes;
+	return result;
+}
+
+void Steam::set_p2p_receive_pool(int buffer_count, int max_packet_size){
+	ERR_FAIL_COND_MSG(network_thread_active.load(std::memory_order_acquire), "The receive pool can't be resized while the network thread is running.");
+	reset_p2p_receive_cursors();
+	fragment_reassembler.clear();
+	receive_pool.configure(buffer_count, max_packet_size > 0 ? max_packet_size : 0);
+}
+
+// Reads the next packet into a pooled buffer and returns its handle, or -1 if
+// nothing is pending or every buffer is still held. The handle stays valid
+// until release_pooled_packet() is called on it.
+int Steam::read_p2p_packet_pooled(int channel){
+	if (!uses_p2p_message_path()) {
+		return receive_raw_p2p_packet(channel);
+	}
+	P2PMessage message;
+	if (!peek_p2p_message(channel, message)) {
+		return -1;
+	}
+	P2PReceiveCursor &cursor = receive_cursors[channel];
+	if (!cursor.framed && cursor.offset == 0) {
+		// The message is the whole buffer, hand it over as is.
+		int handle = cursor.handle;
+		cursor.handle = -1;
+		return handle;
+	}
+	int handle = receive_pool.acquire();
+	if (handle < 0) {
+		return -1;
+	}
+	SteamPacketPool::Slot &slot = receive_pool.get(handle);
+	memcpy(receive_pool.reserve(handle, message.size), message.data, message.size);
+	slot.size = message.size;
+	slot.steam_id_remote = message.steam_id_remote;
+	slot.channel = channel;
+	consume_p2p_message(channel);
+	return handle;
+}
+
+// Returns the pooled buffer itself, not a copy, so reading a packet never
+// allocates. The buffer keeps the slot's full capacity: only the first
+// get_pooled_packet_size() bytes belong to the packet, and it must not be
+// kept past release_pooled_packet(), or the next read into that slot has to
+// copy the buffer first.
+PackedByteArray Steam::get_pooled_packet_data(int handle){
+	if (!receive_pool.is_valid(handle)) {
+		return PackedByteArray();
+	}
+	return receive_pool.get(handle).data;
+}
+
+int Steam::get_pooled_packet_size(int handle){
+	if (!receive_pool.is_valid(handle)) {
+		return 0;
+	}
+	return receive_pool.get(handle).size;
+}
+
+uint64_t Steam::get_pooled_packet_sender(int handle){
+	if (!receive_pool.is_valid(handle)) {
+		return 0;
+	}
+	return receive_pool.get(handle).steam_id_remote;
+}
+
+void Steam::release_pooled_packet(int handle){
+	if (receive_pool.is_valid(handle) && receive_pool.get(handle).detached) {
+		// Buffers owned by the network thread go back to it rather than the pool.
+		if (network_thread_active.load(std::memory_order_acquire)) {
+			receive_pool.get(handle).in_use = false;
+			network_thread_free->push(handle);
+		} else {
+			receive_pool.attach(handle);
+		}
+		return;
+	}
+	receive_pool.release(handle);
+}
+
+// Returns a pool handle holding the next raw packet on the channel, or -1.
+int Steam::receive_raw_p2p_packet(int channel){
+	if (network_thread_active.load(std::memory_order_acquire)) {
+		return pop_network_thread_packet(channel);
+	}
+	if (!receive_pool.is_configured()) {
+		return -1;
+	}
+	uint32_t packet_size = 0;
+	if (!is_raw_p2p_packet_available(&packet_size, channel)) {
+		return -1;
+	}
+	int handle = receive_pool.acquire();
+	if (handle < 0) {
+		return -1;
+	}
+	SteamPacketPool::Slot &slot = receive_pool.get(handle);
+	uint64_t steam_id = 0;
+	uint32_t bytesRead = 0;
+	if (!read_raw_p2p_packet(receive_pool.reserve(handle, packet_size), packet_size, &bytesRead, &steam_id, channel)) {
+		receive_pool.release(handle);
+		return -1;
+	}
+	slot.size = bytesRead;
+	slot.steam_id_remote = steam_id;
+	slot.channel = channel;
+	return handle;
+}
+
+// Packets go through the receive pool whenever they need more than a plain
+// ReadP2PPacket: the network thread parks them there and coalesced packets
+// are split into their messages in place.
+bool Steam::uses_p2p_message_path(){
+	return p2p_coalescing || p2p_fragmentation || network_thread_active.load(std::memory_order_acquire);
+}
+
+// Points the cursor at the next packet the message layer can walk, stripping
+// the packet type tag and reassembling fragments on the way.
+bool Steam::next_p2p_packet(int channel, P2PReceiveCursor &cursor){
+	if (p2p_fragmentation) {
+		fragment_reassembler.expire(get_ticks_usec());
+	}
+	while (true) {
+		cursor.handle = receive_raw_p2p_packet(channel);
+		cursor.offset = 0;
+		cursor.framed = p2p_coalescing;
+		if (cursor.handle < 0) {
+			return false;
+		}
+		if (!p2p_fragmentation) {
+			return true;
+		}
+		const SteamPacketPool::Slot &slot = receive_pool.get(cursor.handle);
+		uint8_t type = slot.size > 0 ? slot.data.ptr()[0] : 0xFF;
+		if (type == STEAM_PACKET_MESSAGE || type == STEAM_PACKET_BATCH) {
+			cursor.offset = 1;
+			cursor.framed = type == STEAM_PACKET_BATCH;
+			return true;
+		}
+		int message = -1;
+		if (type == STEAM_PACKET_FRAGMENT) {
+			message = fragment_reassembler.add(slot.steam_id_remote, channel, slot.data.ptr(), slot.size, get_ticks_usec());
+		}
+		release_pooled_packet(cursor.handle);
+		cursor.handle = message;
+		if (message >= 0) {
+			cursor.framed = false;
+			return true;
+		}
+	}
+}
+
+// Empty messages are skipped, as get_available_p2p_packet_size() would
+// report them as 0 and stall loops that read while the size is positive.
+bool Steam::peek_p2p_message(int channel, P2PMessage &r_message){
+	P2PReceiveCursor &cursor = receive_cursors[channel];
+	while (true) {
+		if (cursor.handle < 0 && !next_p2p_packet(channel, cursor)) {
+			return false;
+		}
+		const SteamPacketPool::Slot &slot = receive_pool.get(cursor.handle);
+		r_message.steam_id_remote = slot.steam_id_remote;
+		if (!cursor.framed) {
+			if (slot.size <= cursor.offset) {
+				release_pooled_packet(cursor.handle);
+				cursor.handle = -1;
+				continue;
+			}
+			r_message.data = slot.data.ptr() + cursor.offset;
+			r_message.size = slot.size - cursor.offset;
+			cursor.next_offset = slot.size;
+			return true;
+		}
+		uint32_t remaining = slot.size - cursor.offset;
+		uint32_t length = 0;
+		size_t header_size = SteamSendCoalescer::decode_varint(slot.data.ptr() + cursor.offset, remaining, &length);
+		if (header_size == 0 || length > remaining - header_size) {
+			// Packet exhausted (or malformed), move on to the next one.
+			release_pooled_packet(cursor.handle);
+			cursor.handle = -1;
+			continue;
+		}
+		if (length == 0) {
+			cursor.offset += header_size;
+			continue;
+		}
+		r_message.data = slot.data.ptr() + cursor.offset + header_size;
+		r_message.size = length;
+		cursor.next_offset = cursor.offset + header_size + length;
+		return true;
+	}
+}
+
+void Steam::consume_p2p_message(int channel){
+	P2PReceiveCursor &cursor = receive_cursors[channel];
+	if (cursor.handle < 0) {
+		return;
+	}
+	cursor.offset = cursor.next_offset;
+	if (!cursor.framed || cursor.offset >= receive_pool.get(cursor.handle).size) {
+		release_pooled_packet(cursor.handle);
+		cursor.handle = -1;
+	}
+}
+
+void Steam::reset_p2p_receive_cursors(){
+	for (std::unordered_map<int, P2PReceiveCursor>::iterator it = receive_cursors.begin(); it != receive_cursors.end(); ++it) {
+		if (it->second.handle >= 0) {
+			release_pooled_packet(it->second.handle);
+		}
+	}
+	receive_cursors.clear();
+}
+
+// Coalescing has to be enabled on both ends, every packet sent while it is
+// on is framed and every packet received is split back into messages.
+void Steam::set_p2p_coalescing(bool enabled, int max_packet_size){
+	if (p2p_coalescing && !enabled) {
+		flush_p2p_packets();
+	}
+	reset_p2p_receive_cursors();
+	p2p_coalescing = enabled;
+	send_coalescer.set_max_packet_size(max_packet_size > 0 ? max_packet_size : 1200);
+	if (enabled && !receive_pool.is_configured()) {
+		receive_pool.configure(64, 1200);
+	}
+}
+
+bool Steam::is_p2p_coalescing_enabled(){
+	return p2p_coalescing;
+}
+
+// Sends everything queued since the last flush. Called by run_callbacks(),
+// so games pumping callbacks every frame get per-frame batching for free.
+// Returns false if Steam rejected any batch since the last flush, including
+// ones sent early because they were full, or the scheduler gave up on a
+// message Steam kept rejecting.
+// Sends queued from other threads are taken in first, then the send
+// scheduler releases what each peer's budget allows.
+bool Steam::flush_p2p_packets(){
+	flush_threaded_sends();
+	uint64_t failed = send_scheduler.get_failed_count();
+	if (p2p_send_scheduler) {
+		send_scheduler.flush(get_ticks_usec());
+	}
+	bool sent = send_coalescer.flush();
+	return sent && send_scheduler.get_failed_count() == failed;
+}
+
+// Holds sends back and releases them on flush_p2p_packets() within a per
+// peer bandwidth budget, most urgent priority first. Waiting raises a
+// message's priority, unreliable messages that wait past their maximum age
+// or overflow the peer's queue are dropped, lowest priority first.
+void Steam::set_p2p_send_scheduler(bool enabled, int bytes_per_second, int burst_bytes){
+	if (p2p_send_scheduler && !enabled) {
+		send_scheduler.drain(get_ticks_usec());
+	}
+	p2p_send_scheduler = enabled;
+	send_scheduler.set_default_rate(MAX(bytes_per_second, 1), MAX(burst_bytes, 1));
+}
+
+bool Steam::is_p2p_send_scheduler_enabled(){
+	return p2p_send_scheduler;
+}
+
+void Steam::set_p2p_send_scheduler_limits(int aging_msec, int max_unreliable_age_msec, int max_queued_bytes){
+	send_scheduler.set_aging_usec(MAX(aging_msec, 1) * 1000ULL);
+	send_scheduler.set_max_unreliable_age_usec(MAX(max_unreliable_age_msec, 0) * 1000ULL);
+	send_scheduler.set_max_queued_bytes(MAX(max_queued_bytes, 0));
+}
+
+// A bytes_per_second of 0 puts the peer back on the default budget.
+void Steam::set_p2p_peer_bandwidth(uint64_t steam_id_remote, int bytes_per_second, int burst_bytes){
+	send_scheduler.set_peer_rate(steam_id_remote, MAX(bytes_per_second, 0), MAX(burst_bytes, 1));
+}
+
+// Large unreliable messages are split into fragments that fit in one packet
+// and put back together by the receiver, which also has to enable this.
+// Reliable messages are left to Steam, which already handles up to 1MB.
+// Packets are capped at Steam's 1200 byte unreliable limit and messages at
+// 4MB, both sides should use the same settings.
+void Steam::set_p2p_fragmentation(bool enabled, int max_packet_size, int timeout_msec, int max_message_size){
+	if (p2p_fragmentation != enabled) {
+		flush_p2p_packets();
+		reset_p2p_receive_cursors();
+		fragment_reassembler.clear();
+	}
+	p2p_fragmentation = enabled;
+	p2p_fragment_size = CLAMP(max_packet_size, STEAM_FRAGMENT_HEADER_SIZE + 1, STEAM_FRAGMENT_MAX_PACKET_SIZE);
+	p2p_max_message_size = CLAMP(max_message_size, 1, STEAM_FRAGMENT_MAX_MESSAGE_SIZE);
+	fragment_reassembler.set_timeout_msec(MAX(timeout_msec, 0));
+	fragment_reassembler.set_limits(p2p_fragment_size - STEAM_FRAGMENT_HEADER_SIZE, p2p_max_message_size);
+	const uint8_t batch_tag = STEAM_PACKET_BATCH;
+	send_coalescer.set_prefix(&batch_tag, enabled ? 1 : 0);
+	if (enabled && !receive_pool.is_configured()) {
+		receive_pool.configure(64, 1200);
+	}
+}
+
+bool Steam::is_p2p_fragmentation_enabled(){
+	return p2p_fragmentation;
+}
+
+bool Steam::send_p2p_fragments(uint64_t steam_id_remote, const uint8_t *data, uint32_t size, int send_type, int channel){
+	uint32_t payload_size = p2p_fragment_size - STEAM_FRAGMENT_HEADER_SIZE;
+	uint32_t count = (size + payload_size - 1) / payload_size;
+	ERR_FAIL_COND_V_MSG(size > p2p_max_message_size || count > UINT16_MAX, false, "Message is too large to be fragmented.");
+	uint32_t fragment_size = SteamFragmentReassembler::get_fragment_size(size, count);
+	uint16_t message_id = next_fragment_message_id++;
+	send_buffer.resize(STEAM_FRAGMENT_HEADER_SIZE + fragment_size);
+	bool sent = true;
+	for (uint32_t index = 0; index < count; index++) {
+		uint32_t offset = index * fragment_size;
+		uint32_t length = MIN(fragment_size, size - offset);
+		SteamFragmentReassembler::write_header(send_buffer.data(), message_id, index, count, size);
+		memcpy(send_buffer.data() + STEAM_FRAGMENT_HEADER_SIZE, data + offset, length);
+		if (!send_raw_p2p_packet(steam_id_remote, send_buffer.data(), STEAM_FRAGMENT_HEADER_SIZE + length, send_type, channel)) {
+			sent = false;
+		}
+	}
+	return sent;
+}
+
+// Every packet that goes on or comes off the wire passes through these two,
+// so the network stats see exactly what Steam sees.
+bool Steam::send_raw_p2p_packet(uint64_t steam_id_remote, const void *data, uint32_t size, int send_type, int channel){
+	bool sent = backend->send_p2p_packet(steam_id_remote, data, size, send_type, channel);
+	network_stats.record_send(steam_id_remote, channel, size, sent);
+	if (sent && traffic_capture.load(std::memory_order_acquire)) {
+		traffic_recorder.record(STEAM_TRAFFIC_SENT, get_ticks_usec(), steam_id_remote, channel, send_type, data, size);
+	}
+	return sent;
+}
+
+// While a replay runs, the capture stands in for the backend.
+bool Steam::read_raw_p2p_packet(void *buffer, uint32_t size, uint32_t *r_read, uint64_t *r_steam_id, int channel){
+	if (traffic_replay.is_active()) {
+		if (!traffic_replay.read_packet(channel, get_ticks_usec(), buffer, size, r_read, r_steam_id)) {
+			return false;
+		}
+	} else if (!backend->read_p2p_packet(buffer, size, r_read, r_steam_id, channel)) {
+		return false;
+	} else if (traffic_capture.load(std::memory_order_acquire)) {
+		traffic_recorder.record(STEAM_TRAFFIC_RECEIVED, get_ticks_usec(), *r_steam_id, channel, 0, buffer, *r_read);
+	}
+	network_stats.record_receive(*r_steam_id, channel, *r_read);
+	return true;
+}
+
+bool Steam::is_raw_p2p_packet_available(uint32_t *r_size, int channel){
+	if (traffic_replay.is_active()) {
+		return traffic_replay.is_packet_available(channel, get_ticks_usec(), r_size);
+	}
+	return backend->is_p2p_packet_available(r_size, channel);
+}
+
+// Records every packet sent and received on the wire, after coalescing and
+// fragmentation, to a binary capture at `path` until stop_p2p_capture().
+bool Steam::start_p2p_capture(const String& path){
+	stop_p2p_capture();
+	ERR_FAIL_COND_V_MSG(!traffic_recorder.open(path, get_ticks_usec()), false, "Can't open " + path + " for writing.");
+	traffic_capture.store(true, std::memory_order_release);
+	return true;
+}
+
+void Steam::stop_p2p_capture(){
+	traffic_capture.store(false, std::memory_order_release);
+	traffic_recorder.close();
+}
+
+bool Steam::is_p2p_capturing(){
+	return traffic_capture.load(std::memory_order_acquire);
+}
+
+// Feeds the packets received in a capture back through the regular read
+// functions instead of Steam's, `speed` times as fast as they were recorded,
+// 0 for as fast as they are read. p2p_replay_finished is emitted from
+// run_callbacks() once every packet was read. Receivers have to use the same
+// coalescing and fragmentation settings as the captured session.
+bool Steam::start_p2p_replay(const String& path, double speed){
+	ERR_FAIL_COND_V_MSG(network_thread_active.load(std::memory_order_acquire), false, "Replays can't start while the network thread is running.");
+	stop_p2p_replay();
+	ERR_FAIL_COND_V_MSG(!traffic_replay.open(path, speed, get_ticks_usec()), false, "Can't read a capture from " + path + ".");
+	reset_p2p_receive_cursors();
+	fragment_reassembler.clear();
+	return true;
+}
+
+void Steam::stop_p2p_replay(){
+	if (!traffic_replay.is_active()) {
+		return;
+	}
+	traffic_replay.close();
+	reset_p2p_receive_cursors();
+	fragment_reassembler.clear();
+}
+
+bool Steam::is_p2p_replaying(){
+	return traffic_replay.is_active();
+}
+
+int Steam::get_p2p_replay_remaining(){
+	return traffic_replay.get_remaining();
+}
+
+bool Steam::send_coalesced_batch(void *userdata, const SteamSendCoalescer::Batch &batch){
+	Steam *steam = (Steam *)userdata;
+	return steam->send_raw_p2p_packet(batch.steam_id, batch.data.data(), batch.data.size(), batch.send_type, batch.channel);
+}
+
+bool Steam::send_scheduled_message(void *userdata, const SteamSendScheduler::Message &message){
+	Steam *steam = (Steam *)userdata;
+	return steam->send_p2p_packet_now(message.steam_id, message.data.data(), message.data.size(), message.send_type, message.channel);
+}
+
+// Safe to call from any thread, e.g. WorkerThreadPool tasks. The packet is
+// queued without locks and sent by the next flush_p2p_packets() on the main
+// thread, through scheduling, coalescing and fragmentation like any other.
+// Packets from one thread keep their order. Returns false if the queue is
+// full, it holds STEAM_THREADED_SEND_CAPACITY packets between flushes.
+bool Steam::send_p2p_packet_threaded(uint64_t steam_id_remote, PackedByteArray data, int send_type, int channel, int priority){
+	ThreadedSend send;
+	send.steam_id_remote = steam_id_remote;
+	send.data = data;
+	send.send_type = send_type;
+	send.channel = channel;
+	send.priority = priority;
+	return threaded_sends->push(send);
+}
+
+int Steam::get_threaded_send_capacity(){
+	return threaded_sends->capacity();
+}
+
+int Steam::flush_threaded_sends(){
+	int count = 0;
+	ThreadedSend send;
+	while (threaded_sends->pop(send)) {
+		send_p2p_packet(send.steam_id_remote, send.data, send.send_type, send.channel, send.priority);
+		count++;
+	}
+	return count;
+}
+
+bool Steam::send_p2p_packet(uint64_t steam_id_remote, PackedByteArray data, int send_type, int channel, int priority){
+	return send_p2p_bytes(steam_id_remote, data.ptr(), data.size(), send_type, channel, priority);
+}
+
+// Sends the writer's buffer as is, it can be cleared and reused right away.
+bool Steam::send_p2p_writer(uint64_t steam_id_remote, const Ref<SteamPacketWriter>& writer, int send_type, int channel, int priority){
+	ERR_FAIL_COND_V(writer.is_null(), false);
+	const SteamBitWriter &stream = writer->get_stream();
+	return send_p2p_bytes(steam_id_remote, stream.get_data(), stream.get_size(), send_type, channel, priority);
+}
+
+bool Steam::send_p2p_bytes(uint64_t steam_id_remote, const uint8_t *data, uint32_t size, int send_type, int channel, int priority){
+	if (p2p_send_scheduler) {
+		bool reliable = send_type == k_EP2PSendReliable || send_type == k_EP2PSendReliableWithBuffering;
+		return send_scheduler.queue(steam_id_remote, channel, send_type, reliable, priority, data, size, get_ticks_usec());
+	}
+	return send_p2p_packet_now(steam_id_remote, data, size, send_type, channel);
+}
+
+// Reads the next message on the channel into the reader's own buffer, so no
+// PackedByteArray or Dictionary is made per message. Returns false if
+// nothing is waiting.
+bool Steam::read_p2p_packet_into(const Ref<SteamPacketReader>& reader, int channel){
+	ERR_FAIL_COND_V(reader.is_null(), false);
+	if (uses_p2p_message_path()) {
+		P2PMessage message;
+		if (!peek_p2p_message(channel, message)) {
+			return false;
+		}
+		uint8_t *buffer = reader->reserve(message.size);
+		if (message.size > 0) {
+			memcpy(buffer, message.data, message.size);
+		}
+		reader->set_received(message.size, message.steam_id_remote);
+		consume_p2p_message(channel);
+		return true;
+	}
+	uint32_t packet_size = 0;
+	if (!is_raw_p2p_packet_available(&packet_size, channel)) {
+		return false;
+	}
+	uint64_t steam_id = 0;
+	uint32_t bytesRead = 0;
+	if (!read_raw_p2p_packet(reader->reserve(packet_size), packet_size, &bytesRead, &steam_id, channel)) {
+		return false;
+	}
+	reader->set_received(bytesRead, steam_id);
+	return true;
+}
+
+bool Steam::send_p2p_packet_now(uint64_t steam_id_remote, const uint8_t *data, uint32_t size, int send_type, int channel){
+	bool unreliable = send_type == k_EP2PSendUnreliable || send_type == k_EP2PSendUnreliableNoDelay;
+	if (p2p_fragmentation && unreliable && size + 1 > p2p_fragment_size) {
+		return send_p2p_fragments(steam_id_remote, data, size, send_type, channel);
+	}
+	if (p2p_coalescing) {
+		return send_coalescer.queue(steam_id_remote, channel, send_type, data, size);
+	}
+	if (p2p_fragmentation) {
+		send_buffer.resize(size + 1);
+		send_buffer[0] = STEAM_PACKET_MESSAGE;
+		memcpy(send_buffer.data() + 1, data, size);
+		return send_raw_p2p_packet(steam_id_remote, send_buffer.data(), send_buffer.size(), send_type, channel);
+	}
+	return send_raw_p2p_packet(steam_id_remote, data, size, send_type, channel);
+}
+
+void Steam::p2p_session_request(P2PSessionRequest_t* call_data){
+	uint64_t steam_id_remote = call_data->m_steamIDRemote.ConvertToUint64();
+	if (queue_event(EVENT_P2P_SESSION_REQUEST, { (int64_t)steam_id_remote })) {
+		return;
+	}
+	dispatch_signal("p2p_session_request", steam_id_remote);
+}
+
+void Steam::p2p_session_connect_fail(P2PSessionConnectFail_t* call_data) {
+	uint64_t steam_id_remote = call_data->m_steamIDRemote.ConvertToUint64();
+	uint8_t session_error = call_data->m_eP2PSessionError;
+	if (queue_event(EVENT_P2P_SESSION_CONNECT_FAIL, { (int64_t)steam_id_remote, (int64_t)session_error })) {
+		return;
+	}
+	dispatch_signal("p2p_session_connect_fail", steam_id_remote, session_error);
+}
+
+// Networking messages
+// Parallel to the P2P functions above, on ISteamNetworkingMessages. Channels
+// and sessions are separate from the P2P ones. The packing, coalescing and
+// fragmentation options don't apply here, Steam already does all of that for
+// messages.
+bool Steam::accept_session_with_user(uint64_t steam_id_remote){
+	return backend->accept_message_session(steam_id_remote);
+}
+
+bool Steam::close_session_with_user(uint64_t steam_id_remote){
+	return backend->close_message_session(steam_id_remote);
+}
+
+// Returns the EResult, k_EResultOK (1) on success.
+int Steam::send_message_to_user(uint64_t steam_id_remote, const PackedByteArray data, int flags, int channel){
+	int result = backend->send_message(steam_id_remote, data.ptr(), data.size(), flags, channel);
+	network_stats.record_send(steam_id_remote, channel, data.size(), result == k_EResultOK);
+	return result;
+}
+
+// Sends several messages in one call, packed back to back in `data` with
+// their lengths in `sizes` (the layout receive_messages_on_channel() returns).
+// Nagle stays on for all but the last message, so Steam can pack the batch
+// into as few packets as possible. Returns how many messages were accepted.
+int Steam::send_messages_to_user(uint64_t steam_id_remote, const PackedByteArray data, const PackedInt32Array sizes, int flags, int channel){
+	const uint8_t *ptr = data.ptr();
+	int64_t offset = 0;
+	int sent = 0;
+	for (int i = 0; i < sizes.size(); i++) {
+		int32_t size = sizes[i];
+		ERR_FAIL_COND_V_MSG(size < 0 || offset + size > data.size(), sent, "Message sizes don't match the data.");
+		int message_flags = (i + 1 < sizes.size()) ? (flags & ~k_nSteamNetworkingSend_NoNagle) : flags;
+		int result = backend->send_message(steam_id_remote, ptr + offset, size, message_flags, channel);
+		network_stats.record_send(steam_id_remote, channel, size, result == k_EResultOK);
+		if (result == k_EResultOK) {
+			sent++;
+		}
+		offset += size;
+	}
+	return sent;
+}
+
+// Pulls up to max_messages with a single ReceiveMessagesOnChannel() call.
+// Same layout as read_p2p_packets(): payloads back to back in "data", message i
+// spans data[offsets[i]] .. data[offsets[i] + sizes[i]]. Each payload is
+// copied once, straight from Steam's buffer into the result.
+Dictionary Steam::receive_messages_on_channel(int channel, int max_messages){
+	Dictionary result;
+	PackedByteArray data;
+	PackedInt64Array steam_ids;
+	PackedInt32Array offsets;
+	PackedInt32Array sizes;
+	if (max_messages > 0) {
+		received_messages.resize(max_messages);
+		int count = backend->receive_messages(channel, received_messages.data(), max_messages);
+		int64_t total = 0;
+		for (int i = 0; i < count; i++) {
+			total += received_messages[i]->m_cbSize;
+		}
+		data.resize(total);
+		steam_ids.resize(count);
+		offsets.resize(count);
+		sizes.resize(count);
+		uint8_t *ptr = data.ptrw();
+		int64_t offset = 0;
+		for (int i = 0; i < count; i++) {
+			SteamNetworkingMessage_t *message = received_messages[i];
+			uint64_t steam_id_remote = message->m_identityPeer.GetSteamID64();
+			memcpy(ptr + offset, message->m_pData, message->m_cbSize);
+			steam_ids.set(i, steam_id_remote);
+			offsets.set(i, offset);
+			sizes.set(i, message->m_cbSize);
+			network_stats.record_receive(steam_id_remote, channel, message->m_cbSize);
+			offset += message->m_cbSize;
+			message->Release();
+		}
+	}
+	result["data"] = data;
+	result["steam_id_remote"] = steam_ids;
+	result["offsets"] = offsets;
+	result["sizes"] = sizes;
+	return result;
+}
+
+void Steam::network_messages_session_request(SteamNetworkingMessagesSessionRequest_t* call_data){
+	uint64_t steam_id_remote = call_data->m_identityRemote.GetSteamID64();
+	if (queue_event(EVENT_NETWORK_MESSAGES_SESSION_REQUEST, { (int64_t)steam_id_remote })) {
+		return;
+	}
+	dispatch_signal("network_messages_session_request", steam_id_remote);
+}
+
+void Steam::network_messages_session_failed(SteamNetworkingMessagesSessionFailed_t* call_data){
+	uint64_t steam_id_remote = call_data->m_info.m_identityRemote.GetSteamID64();
+	int end_reason = call_data->m_info.m_eEndReason;
+	if (queue_event(EVENT_NETWORK_MESSAGES_SESSION_FAILED, { (int64_t)steam_id_remote, (int64_t)end_reason })) {
+		return;
+	}
+	dispatch_signal("network_messages_session_failed", steam_id_remote, end_reason);
+}
@@ -45,39 +45,346 @@
 
 #include <steam/steam_api.h>
 
+#include <atomic>
+#include <deque>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "steam_backend.h"
+#include "steam_cloud_streamer.h"
+#include "steam_fragment_reassembler.h"
+#include "steam_loopback_network.h"
+#include "steam_mpsc_queue.h"
+#include "steam_network_stats.h"
+#include "steam_packet_pool.h"
+#include "steam_packet_reader.h"
+#include "steam_packet_writer.h"
+#include "steam_send_coalescer.h"
+#include "steam_send_scheduler.h"
+#include "steam_spsc_queue.h"
+#include "steam_traffic_log.h"
+
 using namespace godot;
 
-class SteamRef : public RefCounted {
-	GDCLASS(SteamRef, RefCounted);
+#define STEAM_LOBBY_SEARCH_CACHE_SIZE 32
+#define STEAM_LOBBY_SEARCH_CACHE_TTL_MSEC 60000
+#define STEAM_LOBBY_SEARCH_TIMEOUT_MSEC 10000
+#define STEAM_PERSONA_REQUEST_TIMEOUT_MSEC 10000
+// Fixed, senders on other threads hold on to the queue at any time.
+#define STEAM_THREADED_SEND_CAPACITY 1024
+
+class Steam;
+
+// Engine singleton holding a Steam instance that lives outside the scene
+// tree, so no Control has to be added to use it. Callbacks are pumped from
+// the main loop, every process frame or physics tick, optionally capped at
+// pump_rate runs per second.
+class SteamRef : public Object {
+	GDCLASS(SteamRef, Object);
+
+public:
+	enum PumpMode {
+		PUMP_MANUAL,
+		PUMP_PROCESS,
+		PUMP_PHYSICS,
+	};
+
+private:
+	static SteamRef *singleton;
+	Steam *steam = nullptr;
+	int pump_mode = PUMP_PROCESS;
+	int pump_rate = 0;
+	uint64_t next_pump_usec = 0;
+	StringName pump_signal;
+	void connect_main_loop();
+	void disconnect_main_loop();
 
 protected:
-	static void _bind_methods() {}
+	static void _bind_methods();
 
 public:
+	static SteamRef *get_singleton();
+	Steam *get_steam();
+	void set_pump_mode(int mode);
+	int get_pump_mode();
+	void set_pump_rate(int rate);
+	int get_pump_rate();
+	void _pump();
+
 	SteamRef();
 	~SteamRef();
 };
 
-class Steam : public Control {
+class Steam : public Control, public SteamCallbackSink {
 	GDCLASS(Steam, Control);
 
+public:
+	enum EventType {
+		EVENT_PERSONA_STATE_CHANGE,
+		EVENT_LOBBY_CREATED,
+		EVENT_LOBBY_JOINED,
+		EVENT_LOBBY_DATA_UPDATE,
+		EVENT_LOBBY_CHAT_UPDATE,
+		EVENT_LOBBY_CHAT_MESSAGE,
+		EVENT_LOBBY_INVITE,
+		EVENT_LOBBY_JOIN_REQUESTED,
+		EVENT_P2P_SESSION_REQUEST,
+		EVENT_P2P_SESSION_CONNECT_FAIL,
+		EVENT_NETWORK_MESSAGES_SESSION_REQUEST,
+		EVENT_NETWORK_MESSAGES_SESSION_FAILED,
+		EVENT_USER_STATS_RECEIVED,
+		EVENT_USER_STATS_STORED,
+		EVENT_USER_ACHIEVEMENT_STORED,
+		EVENT_MAX
+	};
+
+	enum P2PPriority {
+		P2P_PRIORITY_CRITICAL = SteamSendScheduler::PRIORITY_CRITICAL,
+		P2P_PRIORITY_HIGH = SteamSendScheduler::PRIORITY_HIGH,
+		P2P_PRIORITY_NORMAL = SteamSendScheduler::PRIORITY_NORMAL,
+		P2P_PRIORITY_LOW = SteamSendScheduler::PRIORITY_LOW,
+	};
+
 private:
+	// User
+	void persona_state_change(PersonaStateChange_t *call_data);
+
+	// User stats
+	void user_stats_received(UserStatsReceived_t *call_data);
+	void user_stats_stored(UserStatsStored_t *call_data);
+	void user_achievement_stored(UserAchievementStored_t *call_data);
+
 	// Lobby
-	STEAM_CALLBACK(Steam, lobby_match_list, LobbyMatchList_t, callbackLobbyMatchList);
-	STEAM_CALLBACK(Steam, lobby_created, LobbyCreated_t, callbackLobbyCreated);
-	STEAM_CALLBACK(Steam, lobby_joined, LobbyEnter_t, callbackLobbyJoined);
-	STEAM_CALLBACK(Steam, lobby_data_update, LobbyDataUpdate_t, callbackLobbyDataUpdate);
-	STEAM_CALLBACK(Steam, lobby_chat_update, LobbyChatUpdate_t, callbackLobbyChatUpdate);
-	STEAM_CALLBACK(Steam, lobby_chat_message, LobbyChatMsg_t, callbackLobbyMessage);
-	STEAM_CALLBACK(Steam, lobby_invite, LobbyInvite_t, callbackLobbyInvite);
-	STEAM_CALLBACK(Steam, lobby_join_requested, GameLobbyJoinRequested_t, callbackLobbyJoinRequested);
+	void lobby_match_list(LobbyMatchList_t *call_data);
+	void lobby_created(LobbyCreated_t *call_data);
+	void lobby_joined(LobbyEnter_t *call_data);
+	void lobby_data_update(LobbyDataUpdate_t *call_data);
+	void lobby_chat_update(LobbyChatUpdate_t *call_data);
+	void lobby_chat_message(LobbyChatMsg_t *call_data);
+	void lobby_invite(LobbyInvite_t *call_data);
+	void lobby_join_requested(GameLobbyJoinRequested_t *call_data);
 
 	// P2P
-	STEAM_CALLBACK(Steam, p2p_session_request, P2PSessionRequest_t, callbackP2PSessionRequest);
-	STEAM_CALLBACK(Steam, p2p_session_connect_fail, P2PSessionConnectFail_t, callbackP2PSessionConnectFail);
+	void p2p_session_request(P2PSessionRequest_t *call_data);
+	void p2p_session_connect_fail(P2PSessionConnectFail_t *call_data);
+
+	// Networking messages
+	void network_messages_session_request(SteamNetworkingMessagesSessionRequest_t *call_data);
+	void network_messages_session_failed(SteamNetworkingMessagesSessionFailed_t *call_data);
+	std::vector<SteamNetworkingMessage_t *> received_messages;
+
+	// Callback subscriptions, checked at most once per run_callbacks().
+	static const int CALLBACK_SUBSCRIPTION_MAX = 10;
+	uint32_t callback_pump = 1;
+	uint32_t subscription_checked[CALLBACK_SUBSCRIPTION_MAX] = {};
+	bool subscription_connected[CALLBACK_SUBSCRIPTION_MAX] = {};
+	bool is_callback_subscribed(int callback);
+
+	// Backend, the real Steam client unless use_loopback_backend() was called.
+	SteamBackend *backend = nullptr;
+	Ref<SteamLoopbackNetwork> loopback_network;
+	SteamLoopbackEndpoint *loopback_endpoint = nullptr;
+	void detach_loopback_backend();
+
+	// Persona names, filled from persona_state_change.
+	std::mutex persona_mutex;
+	std::unordered_map<uint64_t, String> persona_names;
+	// Lookups in flight, by the time they were sent.
+	std::unordered_map<uint64_t, uint64_t> persona_requests;
+	String request_persona_name(uint64_t steam_id);
+
+	// User stats write-back cache, main thread only except for the flags.
+	// Increments stay deltas until the flush, so they land on the value Steam
+	// loaded rather than on whatever was known when they were made.
+	struct PendingStat {
+		bool is_float = false;
+		bool has_value = false;
+		int32_t int_value = 0;
+		float float_value = 0.0f;
+		int32_t int_delta = 0;
+		double float_delta = 0.0;
+	};
+	std::unordered_map<std::string, PendingStat> pending_stats;
+	std::unordered_map<std::string, bool> pending_achievements;
+	uint64_t stats_store_interval_usec = 60000000;
+	uint64_t stats_last_store_usec = 0;
+	// Set on Steam but StoreStats() refused, retried with the next flush.
+	bool stats_unstored = false;
+	std::atomic<bool> stats_loaded{ false };
+	std::atomic<bool> stats_store_in_flight{ false };
+	PendingStat &get_pending_stat(const std::string &name, bool is_float);
+	bool resolve_stat(const std::string &name, const PendingStat &stat, PendingStat &r_value);
+	bool flush_user_stats(bool force);
+
+	// Cloud saves, results are emitted from run_callbacks().
+	SteamCloudStreamer cloud_streamer;
+	void flush_cloud_results();
+
+	// Lobby member cache, callbacks may update it from the network thread.
+	std::mutex lobby_members_mutex;
+	std::unordered_map<uint64_t, PackedInt64Array> lobby_members;
+	PackedInt64Array query_lobby_members(uint64_t steam_lobby_id);
+	void refresh_lobby_members(uint64_t steam_lobby_id);
+	void update_lobby_members(uint64_t steam_lobby_id, uint64_t changed_id, uint32_t chat_state);
+
+	// Lobby search
+	struct LobbyFilter {
+		bool distance = false;
+		std::string key;
+		std::string value;
+		int comparison = 0;
+	};
+	struct LobbySearchEntry {
+		uint64_t time_usec = 0;
+		Dictionary result;
+	};
+	// One queued lobby list request, plain ones only emit lobby_match_list.
+	struct LobbySearch {
+		bool plain = false;
+		uint64_t start_usec = 0;
+		std::string signature;
+		PackedStringArray keys;
+		std::vector<LobbyFilter> filters;
+	};
+	std::vector<LobbyFilter> lobby_filters;
+	std::string lobby_filter_signature;
+	std::mutex lobby_search_mutex;
+	// The front search is the one Steam is answering.
+	std::deque<LobbySearch> lobby_searches;
+	std::unordered_map<std::string, LobbySearchEntry> lobby_search_cache;
+	void queue_lobby_search(LobbySearch &p_search);
+	void start_lobby_search();
+	void prune_lobby_search_cache(uint64_t now);
+	Dictionary build_lobby_search_result(const Array& lobbies, const PackedStringArray& data_keys);
+
+	// Binary lobby chat, batched per lobby and paced by flush_lobby_chat().
+	struct LobbyChatQueue {
+		uint64_t lobby_id = 0;
+		std::vector<uint8_t> pending;
+		std::deque<std::vector<uint8_t>> ready;
+	};
+	std::vector<LobbyChatQueue> lobby_chat_queues;
+	size_t lobby_chat_next = 0;
+	double lobby_chat_rate = 4.0;
+	double lobby_chat_burst = 4.0;
+	double lobby_chat_tokens = 4.0;
+	uint64_t lobby_chat_refill_usec = 0;
+	LobbyChatQueue &get_lobby_chat_queue(uint64_t steam_lobby_id);
+	void emit_lobby_chat_bytes(uint64_t lobby_id, uint64_t user, const uint8_t *data, int size);
+
+	SteamPacketPool receive_pool;
+
+	// Network stats
+	SteamNetworkStats network_stats;
+	bool network_monitors = false;
+	bool send_raw_p2p_packet(uint64_t steam_id_remote, const void *data, uint32_t size, int send_type, int channel);
+	bool read_raw_p2p_packet(void *buffer, uint32_t size, uint32_t *r_read, uint64_t *r_steam_id, int channel);
+	bool is_raw_p2p_packet_available(uint32_t *r_size, int channel);
+
+	// Traffic capture and replay
+	std::atomic<bool> traffic_capture{ false };
+	SteamTrafficRecorder traffic_recorder;
+	SteamTrafficReplay traffic_replay;
+
+	// Message path, see uses_p2p_message_path()
+	struct P2PMessage {
+		const uint8_t *data = nullptr;
+		uint32_t size = 0;
+		uint64_t steam_id_remote = 0;
+	};
+	struct P2PReceiveCursor {
+		int handle = -1;
+		uint32_t offset = 0;
+		uint32_t next_offset = 0;
+		bool framed = false;
+	};
+	std::unordered_map<int, P2PReceiveCursor> receive_cursors;
+
+	int receive_raw_p2p_packet(int channel);
+	bool uses_p2p_message_path();
+	bool next_p2p_packet(int channel, P2PReceiveCursor &cursor);
+	bool peek_p2p_message(int channel, P2PMessage &r_message);
+	void consume_p2p_message(int channel);
+	void reset_p2p_receive_cursors();
+
+	// Send coalescing
+	bool p2p_coalescing = false;
+	SteamSendCoalescer send_coalescer;
+	static bool send_coalesced_batch(void *userdata, const SteamSendCoalescer::Batch &batch);
+
+	// Send scheduling
+	bool p2p_send_scheduler = false;
+	SteamSendScheduler send_scheduler;
+	static bool send_scheduled_message(void *userdata, const SteamSendScheduler::Message &message);
+	bool send_p2p_packet_now(uint64_t steam_id_remote, const uint8_t *data, uint32_t size, int send_type, int channel);
+	bool send_p2p_bytes(uint64_t steam_id_remote, const uint8_t *data, uint32_t size, int send_type, int channel, int priority);
+
+	// Sends queued from other threads, drained by flush_p2p_packets().
+	struct ThreadedSend {
+		uint64_t steam_id_remote = 0;
+		PackedByteArray data;
+		int send_type = 0;
+		int channel = 0;
+		int priority = 0;
+	};
+	std::unique_ptr<SteamMPSCQueue<ThreadedSend>> threaded_sends;
+	int flush_threaded_sends();
+
+	// Fragmentation
+	bool p2p_fragmentation = false;
+	uint32_t p2p_fragment_size = 1200;
+	uint32_t p2p_max_message_size = 1024 * 1024;
+	uint16_t next_fragment_message_id = 0;
+	SteamFragmentReassembler fragment_reassembler;
+	std::vector<uint8_t> send_buffer;
+	bool send_p2p_fragments(uint64_t steam_id_remote, const uint8_t *data, uint32_t size, int send_type, int channel);
+
+	// Network thread
+	std::thread network_thread;
+	std::atomic<bool> network_thread_active{ false };
+	int network_thread_rate = 0;
+	std::unique_ptr<SteamSPSCQueue<int>> network_thread_free;
+	// Only the main thread pushes to network_thread_free, a buffer the network
+	// thread couldn't fill is kept here for its next read.
+	int network_thread_spare = -1;
+	std::vector<std::unique_ptr<SteamSPSCQueue<int>>> network_thread_received;
+
+	void network_thread_loop();
+	void network_thread_pump_packets();
+	int pop_network_thread_packet(int channel);
+	static bool is_network_thread();
+
+	// Event polling
+	struct EventColumns {
+		std::vector<int64_t> values;
+		std::vector<String> strings;
+		int count = 0;
+	};
+	std::atomic<bool> event_polling{ false };
+	std::mutex event_mutex;
+	EventColumns queued_events[EVENT_MAX];
+	EventColumns polled_events[EVENT_MAX];
+	bool queue_event(EventType type, std::initializer_list<int64_t> values, const String *text = nullptr);
+
+	// Signals raised from callbacks are deferred to the main thread while the
+	// network thread is pumping them.
+	template <class... Args>
+	void dispatch_signal(const StringName &signal, const Args &...args) {
+		if (is_network_thread()) {
+			call_deferred("emit_signal", signal, args...);
+		} else {
+			emit_signal(signal, args...);
+		}
+	}
 
 protected:
 	static void _bind_methods();
+	void _notification(int p_what);
 
 public:
 	Steam();
@@ -85,15 +392,57 @@ public:
 
 	// Internal
 	CSteamID createSteamID(uint64_t steam_id, int account_type = -1);
+	virtual void dispatch_callback(int callback, void *data) override;
+	virtual void dispatch_call_result(uint64_t call, int callback, void *data, bool io_failure) override;
 	
 	// System
-	bool init();
+	bool init(bool manual_dispatch = false);
 	void run_callbacks();
+	bool start_network_thread(int rate = 250, int channel_count = 1);
+	void stop_network_thread();
+	bool is_network_thread_running();
+	void set_event_polling(bool enabled);
+	bool is_event_polling_enabled();
+	Dictionary poll_events();
+	bool use_loopback_backend(const Ref<SteamLoopbackNetwork>& network, uint64_t steam_id);
+	void use_steamworks_backend();
+	bool is_using_loopback_backend();
+	Dictionary get_network_stats();
+	void reset_network_stats();
+	void set_network_stats_enabled(bool enabled);
+	bool is_network_stats_enabled();
+	void add_network_monitors();
+	void remove_network_monitors();
+	int64_t _get_network_monitor(int counter);
 
 	// User
 	uint64_t get_steam_id();
 	String get_persona_name();
 	String get_friend_persona_name(uint64_t steam_id);
+	void request_persona_names(const PackedInt64Array& steam_ids);
+	void clear_persona_cache();
+
+	// User stats
+	bool request_current_stats();
+	bool are_stats_loaded();
+	void set_stat_int(const String& name, int value);
+	void set_stat_float(const String& name, double value);
+	void add_stat_int(const String& name, int delta);
+	void add_stat_float(const String& name, double delta);
+	int get_stat_int(const String& name);
+	double get_stat_float(const String& name);
+	void set_achievement(const String& name);
+	void clear_achievement(const String& name);
+	bool get_achievement(const String& name);
+	bool store_stats();
+	void set_stats_store_interval(int interval_msec);
+	int get_stats_store_interval();
+	bool has_pending_stats();
+
+	// Cloud saves
+	int write_cloud_file_async(const String& file_name, const PackedByteArray& data, bool compress = false);
+	int read_cloud_file_async(const String& file_name);
+	int get_pending_cloud_requests();
 
 	// Lobby
 	void create_lobby(int lobby_type, int max_members);
@@ -103,10 +452,18 @@ public:
 	void request_lobby_list();
 	void add_request_lobby_list_string_filter(const String& key_to_match, const String& value_to_match, int comparison_type);
 	void add_request_lobby_list_distance_filter(int distance_filter);
+	bool request_lobby_search(const PackedStringArray& data_keys, int max_age_msec = 5000);
+	void clear_lobby_search_cache();
 	uint64_t get_lobby_owner(uint64_t steam_lobby_id);
 	int get_num_lobby_members(uint64_t steam_lobby_id);
 	uint64_t get_lobby_member_by_index(uint64_t steam_lobby_id, int member);
+	PackedInt64Array get_lobby_members(uint64_t steam_lobby_id);
 	bool send_lobby_chat_message(uint64_t steam_lobby_id, const String& message_body);
+	bool send_lobby_chat_bytes(uint64_t steam_lobby_id, const PackedByteArray& data);
+	int flush_lobby_chat();
+	void set_lobby_chat_rate(double messages_per_second, double burst = 4.0);
+	double get_lobby_chat_rate();
+	int get_lobby_chat_queue_size();
 
 	// P2P
 	bool accept_p2p_session_with_user(uint64_t steam_id_remote);
@@ -114,7 +471,41 @@ public:
 	bool close_p2p_session_with_user(uint64_t steam_id_remote);
 	uint32_t get_available_p2p_packet_size(int channel = 0);
 	Dictionary read_p2p_packet(uint32_t packet, int channel = 0);
-	bool send_p2p_packet(uint64_t steam_id_remote, const PackedByteArray data, int send_type, int channel = 0);
+	Dictionary read_p2p_packets(int channel = 0, int max_packets = 0);
+	void set_p2p_receive_pool(int buffer_count, int max_packet_size = 1200);
+	int read_p2p_packet_pooled(int channel = 0);
+	PackedByteArray get_pooled_packet_data(int handle);
+	int get_pooled_packet_size(int handle);
+	uint64_t get_pooled_packet_sender(int handle);
+	void release_pooled_packet(int handle);
+	void set_p2p_coalescing(bool enabled, int max_packet_size = 1200);
+	bool is_p2p_coalescing_enabled();
+	bool flush_p2p_packets();
+	void set_p2p_fragmentation(bool enabled, int max_packet_size = 1200, int timeout_msec = 500, int max_message_size = 1048576);
+	bool is_p2p_fragmentation_enabled();
+	void set_p2p_send_scheduler(bool enabled, int bytes_per_second = 65536, int burst_bytes = 16384);
+	bool is_p2p_send_scheduler_enabled();
+	void set_p2p_send_scheduler_limits(int aging_msec = 50, int max_unreliable_age_msec = 200, int max_queued_bytes = 262144);
+	void set_p2p_peer_bandwidth(uint64_t steam_id_remote, int bytes_per_second, int burst_bytes = 16384);
+	bool send_p2p_packet(uint64_t steam_id_remote, const PackedByteArray data, int send_type, int channel = 0, int priority = P2P_PRIORITY_NORMAL);
+	bool send_p2p_writer(uint64_t steam_id_remote, const Ref<SteamPacketWriter>& writer, int send_type, int channel = 0, int priority = P2P_PRIORITY_NORMAL);
+	bool read_p2p_packet_into(const Ref<SteamPacketReader>& reader, int channel = 0);
+	bool send_p2p_packet_threaded(uint64_t steam_id_remote, const PackedByteArray data, int send_type, int channel = 0, int priority = P2P_PRIORITY_NORMAL);
+	int get_threaded_send_capacity();
+	bool start_p2p_capture(const String& path);
+	void stop_p2p_capture();
+	bool is_p2p_capturing();
+	bool start_p2p_replay(const String& path, double speed = 1.0);
+	void stop_p2p_replay();
+	bool is_p2p_replaying();
+	int get_p2p_replay_remaining();
+
+	// Networking messages
+	bool accept_session_with_user(uint64_t steam_id_remote);
+	bool close_session_with_user(uint64_t steam_id_remote);
+	int send_message_to_user(uint64_t steam_id_remote, const PackedByteArray data, int flags, int channel = 0);
+	int send_messages_to_user(uint64_t steam_id_remote, const PackedByteArray data, const PackedInt32Array sizes, int flags, int channel = 0);
+	Dictionary receive_messages_on_channel(int channel = 0, int max_messages = 32);
 	
 };
 
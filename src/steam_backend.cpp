@@ -0,0 +1,522 @@
+/*************************************************************************/
+/*  steam_backend.cpp                                                    */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_backend.h"
+
+// Same conversion as Steam::createSteamID() for individual accounts.
+static CSteamID user_steam_id(uint64_t p_steam_id) {
+	CSteamID converted_steam_id;
+	converted_steam_id.Set(p_steam_id, k_EUniversePublic, k_EAccountTypeIndividual);
+	return converted_steam_id;
+}
+
+// SteamCallbackDispatcher
+void SteamCallbackDispatcher::add_sink(SteamCallbackSink *p_sink, bool p_any_thread) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	for (size_t i = 0; i < targets.size(); i++) {
+		if (targets[i].sink == p_sink) {
+			return;
+		}
+	}
+	Target target;
+	target.sink = p_sink;
+	target.any_thread = p_any_thread;
+	targets.push_back(target);
+	has_main_thread_targets = has_main_thread_targets || !p_any_thread;
+}
+
+void SteamCallbackDispatcher::remove_sink(SteamCallbackSink *p_sink) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	has_main_thread_targets = false;
+	for (size_t i = 0; i < targets.size();) {
+		if (targets[i].sink == p_sink) {
+			targets.erase(targets.begin() + i);
+			continue;
+		}
+		has_main_thread_targets = has_main_thread_targets || !targets[i].any_thread;
+		i++;
+	}
+	if (!has_main_thread_targets) {
+		deferred.clear();
+	}
+}
+
+// Off the main thread only any thread sinks are called, deferred callbacks
+// only go to the others. Handlers may add or remove sinks, so this walks a
+// copy and skips the ones that are gone by the time their turn comes.
+void SteamCallbackDispatcher::dispatch(const Deferred &p_entry, void *p_data, bool p_main_thread, bool p_deferred) {
+	std::vector<Target> current = targets;
+	for (size_t i = 0; i < current.size(); i++) {
+		if ((!p_main_thread && !current[i].any_thread) || (p_deferred && current[i].any_thread)) {
+			continue;
+		}
+		bool present = false;
+		for (size_t t = 0; t < targets.size() && !present; t++) {
+			present = targets[t].sink == current[i].sink;
+		}
+		if (!present) {
+			continue;
+		}
+		if (p_entry.call_result) {
+			current[i].sink->dispatch_call_result(p_entry.call, p_entry.callback, p_data, p_entry.io_failure);
+		} else {
+			current[i].sink->dispatch_callback(p_entry.callback, p_data);
+		}
+	}
+}
+
+void SteamCallbackDispatcher::dispatch_callback(int p_callback, void *p_data, uint32_t p_size, bool p_main_thread) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	Deferred callback;
+	callback.callback = p_callback;
+	dispatch(callback, p_data, p_main_thread, false);
+	if (!p_main_thread && has_main_thread_targets) {
+		callback.data.assign((const uint8_t *)p_data, (const uint8_t *)p_data + p_size);
+		deferred.push_back(std::move(callback));
+	}
+}
+
+void SteamCallbackDispatcher::dispatch_call_result(uint64_t p_call, int p_callback, void *p_data, uint32_t p_size, bool p_io_failure, bool p_main_thread) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	Deferred result;
+	result.call = p_call;
+	result.callback = p_callback;
+	result.call_result = true;
+	result.io_failure = p_io_failure;
+	dispatch(result, p_data, p_main_thread, false);
+	if (!p_main_thread && has_main_thread_targets) {
+		result.data.assign((const uint8_t *)p_data, (const uint8_t *)p_data + p_size);
+		deferred.push_back(std::move(result));
+	}
+}
+
+void SteamCallbackDispatcher::dispatch_deferred() {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	if (deferred.empty()) {
+		return;
+	}
+	std::deque<Deferred> pending;
+	pending.swap(deferred);
+	for (size_t i = 0; i < pending.size(); i++) {
+		dispatch(pending[i], pending[i].data.data(), true, true);
+	}
+}
+
+// Registered with Steam for one callback type or one call result while
+// Steam dispatches callbacks itself, and hands them to the backend's sinks.
+class SteamworksCallbackRelay : public CCallbackBase {
+	SteamworksBackend *backend = nullptr;
+	int size = 0;
+	bool call_result = false;
+
+public:
+	// Cleared once the call result ran.
+	SteamAPICall_t call = k_uAPICallInvalid;
+
+	SteamworksCallbackRelay(SteamworksBackend *p_backend, int p_callback, int p_size, SteamAPICall_t p_call = k_uAPICallInvalid) {
+		backend = p_backend;
+		m_iCallback = p_callback;
+		size = p_size;
+		call = p_call;
+		call_result = p_call != k_uAPICallInvalid;
+	}
+
+	~SteamworksCallbackRelay() {
+		if (call_result) {
+			if (call != k_uAPICallInvalid) {
+				SteamAPI_UnregisterCallResult(this, call);
+			}
+		} else if (m_nCallbackFlags & k_ECallbackFlagsRegistered) {
+			SteamAPI_UnregisterCallback(this);
+		}
+	}
+
+	virtual void Run(void *p_param) override {
+		backend->dispatcher.dispatch_callback(m_iCallback, p_param, size, true);
+	}
+
+	virtual void Run(void *p_param, bool p_io_failure, SteamAPICall_t p_call) override {
+		if (!call_result) {
+			Run(p_param);
+			return;
+		}
+		// Steam forgets the call once it ran, this only marks the relay as done.
+		call = k_uAPICallInvalid;
+		backend->dispatcher.dispatch_call_result(p_call, m_iCallback, p_param, size, p_io_failure, true);
+	}
+
+	virtual int GetCallbackSizeBytes() override {
+		return size;
+	}
+};
+
+// Every callback type a sink handles, relayed when Steam dispatches itself.
+struct RelayedCallback {
+	int callback;
+	int size;
+};
+
+#define RELAYED_CALLBACK(m_type) \
+	{ m_type::k_iCallback, (int)sizeof(m_type) }
+
+static const RelayedCallback relayed_callbacks[] = {
+	RELAYED_CALLBACK(PersonaStateChange_t),
+	RELAYED_CALLBACK(LobbyMatchList_t),
+	RELAYED_CALLBACK(LobbyCreated_t),
+	RELAYED_CALLBACK(LobbyEnter_t),
+	RELAYED_CALLBACK(LobbyDataUpdate_t),
+	RELAYED_CALLBACK(LobbyChatUpdate_t),
+	RELAYED_CALLBACK(LobbyChatMsg_t),
+	RELAYED_CALLBACK(LobbyInvite_t),
+	RELAYED_CALLBACK(GameLobbyJoinRequested_t),
+	RELAYED_CALLBACK(P2PSessionRequest_t),
+	RELAYED_CALLBACK(P2PSessionConnectFail_t),
+	RELAYED_CALLBACK(SteamNetworkingMessagesSessionRequest_t),
+	RELAYED_CALLBACK(SteamNetworkingMessagesSessionFailed_t),
+	RELAYED_CALLBACK(UserStatsReceived_t),
+	RELAYED_CALLBACK(UserStatsStored_t),
+	RELAYED_CALLBACK(UserAchievementStored_t),
+};
+
+// SteamworksBackend
+SteamworksBackend *SteamworksBackend::get_singleton() {
+	static SteamworksBackend singleton;
+	return &singleton;
+}
+
+// Like STEAM_CALLBACK members, the relays can be registered before SteamAPI_Init().
+SteamworksBackend::SteamworksBackend() {
+	for (size_t i = 0; i < sizeof(relayed_callbacks) / sizeof(relayed_callbacks[0]); i++) {
+		callback_relays.emplace_back(new SteamworksCallbackRelay(this, relayed_callbacks[i].callback, relayed_callbacks[i].size));
+		SteamAPI_RegisterCallback(callback_relays.back().get(), relayed_callbacks[i].callback);
+	}
+}
+
+SteamworksBackend::~SteamworksBackend() {
+	call_relays.clear();
+	callback_relays.clear();
+}
+
+void SteamworksBackend::init_manual_dispatch() {
+	std::lock_guard<std::mutex> lock(calls_mutex);
+	if (manual_dispatch.load(std::memory_order_acquire)) {
+		return;
+	}
+	// Manual dispatch delivers everything through the pipe, relays would never run.
+	callback_relays.clear();
+	call_relays.clear();
+	requested_calls.clear();
+	SteamAPI_ManualDispatch_Init();
+	manual_dispatch.store(true, std::memory_order_release);
+}
+
+// `p_any_thread` sinks must cope with callbacks on the network thread.
+void SteamworksBackend::add_sink(SteamCallbackSink *p_sink, bool p_any_thread) {
+	dispatcher.add_sink(p_sink, p_any_thread);
+}
+
+void SteamworksBackend::remove_sink(SteamCallbackSink *p_sink) {
+	dispatcher.remove_sink(p_sink);
+}
+
+void SteamworksBackend::watch_call_result(uint64_t p_call, int p_callback, int p_size) {
+	if (manual_dispatch.load(std::memory_order_acquire)) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(calls_mutex);
+	CallRequest request;
+	request.call = p_call;
+	request.callback = p_callback;
+	request.size = p_size;
+	requested_calls.push_back(request);
+}
+
+// SteamAPI_RunCallbacks() runs every callback in the process, so without
+// manual dispatch it is left to the main thread.
+void SteamworksBackend::run_callbacks(bool p_main_thread) {
+	if (manual_dispatch.load(std::memory_order_acquire)) {
+		run_manual_dispatch(p_main_thread);
+		return;
+	}
+	if (!p_main_thread) {
+		return;
+	}
+	dispatcher.dispatch_deferred();
+	{
+		std::lock_guard<std::mutex> lock(calls_mutex);
+		for (size_t i = 0; i < requested_calls.size(); i++) {
+			const CallRequest &request = requested_calls[i];
+			std::unique_ptr<SteamworksCallbackRelay> relay(new SteamworksCallbackRelay(this, request.callback, request.size, request.call));
+			SteamAPI_RegisterCallResult(relay.get(), request.call);
+			call_relays[request.call] = std::move(relay);
+		}
+		requested_calls.clear();
+	}
+	SteamAPI_RunCallbacks();
+	for (std::unordered_map<uint64_t, std::unique_ptr<SteamworksCallbackRelay>>::iterator it = call_relays.begin(); it != call_relays.end();) {
+		if (it->second->call == k_uAPICallInvalid) {
+			it = call_relays.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+// Callbacks are pulled off the pipe here and handed to every sink, which
+// lets sinks skip the ones nobody listens to before converting anything.
+// Call results are fetched before their SteamAPICallCompleted_t is freed.
+void SteamworksBackend::run_manual_dispatch(bool p_main_thread) {
+	if (p_main_thread) {
+		dispatcher.dispatch_deferred();
+	}
+	HSteamPipe pipe = SteamAPI_GetHSteamPipe();
+	SteamAPI_ManualDispatch_RunFrame(pipe);
+	CallbackMsg_t message;
+	while (SteamAPI_ManualDispatch_GetNextCallback(pipe, &message)) {
+		if (message.m_iCallback == SteamAPICallCompleted_t::k_iCallback) {
+			const SteamAPICallCompleted_t *completed = (const SteamAPICallCompleted_t *)message.m_pubParam;
+			call_result_buffer.assign(completed->m_cubParam, 0);
+			bool io_failure = false;
+			if (!SteamAPI_ManualDispatch_GetAPICallResult(pipe, completed->m_hAsyncCall, call_result_buffer.data(), completed->m_cubParam, completed->m_iCallback, &io_failure)) {
+				io_failure = true;
+				call_result_buffer.assign(completed->m_cubParam, 0);
+			}
+			dispatcher.dispatch_call_result(completed->m_hAsyncCall, completed->m_iCallback, call_result_buffer.data(), completed->m_cubParam, io_failure, p_main_thread);
+		} else {
+			dispatcher.dispatch_callback(message.m_iCallback, message.m_pubParam, message.m_cubParam, p_main_thread);
+		}
+		SteamAPI_ManualDispatch_FreeLastCallback(pipe);
+	}
+}
+
+void SteamworksBackend::dispatch_deferred() {
+	dispatcher.dispatch_deferred();
+}
+
+bool SteamworksBackend::can_run_callbacks_off_main_thread() {
+	return manual_dispatch.load(std::memory_order_acquire);
+}
+
+uint64_t SteamworksBackend::get_steam_id() {
+	if (SteamUser() == NULL) {
+		return 0;
+	}
+	return SteamUser()->GetSteamID().ConvertToUint64();
+}
+
+// P2P
+bool SteamworksBackend::accept_p2p_session(uint64_t p_steam_id) {
+	if (SteamNetworking() == NULL) {
+		return false;
+	}
+	return SteamNetworking()->AcceptP2PSessionWithUser(user_steam_id(p_steam_id));
+}
+
+bool SteamworksBackend::close_p2p_session(uint64_t p_steam_id) {
+	if (SteamNetworking() == NULL) {
+		return false;
+	}
+	return SteamNetworking()->CloseP2PSessionWithUser(user_steam_id(p_steam_id));
+}
+
+bool SteamworksBackend::allow_p2p_packet_relay(bool p_allow) {
+	if (SteamNetworking() == NULL) {
+		return false;
+	}
+	return SteamNetworking()->AllowP2PPacketRelay(p_allow);
+}
+
+bool SteamworksBackend::is_p2p_packet_available(uint32_t *r_size, int p_channel) {
+	if (SteamNetworking() == NULL) {
+		return false;
+	}
+	return SteamNetworking()->IsP2PPacketAvailable(r_size, p_channel);
+}
+
+bool SteamworksBackend::read_p2p_packet(void *r_buffer, uint32_t p_size, uint32_t *r_read, uint64_t *r_steam_id, int p_channel) {
+	if (SteamNetworking() == NULL) {
+		return false;
+	}
+	CSteamID steam_id;
+	if (!SteamNetworking()->ReadP2PPacket(r_buffer, p_size, r_read, &steam_id, p_channel)) {
+		return false;
+	}
+	*r_steam_id = steam_id.ConvertToUint64();
+	return true;
+}
+
+bool SteamworksBackend::send_p2p_packet(uint64_t p_steam_id, const void *p_data, uint32_t p_size, int p_send_type, int p_channel) {
+	if (SteamNetworking() == NULL) {
+		return false;
+	}
+	return SteamNetworking()->SendP2PPacket(user_steam_id(p_steam_id), p_data, p_size, EP2PSend(p_send_type), p_channel);
+}
+
+// Matchmaking
+void SteamworksBackend::create_lobby(int p_lobby_type, int p_max_members) {
+	if (SteamMatchmaking() != NULL) {
+		SteamMatchmaking()->CreateLobby((ELobbyType)p_lobby_type, p_max_members);
+	}
+}
+
+void SteamworksBackend::join_lobby(uint64_t p_lobby_id) {
+	if (SteamMatchmaking() != NULL) {
+		SteamMatchmaking()->JoinLobby(CSteamID((uint64)p_lobby_id));
+	}
+}
+
+void SteamworksBackend::leave_lobby(uint64_t p_lobby_id) {
+	if (SteamMatchmaking() != NULL) {
+		SteamMatchmaking()->LeaveLobby(CSteamID((uint64)p_lobby_id));
+	}
+}
+
+bool SteamworksBackend::set_lobby_data(uint64_t p_lobby_id, const char *p_key, const char *p_value) {
+	if (SteamMatchmaking() == NULL) {
+		return false;
+	}
+	return SteamMatchmaking()->SetLobbyData(CSteamID((uint64)p_lobby_id), p_key, p_value);
+}
+
+const char *SteamworksBackend::get_lobby_data(uint64_t p_lobby_id, const char *p_key) {
+	if (SteamMatchmaking() == NULL) {
+		return "";
+	}
+	return SteamMatchmaking()->GetLobbyData(CSteamID((uint64)p_lobby_id), p_key);
+}
+
+uint64_t SteamworksBackend::get_lobby_owner(uint64_t p_lobby_id) {
+	if (SteamMatchmaking() == NULL) {
+		return 0;
+	}
+	return SteamMatchmaking()->GetLobbyOwner(CSteamID((uint64)p_lobby_id)).ConvertToUint64();
+}
+
+int SteamworksBackend::get_num_lobby_members(uint64_t p_lobby_id) {
+	if (SteamMatchmaking() == NULL) {
+		return 0;
+	}
+	return SteamMatchmaking()->GetNumLobbyMembers(CSteamID((uint64)p_lobby_id));
+}
+
+uint64_t SteamworksBackend::get_lobby_member_by_index(uint64_t p_lobby_id, int p_member) {
+	if (SteamMatchmaking() == NULL) {
+		return 0;
+	}
+	return SteamMatchmaking()->GetLobbyMemberByIndex(CSteamID((uint64)p_lobby_id), p_member).ConvertToUint64();
+}
+
+int SteamworksBackend::get_lobby_member_limit(uint64_t p_lobby_id) {
+	if (SteamMatchmaking() == NULL) {
+		return 0;
+	}
+	return SteamMatchmaking()->GetLobbyMemberLimit(CSteamID((uint64)p_lobby_id));
+}
+
+void SteamworksBackend::add_lobby_list_string_filter(const char *p_key, const char *p_value, int p_comparison) {
+	if (SteamMatchmaking() != NULL) {
+		SteamMatchmaking()->AddRequestLobbyListStringFilter(p_key, p_value, (ELobbyComparison)p_comparison);
+	}
+}
+
+void SteamworksBackend::add_lobby_list_distance_filter(int p_distance) {
+	if (SteamMatchmaking() != NULL) {
+		SteamMatchmaking()->AddRequestLobbyListDistanceFilter((ELobbyDistanceFilter)p_distance);
+	}
+}
+
+void SteamworksBackend::request_lobby_list() {
+	if (SteamMatchmaking() != NULL) {
+		SteamMatchmaking()->RequestLobbyList();
+	}
+}
+
+uint64_t SteamworksBackend::get_lobby_by_index(int p_lobby) {
+	if (SteamMatchmaking() == NULL) {
+		return 0;
+	}
+	return SteamMatchmaking()->GetLobbyByIndex(p_lobby).ConvertToUint64();
+}
+
+bool SteamworksBackend::send_lobby_chat_message(uint64_t p_lobby_id, const void *p_data, int p_size) {
+	if (SteamMatchmaking() == NULL) {
+		return false;
+	}
+	return SteamMatchmaking()->SendLobbyChatMsg(CSteamID((uint64)p_lobby_id), p_data, p_size);
+}
+
+int SteamworksBackend::get_lobby_chat_entry(uint64_t p_lobby_id, int p_chat_id, uint64_t *r_user, void *r_buffer, int p_size, int *r_type) {
+	if (SteamMatchmaking() == NULL) {
+		return 0;
+	}
+	CSteamID user_id;
+	EChatEntryType type = k_EChatEntryTypeInvalid;
+	int size = SteamMatchmaking()->GetLobbyChatEntry(CSteamID((uint64)p_lobby_id), p_chat_id, &user_id, r_buffer, p_size, &type);
+	*r_user = user_id.ConvertToUint64();
+	*r_type = type;
+	return size;
+}
+
+// Networking messages
+bool SteamworksBackend::accept_message_session(uint64_t p_steam_id) {
+	if (SteamNetworkingMessages() == NULL) {
+		return false;
+	}
+	SteamNetworkingIdentity identity;
+	identity.SetSteamID64(p_steam_id);
+	return SteamNetworkingMessages()->AcceptSessionWithUser(identity);
+}
+
+bool SteamworksBackend::close_message_session(uint64_t p_steam_id) {
+	if (SteamNetworkingMessages() == NULL) {
+		return false;
+	}
+	SteamNetworkingIdentity identity;
+	identity.SetSteamID64(p_steam_id);
+	return SteamNetworkingMessages()->CloseSessionWithUser(identity);
+}
+
+int SteamworksBackend::send_message(uint64_t p_steam_id, const void *p_data, uint32_t p_size, int p_flags, int p_channel) {
+	if (SteamNetworkingMessages() == NULL) {
+		return k_EResultFail;
+	}
+	SteamNetworkingIdentity identity;
+	identity.SetSteamID64(p_steam_id);
+	return SteamNetworkingMessages()->SendMessageToUser(identity, p_data, p_size, p_flags, p_channel);
+}
+
+int SteamworksBackend::receive_messages(int p_channel, SteamNetworkingMessage_t **r_messages, int p_max) {
+	if (SteamNetworkingMessages() == NULL) {
+		return 0;
+	}
+	return SteamNetworkingMessages()->ReceiveMessagesOnChannel(p_channel, r_messages, p_max);
+}
@@ -0,0 +1,220 @@
+/*************************************************************************/
+/*  steam_backend.h                                                      */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_BACKEND_H
+#define STEAM_BACKEND_H
+
+#include <steam/steam_api.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Receives callbacks from a backend.
+// `p_callback` is the k_iCallback of the Steam struct `p_data` points to.
+class SteamCallbackSink {
+public:
+	virtual void dispatch_callback(int p_callback, void *p_data) = 0;
+	// Results of SteamAPICall_t handles, `p_data` is zeroed on an IO failure.
+	virtual void dispatch_call_result(uint64_t p_call, int p_callback, void *p_data, bool p_io_failure) {}
+	virtual ~SteamCallbackSink() {}
+};
+
+// Fans callbacks out to sinks. Sinks added with `p_any_thread` get them on
+// whichever thread runs the backend's callbacks, the others only on the main
+// thread: anything dispatched elsewhere is copied and held for them until
+// the main thread calls dispatch_deferred(). remove_sink() waits for a
+// dispatch running on another thread, so a removed sink is never called.
+class SteamCallbackDispatcher {
+	struct Target {
+		SteamCallbackSink *sink = nullptr;
+		bool any_thread = false;
+	};
+	struct Deferred {
+		uint64_t call = 0;
+		int callback = 0;
+		bool call_result = false;
+		bool io_failure = false;
+		std::vector<uint8_t> data;
+	};
+
+	std::recursive_mutex mutex;
+	std::vector<Target> targets;
+	std::deque<Deferred> deferred;
+	bool has_main_thread_targets = false;
+
+	void dispatch(const Deferred &p_entry, void *p_data, bool p_main_thread, bool p_deferred);
+
+public:
+	void add_sink(SteamCallbackSink *p_sink, bool p_any_thread);
+	void remove_sink(SteamCallbackSink *p_sink);
+	void dispatch_callback(int p_callback, void *p_data, uint32_t p_size, bool p_main_thread);
+	void dispatch_call_result(uint64_t p_call, int p_callback, void *p_data, uint32_t p_size, bool p_io_failure, bool p_main_thread);
+	void dispatch_deferred();
+};
+
+// Everything the extension asks of Steam's user, networking, networking
+// messages and matchmaking interfaces. SteamworksBackend forwards to the real client, the loopback
+// network simulates it in process.
+class SteamBackend {
+public:
+	virtual ~SteamBackend() {}
+
+	// Off the main thread, callbacks for main thread sinks are only queued,
+	// dispatch_deferred() hands them over.
+	virtual void run_callbacks(bool p_main_thread = true) = 0;
+	virtual void dispatch_deferred() = 0;
+	// Whether run_callbacks() may be called from another thread at all.
+	virtual bool can_run_callbacks_off_main_thread() = 0;
+	virtual uint64_t get_steam_id() = 0;
+
+	// P2P
+	virtual bool accept_p2p_session(uint64_t p_steam_id) = 0;
+	virtual bool close_p2p_session(uint64_t p_steam_id) = 0;
+	virtual bool allow_p2p_packet_relay(bool p_allow) = 0;
+	virtual bool is_p2p_packet_available(uint32_t *r_size, int p_channel) = 0;
+	virtual bool read_p2p_packet(void *r_buffer, uint32_t p_size, uint32_t *r_read, uint64_t *r_steam_id, int p_channel) = 0;
+	virtual bool send_p2p_packet(uint64_t p_steam_id, const void *p_data, uint32_t p_size, int p_send_type, int p_channel) = 0;
+
+	// Matchmaking
+	virtual void create_lobby(int p_lobby_type, int p_max_members) = 0;
+	virtual void join_lobby(uint64_t p_lobby_id) = 0;
+	virtual void leave_lobby(uint64_t p_lobby_id) = 0;
+	virtual bool set_lobby_data(uint64_t p_lobby_id, const char *p_key, const char *p_value) = 0;
+	virtual const char *get_lobby_data(uint64_t p_lobby_id, const char *p_key) = 0;
+	virtual uint64_t get_lobby_owner(uint64_t p_lobby_id) = 0;
+	virtual int get_num_lobby_members(uint64_t p_lobby_id) = 0;
+	virtual uint64_t get_lobby_member_by_index(uint64_t p_lobby_id, int p_member) = 0;
+	virtual int get_lobby_member_limit(uint64_t p_lobby_id) = 0;
+	virtual void add_lobby_list_string_filter(const char *p_key, const char *p_value, int p_comparison) = 0;
+	virtual void add_lobby_list_distance_filter(int p_distance) = 0;
+	virtual void request_lobby_list() = 0;
+	virtual uint64_t get_lobby_by_index(int p_lobby) = 0;
+	virtual bool send_lobby_chat_message(uint64_t p_lobby_id, const void *p_data, int p_size) = 0;
+	virtual int get_lobby_chat_entry(uint64_t p_lobby_id, int p_chat_id, uint64_t *r_user, void *r_buffer, int p_size, int *r_type) = 0;
+
+	// Networking messages
+	virtual bool accept_message_session(uint64_t p_steam_id) = 0;
+	virtual bool close_message_session(uint64_t p_steam_id) = 0;
+	// Returns an EResult.
+	virtual int send_message(uint64_t p_steam_id, const void *p_data, uint32_t p_size, int p_flags, int p_channel) = 0;
+	// Messages must be handed back with SteamNetworkingMessage_t::Release().
+	virtual int receive_messages(int p_channel, SteamNetworkingMessage_t **r_messages, int p_max) = 0;
+};
+
+class SteamworksCallbackRelay;
+
+// Steam dispatches its callbacks itself by default: run_callbacks() calls
+// SteamAPI_RunCallbacks() on the main thread, so every other STEAM_CALLBACK
+// and CCallResult in the process keeps working, and relays registered for
+// the callbacks sinks handle fan them out.
+//
+// init_manual_dispatch() opts into SteamAPI_ManualDispatch instead, which
+// is process wide: from then on only sinks see callbacks, other Steam code
+// in the process stops receiving any and must not call
+// SteamAPI_RunCallbacks(). In exchange callbacks can be run from the
+// network thread.
+class SteamworksBackend : public SteamBackend {
+	SteamCallbackDispatcher dispatcher;
+	std::atomic<bool> manual_dispatch{ false };
+	std::vector<std::unique_ptr<SteamworksCallbackRelay>> callback_relays;
+	// Call results to wait for, only used without manual dispatch.
+	struct CallRequest {
+		uint64_t call = 0;
+		int callback = 0;
+		int size = 0;
+	};
+	std::mutex calls_mutex;
+	std::vector<CallRequest> requested_calls;
+	std::unordered_map<uint64_t, std::unique_ptr<SteamworksCallbackRelay>> call_relays;
+	std::vector<uint8_t> call_result_buffer;
+
+	friend class SteamworksCallbackRelay;
+	void run_manual_dispatch(bool p_main_thread);
+
+public:
+	static SteamworksBackend *get_singleton();
+
+	SteamworksBackend();
+	~SteamworksBackend();
+
+	// Call once SteamAPI_Init() succeeded, and only if nothing else in the
+	// process uses Steam callbacks.
+	void init_manual_dispatch();
+	bool is_manual_dispatch() const { return manual_dispatch.load(std::memory_order_acquire); }
+	void add_sink(SteamCallbackSink *p_sink, bool p_any_thread = false);
+	void remove_sink(SteamCallbackSink *p_sink);
+	// Routes the result of `p_call`, a `p_size` byte struct with the id
+	// `p_callback`, to dispatch_call_result(). Manual dispatch routes every
+	// call result, without it they have to be asked for. Safe to call from
+	// any thread.
+	void watch_call_result(uint64_t p_call, int p_callback, int p_size);
+
+	virtual void run_callbacks(bool p_main_thread = true) override;
+	virtual void dispatch_deferred() override;
+	virtual bool can_run_callbacks_off_main_thread() override;
+	virtual uint64_t get_steam_id() override;
+
+	virtual bool accept_p2p_session(uint64_t p_steam_id) override;
+	virtual bool close_p2p_session(uint64_t p_steam_id) override;
+	virtual bool allow_p2p_packet_relay(bool p_allow) override;
+	virtual bool is_p2p_packet_available(uint32_t *r_size, int p_channel) override;
+	virtual bool read_p2p_packet(void *r_buffer, uint32_t p_size, uint32_t *r_read, uint64_t *r_steam_id, int p_channel) override;
+	virtual bool send_p2p_packet(uint64_t p_steam_id, const void *p_data, uint32_t p_size, int p_send_type, int p_channel) override;
+
+	virtual void create_lobby(int p_lobby_type, int p_max_members) override;
+	virtual void join_lobby(uint64_t p_lobby_id) override;
+	virtual void leave_lobby(uint64_t p_lobby_id) override;
+	virtual bool set_lobby_data(uint64_t p_lobby_id, const char *p_key, const char *p_value) override;
+	virtual const char *get_lobby_data(uint64_t p_lobby_id, const char *p_key) override;
+	virtual uint64_t get_lobby_owner(uint64_t p_lobby_id) override;
+	virtual int get_num_lobby_members(uint64_t p_lobby_id) override;
+	virtual uint64_t get_lobby_member_by_index(uint64_t p_lobby_id, int p_member) override;
+	virtual int get_lobby_member_limit(uint64_t p_lobby_id) override;
+	virtual void add_lobby_list_string_filter(const char *p_key, const char *p_value, int p_comparison) override;
+	virtual void add_lobby_list_distance_filter(int p_distance) override;
+	virtual void request_lobby_list() override;
+	virtual uint64_t get_lobby_by_index(int p_lobby) override;
+	virtual bool send_lobby_chat_message(uint64_t p_lobby_id, const void *p_data, int p_size) override;
+	virtual int get_lobby_chat_entry(uint64_t p_lobby_id, int p_chat_id, uint64_t *r_user, void *r_buffer, int p_size, int *r_type) override;
+
+	virtual bool accept_message_session(uint64_t p_steam_id) override;
+	virtual bool close_message_session(uint64_t p_steam_id) override;
+	virtual int send_message(uint64_t p_steam_id, const void *p_data, uint32_t p_size, int p_flags, int p_channel) override;
+	virtual int receive_messages(int p_channel, SteamNetworkingMessage_t **r_messages, int p_max) override;
+};
+
+#endif // ! STEAM_BACKEND_H
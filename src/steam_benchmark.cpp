@@ -0,0 +1,373 @@
+/*************************************************************************/
+/*  steam_benchmark.cpp                                                  */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifdef STEAM_BENCHMARKS
+
+#include "steam_benchmark.h"
+
+#include <godot_cpp/core/class_db.hpp>
+
+#include <chrono>
+
+using namespace godot;
+
+// Drained after this many packets so the loopback queues stay cache sized.
+#define BENCHMARK_CHUNK 1024
+
+static uint64_t get_ticks_nsec() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t benchmark_steam_id(uint32_t account) {
+	return CSteamID(account, k_EUniversePublic, k_EAccountTypeIndividual).ConvertToUint64();
+}
+
+static Dictionary make_result(int64_t operations, uint64_t nsec) {
+	Dictionary result;
+	result["operations"] = operations;
+	result["total_usec"] = (int64_t)(nsec / 1000);
+	result["ns_per_op"] = operations > 0 ? (double)nsec / operations : 0.0;
+	result["ops_per_sec"] = nsec > 0 ? operations * 1000000000.0 / nsec : 0.0;
+	return result;
+}
+
+void SteamBenchmark::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_iterations", "count"), &SteamBenchmark::set_iterations);
+	ClassDB::bind_method(D_METHOD("get_iterations"), &SteamBenchmark::get_iterations);
+	ClassDB::bind_method(D_METHOD("set_packet_size", "size"), &SteamBenchmark::set_packet_size);
+	ClassDB::bind_method(D_METHOD("get_packet_size"), &SteamBenchmark::get_packet_size);
+	ClassDB::bind_method(D_METHOD("set_lobby_count", "count"), &SteamBenchmark::set_lobby_count);
+	ClassDB::bind_method(D_METHOD("get_lobby_count"), &SteamBenchmark::get_lobby_count);
+	ClassDB::bind_method(D_METHOD("run", "names"), &SteamBenchmark::run, DEFVAL(PackedStringArray()));
+	ClassDB::bind_method(D_METHOD("get_benchmark_names"), &SteamBenchmark::get_benchmark_names);
+	ClassDB::bind_method(D_METHOD("_count_signal", "lobby_id", "changed_id", "making_change_id", "chat_state"), &SteamBenchmark::_count_signal);
+
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "iterations"), "set_iterations", "get_iterations");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "packet_size"), "set_packet_size", "get_packet_size");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "lobby_count"), "set_lobby_count", "get_lobby_count");
+}
+
+const SteamBenchmark::Benchmark SteamBenchmark::benchmarks[] = {
+	{ "send", &SteamBenchmark::bench_send },
+	{ "receive_dictionary", &SteamBenchmark::bench_receive_dictionary },
+	{ "receive_batch", &SteamBenchmark::bench_receive_batch },
+	{ "receive_pooled", &SteamBenchmark::bench_receive_pooled },
+	{ "receive_reader", &SteamBenchmark::bench_receive_reader },
+	{ "signal_emit", &SteamBenchmark::bench_signal_emit },
+	{ "signal_polled", &SteamBenchmark::bench_signal_polled },
+	{ "signal_unsubscribed", &SteamBenchmark::bench_signal_unsubscribed },
+	{ "lobby_enumeration", &SteamBenchmark::bench_lobby_enumeration },
+	{ "lobby_search", &SteamBenchmark::bench_lobby_search },
+};
+const int SteamBenchmark::benchmark_count = sizeof(SteamBenchmark::benchmarks) / sizeof(SteamBenchmark::benchmarks[0]);
+
+SteamBenchmark::~SteamBenchmark() {
+	teardown();
+}
+
+void SteamBenchmark::set_iterations(int count) {
+	iterations = MAX(count, 1);
+}
+
+int SteamBenchmark::get_iterations() const {
+	return iterations;
+}
+
+void SteamBenchmark::set_packet_size(int size) {
+	packet_size = CLAMP(size, 1, 1200);
+}
+
+int SteamBenchmark::get_packet_size() const {
+	return packet_size;
+}
+
+void SteamBenchmark::set_lobby_count(int count) {
+	lobby_count = MAX(count, 1);
+}
+
+int SteamBenchmark::get_lobby_count() const {
+	return lobby_count;
+}
+
+PackedStringArray SteamBenchmark::get_benchmark_names() const {
+	PackedStringArray names;
+	for (int i = 0; i < benchmark_count; i++) {
+		names.append(benchmarks[i].name);
+	}
+	return names;
+}
+
+// Returns { "iterations", "packet_size", "lobby_count", "results": { name:
+// { "operations", "total_usec", "ns_per_op", "ops_per_sec" } } } for the
+// named benchmarks, or all of them.
+Dictionary SteamBenchmark::run(const PackedStringArray &names) {
+	Dictionary results;
+	for (int i = 0; i < benchmark_count; i++) {
+		if (!names.is_empty() && !names.has(benchmarks[i].name)) {
+			continue;
+		}
+		// Fresh objects for each benchmark, so one can't warm or clog the next.
+		setup();
+		results[benchmarks[i].name] = (this->*benchmarks[i].func)();
+		teardown();
+	}
+	Dictionary report;
+	report["iterations"] = iterations;
+	report["packet_size"] = packet_size;
+	report["lobby_count"] = lobby_count;
+	report["results"] = results;
+	return report;
+}
+
+void SteamBenchmark::setup() {
+	network.instantiate();
+	sender = memnew(Steam);
+	receiver = memnew(Steam);
+	sender->use_loopback_backend(network, benchmark_steam_id(1));
+	receiver->use_loopback_backend(network, benchmark_steam_id(2));
+	// Packets from peers that weren't accepted are dropped.
+	receiver->accept_p2p_session_with_user(benchmark_steam_id(1));
+
+	SteamLoopbackEndpoint *owner = network->get_endpoint(benchmark_steam_id(3));
+	for (int i = 0; i < lobby_count; i++) {
+		owner->create_lobby(k_ELobbyTypePublic, 8);
+	}
+	owner->request_lobby_list();
+	for (int i = 0; i < lobby_count; i++) {
+		uint64_t lobby_id = owner->get_lobby_by_index(i);
+		owner->set_lobby_data(lobby_id, "mode", "benchmark");
+		owner->set_lobby_data(lobby_id, "map", ("map_" + std::to_string(i)).c_str());
+	}
+	// Nobody listens on the owner, this just drops its queued callbacks.
+	owner->run_callbacks();
+	signal_count = 0;
+}
+
+void SteamBenchmark::teardown() {
+	if (sender) {
+		memdelete(sender);
+		sender = nullptr;
+	}
+	if (receiver) {
+		memdelete(receiver);
+		receiver = nullptr;
+	}
+	network.unref();
+}
+
+int SteamBenchmark::preload_packets(int count) {
+	PackedByteArray payload;
+	payload.resize(packet_size);
+	payload.fill(0xA5);
+	uint64_t receiver_id = benchmark_steam_id(2);
+	int sent = 0;
+	for (int i = 0; i < count; i++) {
+		if (sender->send_p2p_packet(receiver_id, payload, k_EP2PSendUnreliable, 0)) {
+			sent++;
+		}
+	}
+	return sent;
+}
+
+void SteamBenchmark::_count_signal(int64_t lobby_id, int64_t changed_id, int64_t making_change_id, int64_t chat_state) {
+	signal_count++;
+}
+
+// Benchmarks
+Dictionary SteamBenchmark::bench_send() {
+	PackedByteArray payload;
+	payload.resize(packet_size);
+	payload.fill(0xA5);
+	uint64_t receiver_id = benchmark_steam_id(2);
+	int64_t operations = 0;
+	uint64_t elapsed = 0;
+	for (int done = 0; done < iterations; done += BENCHMARK_CHUNK) {
+		int count = MIN(BENCHMARK_CHUNK, iterations - done);
+		uint64_t start = get_ticks_nsec();
+		for (int i = 0; i < count; i++) {
+			sender->send_p2p_packet(receiver_id, payload, k_EP2PSendUnreliable, 0);
+		}
+		elapsed += get_ticks_nsec() - start;
+		operations += count;
+		receiver->read_p2p_packets(0, 0);
+	}
+	return make_result(operations, elapsed);
+}
+
+// The usual script loop: get_available_p2p_packet_size() then read_p2p_packet().
+Dictionary SteamBenchmark::bench_receive_dictionary() {
+	int64_t operations = 0;
+	uint64_t elapsed = 0;
+	for (int done = 0; done < iterations; done += BENCHMARK_CHUNK) {
+		preload_packets(MIN(BENCHMARK_CHUNK, iterations - done));
+		uint64_t start = get_ticks_nsec();
+		uint32_t size;
+		while ((size = receiver->get_available_p2p_packet_size(0)) > 0) {
+			receiver->read_p2p_packet(size, 0);
+			operations++;
+		}
+		elapsed += get_ticks_nsec() - start;
+	}
+	return make_result(operations, elapsed);
+}
+
+Dictionary SteamBenchmark::bench_receive_batch() {
+	int64_t operations = 0;
+	uint64_t elapsed = 0;
+	for (int done = 0; done < iterations; done += BENCHMARK_CHUNK) {
+		preload_packets(MIN(BENCHMARK_CHUNK, iterations - done));
+		uint64_t start = get_ticks_nsec();
+		Dictionary batch = receiver->read_p2p_packets(0, 0);
+		elapsed += get_ticks_nsec() - start;
+		operations += PackedInt32Array(batch["sizes"]).size();
+	}
+	return make_result(operations, elapsed);
+}
+
+Dictionary SteamBenchmark::bench_receive_pooled() {
+	receiver->set_p2p_receive_pool(256, 1200);
+	int64_t operations = 0;
+	uint64_t elapsed = 0;
+	for (int done = 0; done < iterations; done += BENCHMARK_CHUNK) {
+		preload_packets(MIN(BENCHMARK_CHUNK, iterations - done));
+		uint64_t start = get_ticks_nsec();
+		int handle;
+		while ((handle = receiver->read_p2p_packet_pooled(0)) >= 0) {
+			receiver->get_pooled_packet_size(handle);
+			receiver->release_pooled_packet(handle);
+			operations++;
+		}
+		elapsed += get_ticks_nsec() - start;
+	}
+	return make_result(operations, elapsed);
+}
+
+// Packets read into a reused SteamPacketReader.
+Dictionary SteamBenchmark::bench_receive_reader() {
+	Ref<SteamPacketReader> reader;
+	reader.instantiate();
+	int64_t operations = 0;
+	uint64_t elapsed = 0;
+	for (int done = 0; done < iterations; done += BENCHMARK_CHUNK) {
+		preload_packets(MIN(BENCHMARK_CHUNK, iterations - done));
+		uint64_t start = get_ticks_nsec();
+		while (receiver->read_p2p_packet_into(reader, 0)) {
+			reader->read_u32();
+			operations++;
+		}
+		elapsed += get_ticks_nsec() - start;
+	}
+	return make_result(operations, elapsed);
+}
+
+// One callback in, one signal out to a connected script callable.
+Dictionary SteamBenchmark::bench_signal_emit() {
+	receiver->connect("lobby_chat_update", Callable(this, "_count_signal"));
+	LobbyChatUpdate_t update;
+	update.m_ulSteamIDLobby = 1;
+	update.m_ulSteamIDUserChanged = benchmark_steam_id(1);
+	update.m_ulSteamIDMakingChange = benchmark_steam_id(1);
+	update.m_rgfChatMemberStateChange = k_EChatMemberStateChangeEntered;
+	uint64_t start = get_ticks_nsec();
+	for (int i = 0; i < iterations; i++) {
+		receiver->dispatch_callback(LobbyChatUpdate_t::k_iCallback, &update);
+	}
+	uint64_t elapsed = get_ticks_nsec() - start;
+	receiver->disconnect("lobby_chat_update", Callable(this, "_count_signal"));
+	ERR_FAIL_COND_V_MSG(signal_count != iterations, Dictionary(), "Lost signals while benchmarking.");
+	return make_result(iterations, elapsed);
+}
+
+// Same callbacks through set_event_polling(), polled every chunk.
+Dictionary SteamBenchmark::bench_signal_polled() {
+	receiver->set_event_polling(true);
+	LobbyChatUpdate_t update;
+	update.m_ulSteamIDLobby = 1;
+	update.m_ulSteamIDUserChanged = benchmark_steam_id(1);
+	update.m_ulSteamIDMakingChange = benchmark_steam_id(1);
+	update.m_rgfChatMemberStateChange = k_EChatMemberStateChangeEntered;
+	uint64_t start = get_ticks_nsec();
+	for (int i = 0; i < iterations; i++) {
+		receiver->dispatch_callback(LobbyChatUpdate_t::k_iCallback, &update);
+		if ((i + 1) % BENCHMARK_CHUNK == 0) {
+			receiver->poll_events();
+		}
+	}
+	receiver->poll_events();
+	uint64_t elapsed = get_ticks_nsec() - start;
+	receiver->set_event_polling(false);
+	return make_result(iterations, elapsed);
+}
+
+// Callbacks nobody is connected to, which are dropped before conversion.
+Dictionary SteamBenchmark::bench_signal_unsubscribed() {
+	LobbyDataUpdate_t update;
+	update.m_ulSteamIDLobby = 1;
+	update.m_ulSteamIDMember = benchmark_steam_id(1);
+	update.m_bSuccess = 1;
+	uint64_t start = get_ticks_nsec();
+	for (int i = 0; i < iterations; i++) {
+		receiver->dispatch_callback(LobbyDataUpdate_t::k_iCallback, &update);
+	}
+	uint64_t elapsed = get_ticks_nsec() - start;
+	return make_result(iterations, elapsed);
+}
+
+// Per lobby cost of request_lobby_list() up to the lobby_match_list signal.
+Dictionary SteamBenchmark::bench_lobby_enumeration() {
+	int rounds = MAX(iterations / lobby_count / 10, 1);
+	uint64_t start = get_ticks_nsec();
+	for (int i = 0; i < rounds; i++) {
+		receiver->request_lobby_list();
+		receiver->run_callbacks();
+	}
+	uint64_t elapsed = get_ticks_nsec() - start;
+	return make_result((int64_t)rounds * lobby_count, elapsed);
+}
+
+// Like lobby_enumeration, with two data keys read per lobby and no cache hits.
+Dictionary SteamBenchmark::bench_lobby_search() {
+	PackedStringArray keys;
+	keys.append("mode");
+	keys.append("map");
+	int rounds = MAX(iterations / lobby_count / 10, 1);
+	uint64_t start = get_ticks_nsec();
+	for (int i = 0; i < rounds; i++) {
+		receiver->clear_lobby_search_cache();
+		receiver->request_lobby_search(keys, 0);
+		receiver->run_callbacks();
+	}
+	uint64_t elapsed = get_ticks_nsec() - start;
+	return make_result((int64_t)rounds * lobby_count, elapsed);
+}
+
+#endif // STEAM_BENCHMARKS
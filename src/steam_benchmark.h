@@ -0,0 +1,105 @@
+/*************************************************************************/
+/*  steam_benchmark.h                                                    */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_BENCHMARK_H
+#define STEAM_BENCHMARK_H
+
+#ifdef STEAM_BENCHMARKS
+
+#include <godot_cpp/classes/ref_counted.hpp>
+
+#include "steam.h"
+#include "steam_loopback_network.h"
+
+using namespace godot;
+
+// Times the per packet and per callback paths of Steam against a
+// SteamLoopbackNetwork with no latency, so only our own overhead is
+// measured. Only built with `scons benchmarks=yes`, see
+// demo/benchmark/benchmark.gd for the runner.
+class SteamBenchmark : public RefCounted {
+	GDCLASS(SteamBenchmark, RefCounted);
+
+	struct Benchmark {
+		const char *name;
+		Dictionary (SteamBenchmark::*func)();
+	};
+
+private:
+	static const Benchmark benchmarks[];
+	static const int benchmark_count;
+
+	int iterations = 100000;
+	int packet_size = 64;
+	int lobby_count = 50;
+
+	Ref<SteamLoopbackNetwork> network;
+	Steam *sender = nullptr;
+	Steam *receiver = nullptr;
+	int64_t signal_count = 0;
+
+	void setup();
+	void teardown();
+	int preload_packets(int count);
+	void _count_signal(int64_t lobby_id, int64_t changed_id, int64_t making_change_id, int64_t chat_state);
+
+	Dictionary bench_send();
+	Dictionary bench_receive_dictionary();
+	Dictionary bench_receive_batch();
+	Dictionary bench_receive_pooled();
+	Dictionary bench_receive_reader();
+	Dictionary bench_signal_emit();
+	Dictionary bench_signal_polled();
+	Dictionary bench_signal_unsubscribed();
+	Dictionary bench_lobby_enumeration();
+	Dictionary bench_lobby_search();
+
+protected:
+	static void _bind_methods();
+
+public:
+	void set_iterations(int count);
+	int get_iterations() const;
+	void set_packet_size(int size);
+	int get_packet_size() const;
+	void set_lobby_count(int count);
+	int get_lobby_count() const;
+
+	Dictionary run(const PackedStringArray &names = PackedStringArray());
+	PackedStringArray get_benchmark_names() const;
+
+	~SteamBenchmark();
+};
+
+#endif // STEAM_BENCHMARKS
+
+#endif // ! STEAM_BENCHMARK_H
@@ -0,0 +1,176 @@
+/*************************************************************************/
+/*  steam_bit_stream.cpp                                                 */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_bit_stream.h"
+
+#include <cmath>
+#include <cstring>
+
+uint32_t SteamBitWriter::quantize(float p_value, float p_min, float p_max, int p_bits) {
+	uint32_t steps = p_bits >= 32 ? UINT32_MAX : (1u << p_bits) - 1;
+	if (!(p_max > p_min) || !(p_value > p_min)) {
+		// NaN ends up here too.
+		return 0;
+	}
+	if (p_value >= p_max) {
+		return steps;
+	}
+	return (uint32_t)std::llround((double)(p_value - p_min) / (double)(p_max - p_min) * steps);
+}
+
+float SteamBitWriter::dequantize(uint32_t p_value, float p_min, float p_max, int p_bits) {
+	uint32_t steps = p_bits >= 32 ? UINT32_MAX : (1u << p_bits) - 1;
+	return (float)(p_min + (double)p_value / steps * ((double)p_max - p_min));
+}
+
+void SteamBitWriter::clear() {
+	buffer.clear();
+	bit_position = 0;
+}
+
+void SteamBitWriter::write_bits(uint64_t p_value, int p_bits) {
+	if (p_bits <= 0) {
+		return;
+	}
+	if (p_bits < 64) {
+		p_value &= (1ULL << p_bits) - 1;
+	}
+	size_t needed = (bit_position + p_bits + 7) >> 3;
+	if (buffer.size() < needed) {
+		buffer.resize(needed, 0);
+	}
+	while (p_bits > 0) {
+		int offset = bit_position & 7;
+		int count = 8 - offset < p_bits ? 8 - offset : p_bits;
+		buffer[bit_position >> 3] |= (uint8_t)((p_value & ((1u << count) - 1)) << offset);
+		p_value >>= count;
+		p_bits -= count;
+		bit_position += count;
+	}
+}
+
+void SteamBitWriter::write_varint(uint64_t p_value) {
+	while (p_value >= 0x80) {
+		write_bits((p_value & 0x7F) | 0x80, 8);
+		p_value >>= 7;
+	}
+	write_bits(p_value, 8);
+}
+
+void SteamBitWriter::write_bytes(const uint8_t *p_data, size_t p_size) {
+	if ((bit_position & 7) == 0) {
+		size_t offset = bit_position >> 3;
+		buffer.resize(offset + p_size);
+		if (p_size > 0) {
+			memcpy(buffer.data() + offset, p_data, p_size);
+		}
+		bit_position += p_size * 8;
+		return;
+	}
+	for (size_t i = 0; i < p_size; i++) {
+		write_bits(p_data[i], 8);
+	}
+}
+
+void SteamBitWriter::align() {
+	bit_position = (bit_position + 7) & ~(size_t)7;
+}
+
+void SteamBitReader::set_data(const uint8_t *p_data, size_t p_size) {
+	data = p_data;
+	bit_size = p_size * 8;
+	bit_position = 0;
+	error = false;
+}
+
+uint64_t SteamBitReader::read_bits(int p_bits) {
+	if (p_bits <= 0) {
+		return 0;
+	}
+	if ((size_t)p_bits > bit_size - bit_position) {
+		error = true;
+		bit_position = bit_size;
+		return 0;
+	}
+	uint64_t value = 0;
+	int shift = 0;
+	while (shift < p_bits) {
+		int offset = bit_position & 7;
+		int count = 8 - offset < p_bits - shift ? 8 - offset : p_bits - shift;
+		value |= (uint64_t)((data[bit_position >> 3] >> offset) & ((1u << count) - 1)) << shift;
+		shift += count;
+		bit_position += count;
+	}
+	return value;
+}
+
+uint64_t SteamBitReader::read_varint() {
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		uint64_t byte = read_bits(8);
+		value |= (byte & 0x7F) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+	}
+	error = true;
+	return 0;
+}
+
+bool SteamBitReader::read_bytes(uint8_t *r_data, size_t p_size) {
+	if (p_size * 8 > bit_size - bit_position) {
+		error = true;
+		bit_position = bit_size;
+		return false;
+	}
+	if ((bit_position & 7) == 0) {
+		if (p_size > 0) {
+			memcpy(r_data, data + (bit_position >> 3), p_size);
+		}
+		bit_position += p_size * 8;
+		return true;
+	}
+	for (size_t i = 0; i < p_size; i++) {
+		r_data[i] = (uint8_t)read_bits(8);
+	}
+	return true;
+}
+
+void SteamBitReader::set_error() {
+	error = true;
+	bit_position = bit_size;
+}
+
+void SteamBitReader::align() {
+	size_t aligned = (bit_position + 7) & ~(size_t)7;
+	bit_position = aligned < bit_size ? aligned : bit_size;
+}
@@ -0,0 +1,89 @@
+/*************************************************************************/
+/*  steam_bit_stream.h                                                   */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_BIT_STREAM_H
+#define STEAM_BIT_STREAM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bits are packed least significant first, so a value written with N bits
+// takes exactly N bits and byte sized writes on a byte boundary produce
+// ordinary little endian bytes. Varints are LEB128, signed values are
+// zig-zag encoded first so small magnitudes stay small either way.
+class SteamBitWriter {
+	std::vector<uint8_t> buffer;
+	size_t bit_position = 0;
+
+public:
+	static uint64_t zigzag_encode(int64_t p_value) { return ((uint64_t)p_value << 1) ^ (uint64_t)(p_value >> 63); }
+	static int64_t zigzag_decode(uint64_t p_value) { return (int64_t)(p_value >> 1) ^ -(int64_t)(p_value & 1); }
+	// Maps p_value in [p_min, p_max] onto [0, 2^p_bits - 1], clamping outside values.
+	static uint32_t quantize(float p_value, float p_min, float p_max, int p_bits);
+	static float dequantize(uint32_t p_value, float p_min, float p_max, int p_bits);
+
+	// Keeps the buffer's capacity for the next packet.
+	void clear();
+	void write_bits(uint64_t p_value, int p_bits);
+	void write_varint(uint64_t p_value);
+	void write_bytes(const uint8_t *p_data, size_t p_size);
+	// Pads with zero bits up to the next byte boundary.
+	void align();
+
+	const uint8_t *get_data() const { return buffer.data(); }
+	size_t get_size() const { return (bit_position + 7) >> 3; }
+	size_t get_bit_size() const { return bit_position; }
+};
+
+// Reads what SteamBitWriter wrote. Reading past the end returns zeros and
+// sets the error flag instead of failing on every call.
+class SteamBitReader {
+	const uint8_t *data = nullptr;
+	size_t bit_size = 0;
+	size_t bit_position = 0;
+	bool error = false;
+
+public:
+	void set_data(const uint8_t *p_data, size_t p_size);
+	uint64_t read_bits(int p_bits);
+	uint64_t read_varint();
+	bool read_bytes(uint8_t *r_data, size_t p_size);
+	void align();
+	// For callers that find the data inconsistent, e.g. a bad length.
+	void set_error();
+
+	bool has_error() const { return error; }
+	size_t get_remaining_bits() const { return bit_size - bit_position; }
+};
+
+#endif // ! STEAM_BIT_STREAM_H
@@ -0,0 +1,313 @@
+/*************************************************************************/
+/*  steam_cloud_streamer.cpp                                             */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_cloud_streamer.h"
+
+#include <godot_cpp/classes/file_access.hpp>
+
+#include <steam/steam_api.h>
+
+#include <cstring>
+
+#include "steam_backend.h"
+
+static void write_u32(uint8_t *r_buffer, uint32_t p_value) {
+	for (int i = 0; i < 4; i++) {
+		r_buffer[i] = (uint8_t)(p_value >> (8 * i));
+	}
+}
+
+static uint32_t read_u32(const uint8_t *p_buffer) {
+	uint32_t value = 0;
+	for (int i = 0; i < 4; i++) {
+		value |= (uint32_t)p_buffer[i] << (8 * i);
+	}
+	return value;
+}
+
+int SteamCloudStreamer::queue(Job &p_job) {
+	std::lock_guard<std::mutex> lock(mutex);
+	p_job.request_id = next_request_id++;
+	jobs.push_back(p_job);
+	if (!running) {
+		stopping.store(false, std::memory_order_release);
+		running = true;
+		thread = std::thread(&SteamCloudStreamer::thread_loop, this);
+	}
+	condition.notify_one();
+	return p_job.request_id;
+}
+
+// `p_data` is shared, not copied, later changes by the caller copy on write.
+int SteamCloudStreamer::queue_write(const String &p_file_name, const PackedByteArray &p_data, bool p_compress) {
+	Job job;
+	job.operation = OPERATION_WRITE;
+	job.file_name = p_file_name;
+	job.data = p_data;
+	job.compress = p_compress;
+	return queue(job);
+}
+
+int SteamCloudStreamer::queue_read(const String &p_file_name) {
+	Job job;
+	job.operation = OPERATION_READ;
+	job.file_name = p_file_name;
+	return queue(job);
+}
+
+void SteamCloudStreamer::take_results(std::vector<Result> &r_results) {
+	std::lock_guard<std::mutex> lock(mutex);
+	r_results.swap(results);
+	results.clear();
+}
+
+int SteamCloudStreamer::get_pending_count() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return jobs.size() + busy;
+}
+
+void SteamCloudStreamer::stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!running) {
+			return;
+		}
+		for (std::deque<Job>::iterator it = jobs.begin(); it != jobs.end();) {
+			it = it->operation == OPERATION_READ ? jobs.erase(it) : it + 1;
+		}
+		stopping.store(true, std::memory_order_release);
+		condition.notify_one();
+		read_condition.notify_one();
+	}
+	thread.join();
+	std::lock_guard<std::mutex> lock(mutex);
+	running = false;
+}
+
+void SteamCloudStreamer::thread_loop() {
+	while (true) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this]() { return !jobs.empty() || stopping.load(std::memory_order_acquire); });
+			if (jobs.empty()) {
+				return;
+			}
+			job = jobs.front();
+			jobs.pop_front();
+			busy = 1;
+		}
+		Result result;
+		result.request_id = job.request_id;
+		result.operation = job.operation;
+		result.file_name = job.file_name;
+		CharString file_name = job.file_name.utf8();
+		if (job.operation == OPERATION_WRITE) {
+			result.result = write_file(file_name.get_data(), job.data, job.compress);
+		} else {
+			result.result = read_file(file_name.get_data(), result.data);
+		}
+		// Let go of the caller's data here rather than on the next job.
+		job.data = PackedByteArray();
+		std::lock_guard<std::mutex> lock(mutex);
+		results.push_back(result);
+		busy = 0;
+	}
+}
+
+int SteamCloudStreamer::write_file(const std::string &p_file_name, const PackedByteArray &p_data, bool p_compress) {
+	ISteamRemoteStorage *storage = SteamRemoteStorage();
+	if (storage == NULL) {
+		return k_EResultNoConnection;
+	}
+	UGCFileWriteStreamHandle_t stream = storage->FileWriteStreamOpen(p_file_name.c_str());
+	if (stream == k_UGCFileWriteStreamHandleInvalid) {
+		return k_EResultFail;
+	}
+	bool written = true;
+	if (p_compress) {
+		written = storage->FileWriteStreamWriteChunk(stream, STEAM_CLOUD_COMPRESSED_MAGIC, 4);
+	}
+	int64_t size = p_data.size();
+	for (int64_t offset = 0; written && offset < size; offset += STEAM_CLOUD_CHUNK_SIZE) {
+		int64_t end = MIN(offset + STEAM_CLOUD_CHUNK_SIZE, size);
+		if (!p_compress) {
+			written = storage->FileWriteStreamWriteChunk(stream, p_data.ptr() + offset, end - offset);
+			continue;
+		}
+		PackedByteArray compressed = p_data.slice(offset, end).compress(FileAccess::COMPRESSION_ZSTD);
+		uint8_t header[8];
+		write_u32(header, end - offset);
+		write_u32(header + 4, compressed.size());
+		written = storage->FileWriteStreamWriteChunk(stream, header, sizeof(header)) && storage->FileWriteStreamWriteChunk(stream, compressed.ptr(), compressed.size());
+	}
+	if (!written) {
+		storage->FileWriteStreamCancel(stream);
+		return k_EResultFail;
+	}
+	return storage->FileWriteStreamClose(stream) ? k_EResultOK : k_EResultFail;
+}
+
+// The result comes back through the backend's call result routing. The
+// lock is held across FileReadAsync() so it can't be handled before the
+// call is known.
+int SteamCloudStreamer::read_range(const std::string &p_file_name, uint32_t p_offset, uint32_t p_size, uint8_t *r_buffer) {
+	std::unique_lock<std::mutex> lock(mutex);
+	SteamAPICall_t call = SteamRemoteStorage()->FileReadAsync(p_file_name.c_str(), p_offset, p_size);
+	if (call == k_uAPICallInvalid) {
+		return k_EResultFail;
+	}
+	read_call = call;
+	read_target = r_buffer;
+	read_size = p_size;
+	read_done = false;
+	SteamworksBackend::get_singleton()->watch_call_result(call, RemoteStorageFileReadAsyncComplete_t::k_iCallback, sizeof(RemoteStorageFileReadAsyncComplete_t));
+	read_condition.wait(lock, [this]() { return read_done || stopping.load(std::memory_order_acquire); });
+	read_call = 0;
+	read_target = nullptr;
+	return read_done ? read_result : k_EResultCancelled;
+}
+
+// FileReadAsyncComplete() may only be called from the call result handler,
+// so the chunk is copied out here, straight into the worker's buffer.
+void SteamCloudStreamer::complete_read(uint64_t p_call, const void *p_data, bool p_io_failure) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (read_call == 0 || p_call != read_call) {
+		return;
+	}
+	const RemoteStorageFileReadAsyncComplete_t *completed = (const RemoteStorageFileReadAsyncComplete_t *)p_data;
+	if (p_io_failure) {
+		read_result = k_EResultIOFailure;
+	} else if (completed->m_eResult != k_EResultOK) {
+		read_result = completed->m_eResult;
+	} else if (completed->m_cubRead != read_size || !SteamRemoteStorage()->FileReadAsyncComplete(completed->m_hFileReadAsync, read_target, read_size)) {
+		read_result = k_EResultFail;
+	} else {
+		read_result = k_EResultOK;
+	}
+	read_call = 0;
+	read_done = true;
+	read_condition.notify_one();
+}
+
+// Inflates every complete frame in `p_buffer` from `r_offset` on. Frame
+// sizes come from the file, so they're checked before anything is allocated.
+int SteamCloudStreamer::inflate_frames(const std::vector<uint8_t> &p_buffer, size_t &r_offset, bool p_end, PackedByteArray &r_data) {
+	while (p_buffer.size() - r_offset >= 8) {
+		uint32_t raw_size = read_u32(p_buffer.data() + r_offset);
+		uint32_t compressed_size = read_u32(p_buffer.data() + r_offset + 4);
+		if (raw_size > STEAM_CLOUD_CHUNK_SIZE || compressed_size > STEAM_CLOUD_MAX_FRAME_SIZE || r_data.size() + raw_size > STEAM_CLOUD_MAX_FILE_SIZE) {
+			return k_EResultInvalidParam;
+		}
+		if (p_buffer.size() - r_offset - 8 < compressed_size) {
+			break;
+		}
+		PackedByteArray compressed;
+		compressed.resize(compressed_size);
+		memcpy(compressed.ptrw(), p_buffer.data() + r_offset + 8, compressed_size);
+		PackedByteArray chunk = compressed.decompress(raw_size, FileAccess::COMPRESSION_ZSTD);
+		if ((uint32_t)chunk.size() != raw_size) {
+			return k_EResultInvalidParam;
+		}
+		int64_t size = r_data.size();
+		r_data.resize(size + raw_size);
+		memcpy(r_data.ptrw() + size, chunk.ptr(), raw_size);
+		r_offset += 8 + compressed_size;
+	}
+	if (p_end && r_offset != p_buffer.size()) {
+		return k_EResultInvalidParam;
+	}
+	return k_EResultOK;
+}
+
+// Plain files are read straight into the result. Compressed ones, recognized
+// by their magic, are inflated frame by frame as their chunks arrive, so
+// only the result and about two chunks are ever held.
+int SteamCloudStreamer::read_file(const std::string &p_file_name, PackedByteArray &r_data) {
+	ISteamRemoteStorage *storage = SteamRemoteStorage();
+	if (storage == NULL) {
+		return k_EResultNoConnection;
+	}
+	if (!storage->FileExists(p_file_name.c_str())) {
+		return k_EResultFileNotFound;
+	}
+	int32 size = storage->GetFileSize(p_file_name.c_str());
+	if (size < 0 || size > STEAM_CLOUD_MAX_FILE_SIZE) {
+		return k_EResultInvalidParam;
+	}
+	std::vector<uint8_t> buffer(MIN(size, STEAM_CLOUD_CHUNK_SIZE));
+	int result = buffer.empty() ? (int)k_EResultOK : read_range(p_file_name, 0, buffer.size(), buffer.data());
+	if (result != k_EResultOK) {
+		return result;
+	}
+	if (size < 4 || memcmp(buffer.data(), STEAM_CLOUD_COMPRESSED_MAGIC, 4) != 0) {
+		r_data.resize(size);
+		uint8_t *out = r_data.ptrw();
+		if (!buffer.empty()) {
+			memcpy(out, buffer.data(), buffer.size());
+		}
+		for (int32 offset = buffer.size(); offset < size && result == k_EResultOK; offset += STEAM_CLOUD_CHUNK_SIZE) {
+			result = read_range(p_file_name, offset, MIN(STEAM_CLOUD_CHUNK_SIZE, size - offset), out + offset);
+		}
+		if (result != k_EResultOK) {
+			r_data = PackedByteArray();
+		}
+		return result;
+	}
+	size_t consumed = 4;
+	int32 offset = buffer.size();
+	while (true) {
+		result = inflate_frames(buffer, consumed, offset == size, r_data);
+		if (result != k_EResultOK || offset == size) {
+			break;
+		}
+		// Keep the partial frame, then read the next chunk behind it.
+		buffer.erase(buffer.begin(), buffer.begin() + consumed);
+		consumed = 0;
+		size_t kept = buffer.size();
+		uint32_t length = MIN(STEAM_CLOUD_CHUNK_SIZE, size - offset);
+		buffer.resize(kept + length);
+		result = read_range(p_file_name, offset, length, buffer.data() + kept);
+		if (result != k_EResultOK) {
+			break;
+		}
+		offset += length;
+	}
+	if (result != k_EResultOK) {
+		r_data = PackedByteArray();
+	}
+	return result;
+}
+
+SteamCloudStreamer::~SteamCloudStreamer() {
+	stop();
+}
@@ -0,0 +1,126 @@
+/*************************************************************************/
+/*  steam_cloud_streamer.h                                               */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_CLOUD_STREAMER_H
+#define STEAM_CLOUD_STREAMER_H
+
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace godot;
+
+// Compressed files start with this, followed by frames of
+// [raw size u32][compressed size u32][zstd data], one per chunk.
+#define STEAM_CLOUD_COMPRESSED_MAGIC "GSCZ"
+#define STEAM_CLOUD_CHUNK_SIZE (1024 * 1024)
+// Leaves room for zstd's worst case on incompressible chunks.
+#define STEAM_CLOUD_MAX_FRAME_SIZE (STEAM_CLOUD_CHUNK_SIZE + STEAM_CLOUD_CHUNK_SIZE / 64)
+// Steam Cloud's own file size limit, also applied to inflated files.
+#define STEAM_CLOUD_MAX_FILE_SIZE (100 * 1024 * 1024)
+
+// Reads and writes Steam Cloud files on a background thread, one job at a
+// time in request order. Files are streamed chunk by chunk both ways and
+// compressed chunks are made and inflated one at a time, so memory beyond
+// the file's own data stays bounded by the chunk size. Finished jobs are
+// collected with take_results().
+class SteamCloudStreamer {
+public:
+	enum Operation {
+		OPERATION_WRITE,
+		OPERATION_READ,
+	};
+
+	struct Result {
+		int request_id = 0;
+		Operation operation = OPERATION_WRITE;
+		String file_name;
+		int result = 0;
+		PackedByteArray data;
+	};
+
+private:
+	struct Job {
+		int request_id = 0;
+		Operation operation = OPERATION_WRITE;
+		String file_name;
+		PackedByteArray data;
+		bool compress = false;
+	};
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<Job> jobs;
+	std::vector<Result> results;
+	int next_request_id = 1;
+	int busy = 0;
+	bool running = false;
+	std::atomic<bool> stopping{ false };
+	// The FileReadAsync() in flight, completed by complete_read().
+	std::condition_variable read_condition;
+	uint64_t read_call = 0;
+	uint8_t *read_target = nullptr;
+	uint32_t read_size = 0;
+	bool read_done = false;
+	int read_result = 0;
+
+	int queue(Job &p_job);
+	void thread_loop();
+	int write_file(const std::string &p_file_name, const PackedByteArray &p_data, bool p_compress);
+	int read_file(const std::string &p_file_name, PackedByteArray &r_data);
+	int read_range(const std::string &p_file_name, uint32_t p_offset, uint32_t p_size, uint8_t *r_buffer);
+	int inflate_frames(const std::vector<uint8_t> &p_buffer, size_t &r_offset, bool p_end, PackedByteArray &r_data);
+
+public:
+	// Both return the request id reported with the result.
+	int queue_write(const String &p_file_name, const PackedByteArray &p_data, bool p_compress);
+	int queue_read(const String &p_file_name);
+	void take_results(std::vector<Result> &r_results);
+	// Hands over a RemoteStorageFileReadAsyncComplete_t call result, from
+	// whichever thread runs Steam callbacks.
+	void complete_read(uint64_t p_call, const void *p_data, bool p_io_failure);
+	int get_pending_count();
+	// Finishes queued writes so saves aren't lost, queued reads are dropped.
+	void stop();
+
+	~SteamCloudStreamer();
+};
+
+#endif // ! STEAM_CLOUD_STREAMER_H
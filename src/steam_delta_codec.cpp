@@ -0,0 +1,132 @@
+/*************************************************************************/
+/*  steam_delta_codec.cpp                                                */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_delta_codec.h"
+
+#include <cstring>
+
+#include "steam_send_coalescer.h"
+
+// Zero runs shorter than this stay inside the literal, the two varints of a
+// new record would cost more than they save.
+#define DELTA_MIN_ZERO_RUN 3
+
+static inline uint8_t delta_byte(const uint8_t *p_base, size_t p_base_size, const uint8_t *p_data, size_t p_index) {
+	return p_index < p_base_size ? (uint8_t)(p_data[p_index] ^ p_base[p_index]) : p_data[p_index];
+}
+
+static void append_varint(std::vector<uint8_t> &r_buffer, uint32_t p_value) {
+	uint8_t bytes[5];
+	size_t size = SteamSendCoalescer::encode_varint(p_value, bytes);
+	r_buffer.insert(r_buffer.end(), bytes, bytes + size);
+}
+
+void SteamDeltaCodec::encode(const uint8_t *p_base, size_t p_base_size, const uint8_t *p_data, size_t p_size, std::vector<uint8_t> &r_delta) {
+	size_t i = 0;
+	while (i < p_size) {
+		size_t zero_start = i;
+		while (i < p_size && delta_byte(p_base, p_base_size, p_data, i) == 0) {
+			i++;
+		}
+		if (i == p_size) {
+			// Trailing zeros are implied by the size.
+			break;
+		}
+		size_t literal_start = i;
+		size_t literal_end = i;
+		while (i < p_size) {
+			if (delta_byte(p_base, p_base_size, p_data, i) != 0) {
+				literal_end = ++i;
+				continue;
+			}
+			size_t run = i;
+			while (run < p_size && run - i < DELTA_MIN_ZERO_RUN && delta_byte(p_base, p_base_size, p_data, run) == 0) {
+				run++;
+			}
+			if (run - i >= DELTA_MIN_ZERO_RUN || run == p_size) {
+				break;
+			}
+			i = run;
+		}
+		append_varint(r_delta, (uint32_t)(literal_start - zero_start));
+		append_varint(r_delta, (uint32_t)(literal_end - literal_start));
+		for (size_t j = literal_start; j < literal_end; j++) {
+			r_delta.push_back(delta_byte(p_base, p_base_size, p_data, j));
+		}
+		i = literal_end;
+	}
+}
+
+// Records are checked before anything is written, so a malformed delta
+// never gets `r_data` resized to whatever size it claims.
+bool SteamDeltaCodec::decode(const uint8_t *p_base, size_t p_base_size, const uint8_t *p_delta, size_t p_delta_size, size_t p_size, std::vector<uint8_t> &r_data) {
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1) {
+			r_data.resize(p_size);
+			size_t copy = p_base_size < p_size ? p_base_size : p_size;
+			if (copy > 0) {
+				memcpy(r_data.data(), p_base, copy);
+			}
+			if (p_size > copy) {
+				memset(r_data.data() + copy, 0, p_size - copy);
+			}
+		}
+		size_t position = 0;
+		size_t read = 0;
+		while (read < p_delta_size) {
+			uint32_t zeros = 0;
+			uint32_t literal = 0;
+			size_t used = SteamSendCoalescer::decode_varint(p_delta + read, p_delta_size - read, &zeros);
+			if (used == 0) {
+				return false;
+			}
+			read += used;
+			used = SteamSendCoalescer::decode_varint(p_delta + read, p_delta_size - read, &literal);
+			if (used == 0) {
+				return false;
+			}
+			read += used;
+			position += zeros;
+			if (position + literal > p_size || read + literal > p_delta_size) {
+				return false;
+			}
+			if (pass == 1) {
+				for (uint32_t j = 0; j < literal; j++) {
+					r_data[position + j] ^= p_delta[read + j];
+				}
+			}
+			position += literal;
+			read += literal;
+		}
+	}
+	return true;
+}
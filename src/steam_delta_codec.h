@@ -0,0 +1,53 @@
+/*************************************************************************/
+/*  steam_delta_codec.h                                                  */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_DELTA_CODEC_H
+#define STEAM_DELTA_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// XOR delta of a buffer against a baseline, run length encoded.
+// The XOR is zero wherever the data did not change, so the delta is a list of
+// `[zero run varint][literal length varint][literal bytes]` records covering
+// the new size. The baseline counts as zero past its end, which makes a
+// grown buffer's tail plain literals.
+class SteamDeltaCodec {
+public:
+	// Appends the delta of `p_data` against `p_base` to `r_delta`.
+	static void encode(const uint8_t *p_base, size_t p_base_size, const uint8_t *p_data, size_t p_size, std::vector<uint8_t> &r_delta);
+	// Rebuilds `p_size` bytes into `r_data`. Returns false on a malformed delta.
+	static bool decode(const uint8_t *p_base, size_t p_base_size, const uint8_t *p_delta, size_t p_delta_size, size_t p_size, std::vector<uint8_t> &r_data);
+};
+
+#endif // ! STEAM_DELTA_CODEC_H
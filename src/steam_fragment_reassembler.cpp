@@ -0,0 +1,174 @@
+/*************************************************************************/
+/*  steam_fragment_reassembler.cpp                                       */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_fragment_reassembler.h"
+
+#include <cstring>
+
+void SteamFragmentReassembler::write_header(uint8_t *r_buffer, uint16_t p_message_id, uint16_t p_index, uint16_t p_count, uint32_t p_total_size) {
+	r_buffer[0] = STEAM_PACKET_FRAGMENT;
+	r_buffer[1] = p_message_id & 0xFF;
+	r_buffer[2] = p_message_id >> 8;
+	r_buffer[3] = p_index & 0xFF;
+	r_buffer[4] = p_index >> 8;
+	r_buffer[5] = p_count & 0xFF;
+	r_buffer[6] = p_count >> 8;
+	r_buffer[7] = p_total_size & 0xFF;
+	r_buffer[8] = (p_total_size >> 8) & 0xFF;
+	r_buffer[9] = (p_total_size >> 16) & 0xFF;
+	r_buffer[10] = (p_total_size >> 24) & 0xFF;
+}
+
+uint32_t SteamFragmentReassembler::get_fragment_size(uint32_t p_total_size, uint16_t p_count) {
+	return p_count == 0 ? 0 : (p_total_size + p_count - 1) / p_count;
+}
+
+void SteamFragmentReassembler::set_limits(uint32_t p_max_fragment_size, uint32_t p_max_message_size) {
+	max_fragment_size = p_max_fragment_size;
+	max_message_size = p_max_message_size < STEAM_FRAGMENT_MAX_MESSAGE_SIZE ? p_max_message_size : STEAM_FRAGMENT_MAX_MESSAGE_SIZE;
+}
+
+// Incomplete messages give their grown buffer back, completed ones do so
+// when the caller releases them.
+void SteamFragmentReassembler::drop(Entry &p_entry) {
+	if (p_entry.handle >= 0 && pool) {
+		pool->shrink(p_entry.handle);
+		pool->release(p_entry.handle);
+	}
+	p_entry.handle = -1;
+}
+
+int SteamFragmentReassembler::add(uint64_t p_steam_id, int p_channel, const uint8_t *p_packet, uint32_t p_size, uint64_t p_now_usec) {
+	if (!pool || p_size < STEAM_FRAGMENT_HEADER_SIZE || p_packet[0] != STEAM_PACKET_FRAGMENT) {
+		return -1;
+	}
+	uint16_t message_id = (uint16_t)(p_packet[1] | (p_packet[2] << 8));
+	uint16_t index = (uint16_t)(p_packet[3] | (p_packet[4] << 8));
+	uint16_t count = (uint16_t)(p_packet[5] | (p_packet[6] << 8));
+	uint32_t total_size = (uint32_t)p_packet[7] | ((uint32_t)p_packet[8] << 8) | ((uint32_t)p_packet[9] << 16) | ((uint32_t)p_packet[10] << 24);
+	uint32_t fragment_size = get_fragment_size(total_size, count);
+	if (index >= count || fragment_size == 0 || fragment_size > max_fragment_size || total_size > max_message_size) {
+		return -1;
+	}
+	if ((total_size + fragment_size - 1) / fragment_size != count) {
+		return -1;
+	}
+	uint32_t offset = (uint32_t)index * fragment_size;
+	uint32_t expected_size = (index == count - 1) ? total_size - offset : fragment_size;
+	if (offset >= total_size || p_size - STEAM_FRAGMENT_HEADER_SIZE != expected_size) {
+		return -1;
+	}
+
+	Entry *entry = nullptr;
+	Entry *unused = nullptr;
+	for (size_t i = 0; i < entries.size(); i++) {
+		Entry &candidate = entries[i];
+		if (candidate.handle < 0) {
+			unused = unused ? unused : &candidate;
+			continue;
+		}
+		if (candidate.steam_id == p_steam_id && candidate.channel == p_channel && candidate.message_id == message_id) {
+			entry = &candidate;
+			break;
+		}
+	}
+	if (entry && (entry->count != count || entry->total_size != total_size)) {
+		// Message id wrapped around onto a stale entry.
+		drop(*entry);
+		unused = entry;
+		entry = nullptr;
+	}
+	if (!entry) {
+		int handle = pool->acquire();
+		if (handle < 0) {
+			return -1;
+		}
+		if (!unused) {
+			entries.emplace_back();
+			unused = &entries.back();
+		}
+		entry = unused;
+		entry->steam_id = p_steam_id;
+		entry->channel = p_channel;
+		entry->message_id = message_id;
+		entry->count = count;
+		entry->received = 0;
+		entry->total_size = total_size;
+		entry->started_usec = p_now_usec;
+		entry->handle = handle;
+		// Keeps its capacity across messages, so this only allocates for the biggest one seen.
+		entry->have.assign(count, 0);
+		SteamPacketPool::Slot &slot = pool->get(handle);
+		pool->reserve(handle, total_size);
+		slot.size = total_size;
+		slot.steam_id_remote = p_steam_id;
+		slot.channel = p_channel;
+	}
+	if (entry->have[index]) {
+		return -1;
+	}
+	entry->have[index] = 1;
+	entry->received++;
+	memcpy(pool->get(entry->handle).data.ptrw() + offset, p_packet + STEAM_FRAGMENT_HEADER_SIZE, expected_size);
+	if (entry->received < entry->count) {
+		return -1;
+	}
+	int handle = entry->handle;
+	entry->handle = -1;
+	return handle;
+}
+
+void SteamFragmentReassembler::expire(uint64_t p_now_usec) {
+	for (size_t i = 0; i < entries.size(); i++) {
+		Entry &entry = entries[i];
+		if (entry.handle >= 0 && p_now_usec - entry.started_usec > timeout_usec) {
+			drop(entry);
+		}
+	}
+}
+
+void SteamFragmentReassembler::clear() {
+	for (size_t i = 0; i < entries.size(); i++) {
+		drop(entries[i]);
+	}
+	entries.clear();
+}
+
+int SteamFragmentReassembler::get_pending_count() const {
+	int pending = 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].handle >= 0) {
+			pending++;
+		}
+	}
+	return pending;
+}
@@ -0,0 +1,100 @@
+/*************************************************************************/
+/*  steam_fragment_reassembler.h                                         */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_FRAGMENT_REASSEMBLER_H
+#define STEAM_FRAGMENT_REASSEMBLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "steam_packet_pool.h"
+
+// Every packet sent with fragmentation enabled starts with one of these.
+enum SteamPacketType {
+	STEAM_PACKET_MESSAGE,
+	STEAM_PACKET_BATCH,
+	STEAM_PACKET_FRAGMENT,
+};
+
+// [type u8][message id u16][index u16][count u16][total size u32]
+#define STEAM_FRAGMENT_HEADER_SIZE 11
+// Largest packet Steam sends unreliably, and the hard cap on reassembled
+// messages. Sizes come straight off the wire, these keep a single bogus
+// fragment from reserving gigabytes.
+#define STEAM_FRAGMENT_MAX_PACKET_SIZE 1200
+#define STEAM_FRAGMENT_MAX_MESSAGE_SIZE (4 * 1024 * 1024)
+
+// Collects fragments of large unreliable messages into pooled buffers.
+// Fragments of one message are all the same size except for the last one,
+// so each can be copied straight to its final offset as it arrives.
+// Messages still incomplete after the timeout are dropped.
+class SteamFragmentReassembler {
+	struct Entry {
+		uint64_t steam_id = 0;
+		int channel = 0;
+		uint16_t message_id = 0;
+		uint16_t count = 0;
+		uint16_t received = 0;
+		uint32_t total_size = 0;
+		uint64_t started_usec = 0;
+		int handle = -1;
+		std::vector<uint8_t> have;
+	};
+
+	SteamPacketPool *pool = nullptr;
+	std::vector<Entry> entries;
+	uint64_t timeout_usec = 500000;
+	uint32_t max_fragment_size = STEAM_FRAGMENT_MAX_PACKET_SIZE - STEAM_FRAGMENT_HEADER_SIZE;
+	uint32_t max_message_size = 1024 * 1024;
+
+	void drop(Entry &p_entry);
+
+public:
+	static void write_header(uint8_t *r_buffer, uint16_t p_message_id, uint16_t p_index, uint16_t p_count, uint32_t p_total_size);
+	// Size of every fragment but the last when `p_total_size` bytes are split in `p_count`.
+	static uint32_t get_fragment_size(uint32_t p_total_size, uint16_t p_count);
+
+	void set_pool(SteamPacketPool *p_pool) { pool = p_pool; }
+	void set_timeout_msec(uint32_t p_timeout) { timeout_usec = (uint64_t)p_timeout * 1000; }
+	// Fragments claiming a bigger fragment or message size are ignored.
+	void set_limits(uint32_t p_max_fragment_size, uint32_t p_max_message_size);
+
+	// Returns the pool handle holding the whole message once its last fragment
+	// arrived, -1 otherwise. The caller owns the returned handle.
+	int add(uint64_t p_steam_id, int p_channel, const uint8_t *p_packet, uint32_t p_size, uint64_t p_now_usec);
+	void expire(uint64_t p_now_usec);
+	void clear();
+	int get_pending_count() const;
+};
+
+#endif // ! STEAM_FRAGMENT_REASSEMBLER_H
@@ -0,0 +1,649 @@
+/*************************************************************************/
+/*  steam_loopback_network.cpp                                           */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_loopback_network.h"
+
+#include <godot_cpp/core/class_db.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace godot;
+
+#define LOOPBACK_UNRELIABLE_MAX_SIZE 1200
+#define LOOPBACK_RELIABLE_MAX_SIZE 1048576
+#define LOOPBACK_MESSAGE_MAX_SIZE k_cbMaxSteamNetworkingSocketsMessageSizeSend
+// Unreliable packets waiting longer than this for the link are dropped, like a full send buffer.
+#define LOOPBACK_MAX_QUEUE_USEC 250000
+// Session requests nobody accepted give up after this, dropping what was held.
+#define LOOPBACK_SESSION_REQUEST_TIMEOUT_USEC 10000000
+
+// SteamLoopbackEndpoint
+void SteamLoopbackEndpoint::add_sink(SteamCallbackSink *p_sink, bool p_any_thread) {
+	dispatcher.add_sink(p_sink, p_any_thread);
+}
+
+void SteamLoopbackEndpoint::remove_sink(SteamCallbackSink *p_sink) {
+	dispatcher.remove_sink(p_sink);
+}
+
+void SteamLoopbackEndpoint::run_callbacks(bool p_main_thread) {
+	if (p_main_thread) {
+		dispatcher.dispatch_deferred();
+	}
+	std::deque<Callback> pending;
+	{
+		std::lock_guard<std::mutex> lock(network->mutex);
+		pending.swap(callbacks);
+	}
+	// Handlers call back into the network, so dispatch without holding the lock.
+	for (size_t i = 0; i < pending.size(); i++) {
+		dispatcher.dispatch_callback(pending[i].id, pending[i].data.data(), pending[i].data.size(), p_main_thread);
+	}
+}
+
+void SteamLoopbackEndpoint::dispatch_deferred() {
+	dispatcher.dispatch_deferred();
+}
+
+bool SteamLoopbackEndpoint::can_run_callbacks_off_main_thread() {
+	return true;
+}
+
+uint64_t SteamLoopbackEndpoint::get_steam_id() {
+	return steam_id;
+}
+
+bool SteamLoopbackEndpoint::accept_p2p_session(uint64_t p_steam_id) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	sessions.insert(p_steam_id);
+	network->accept_session(session_requests, inbound, p_steam_id);
+	return true;
+}
+
+bool SteamLoopbackEndpoint::close_p2p_session(uint64_t p_steam_id) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	network->drop_session_request(session_requests, p_steam_id);
+	return sessions.erase(p_steam_id) > 0;
+}
+
+bool SteamLoopbackEndpoint::allow_p2p_packet_relay(bool p_allow) {
+	return true;
+}
+
+bool SteamLoopbackEndpoint::is_p2p_packet_available(uint32_t *r_size, int p_channel) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	std::unordered_map<int, std::multimap<uint64_t, Packet>>::iterator queue = inbound.find(p_channel);
+	if (queue == inbound.end() || queue->second.empty() || queue->second.begin()->first > SteamLoopbackNetwork::get_ticks_usec()) {
+		return false;
+	}
+	*r_size = queue->second.begin()->second.data.size();
+	return true;
+}
+
+bool SteamLoopbackEndpoint::read_p2p_packet(void *r_buffer, uint32_t p_size, uint32_t *r_read, uint64_t *r_steam_id, int p_channel) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	std::unordered_map<int, std::multimap<uint64_t, Packet>>::iterator queue = inbound.find(p_channel);
+	if (queue == inbound.end() || queue->second.empty() || queue->second.begin()->first > SteamLoopbackNetwork::get_ticks_usec()) {
+		return false;
+	}
+	const Packet &packet = queue->second.begin()->second;
+	uint32_t size = std::min<uint32_t>(p_size, packet.data.size());
+	if (size > 0) {
+		memcpy(r_buffer, packet.data.data(), size);
+	}
+	*r_read = size;
+	*r_steam_id = packet.steam_id;
+	queue->second.erase(queue->second.begin());
+	network->packets_delivered++;
+	return true;
+}
+
+bool SteamLoopbackEndpoint::send_p2p_packet(uint64_t p_steam_id, const void *p_data, uint32_t p_size, int p_send_type, int p_channel) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	return network->send(this, p_steam_id, p_data, p_size, p_send_type, p_channel);
+}
+
+void SteamLoopbackEndpoint::create_lobby(int p_lobby_type, int p_max_members) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	CSteamID lobby_id(network->next_lobby++, k_EChatInstanceFlagLobby, k_EUniversePublic, k_EAccountTypeChat);
+	SteamLoopbackNetwork::Lobby &lobby = network->lobbies[lobby_id.ConvertToUint64()];
+	lobby.owner = steam_id;
+	lobby.type = p_lobby_type;
+	lobby.member_limit = p_max_members;
+	lobby.members.push_back(steam_id);
+
+	LobbyCreated_t created;
+	created.m_eResult = k_EResultOK;
+	created.m_ulSteamIDLobby = lobby_id.ConvertToUint64();
+	queue_callback(created);
+	LobbyEnter_t entered;
+	entered.m_ulSteamIDLobby = lobby_id.ConvertToUint64();
+	entered.m_rgfChatPermissions = 0;
+	entered.m_bLocked = false;
+	entered.m_EChatRoomEnterResponse = k_EChatRoomEnterResponseSuccess;
+	queue_callback(entered);
+}
+
+void SteamLoopbackEndpoint::join_lobby(uint64_t p_lobby_id) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	SteamLoopbackNetwork::Lobby *lobby = network->get_lobby(p_lobby_id);
+	LobbyEnter_t entered;
+	entered.m_ulSteamIDLobby = p_lobby_id;
+	entered.m_rgfChatPermissions = 0;
+	entered.m_bLocked = false;
+	if (!lobby) {
+		entered.m_EChatRoomEnterResponse = k_EChatRoomEnterResponseDoesntExist;
+	} else if ((int)lobby->members.size() >= lobby->member_limit) {
+		entered.m_EChatRoomEnterResponse = k_EChatRoomEnterResponseFull;
+	} else {
+		entered.m_EChatRoomEnterResponse = k_EChatRoomEnterResponseSuccess;
+		if (std::find(lobby->members.begin(), lobby->members.end(), steam_id) == lobby->members.end()) {
+			network->broadcast_chat_update(*lobby, p_lobby_id, steam_id, k_EChatMemberStateChangeEntered);
+			lobby->members.push_back(steam_id);
+		}
+	}
+	queue_callback(entered);
+}
+
+void SteamLoopbackEndpoint::leave_lobby(uint64_t p_lobby_id) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	SteamLoopbackNetwork::Lobby *lobby = network->get_lobby(p_lobby_id);
+	if (!lobby) {
+		return;
+	}
+	std::vector<uint64_t>::iterator member = std::find(lobby->members.begin(), lobby->members.end(), steam_id);
+	if (member == lobby->members.end()) {
+		return;
+	}
+	lobby->members.erase(member);
+	if (lobby->members.empty()) {
+		network->lobbies.erase(p_lobby_id);
+		return;
+	}
+	if (lobby->owner == steam_id) {
+		lobby->owner = lobby->members[0];
+	}
+	network->broadcast_chat_update(*lobby, p_lobby_id, steam_id, k_EChatMemberStateChangeLeft);
+}
+
+bool SteamLoopbackEndpoint::set_lobby_data(uint64_t p_lobby_id, const char *p_key, const char *p_value) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	SteamLoopbackNetwork::Lobby *lobby = network->get_lobby(p_lobby_id);
+	if (!lobby || lobby->owner != steam_id) {
+		return false;
+	}
+	lobby->data[p_key] = p_value;
+	LobbyDataUpdate_t update;
+	update.m_ulSteamIDLobby = p_lobby_id;
+	update.m_ulSteamIDMember = p_lobby_id;
+	update.m_bSuccess = true;
+	for (size_t i = 0; i < lobby->members.size(); i++) {
+		network->find_endpoint(lobby->members[i])->queue_callback(update);
+	}
+	return true;
+}
+
+const char *SteamLoopbackEndpoint::get_lobby_data(uint64_t p_lobby_id, const char *p_key) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	SteamLoopbackNetwork::Lobby *lobby = network->get_lobby(p_lobby_id);
+	if (!lobby) {
+		return "";
+	}
+	std::map<std::string, std::string>::const_iterator value = lobby->data.find(p_key);
+	if (value == lobby->data.end()) {
+		return "";
+	}
+	// The lobby's own string can change as soon as the lock is released, so
+	// a copy is returned. Like Steam, it's good until the data changes.
+	std::string &copy = lobby_data_values[std::to_string(p_lobby_id) + ":" + p_key];
+	if (copy != value->second) {
+		copy = value->second;
+	}
+	return copy.c_str();
+}
+
+uint64_t SteamLoopbackEndpoint::get_lobby_owner(uint64_t p_lobby_id) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	SteamLoopbackNetwork::Lobby *lobby = network->get_lobby(p_lobby_id);
+	return lobby ? lobby->owner : 0;
+}
+
+int SteamLoopbackEndpoint::get_num_lobby_members(uint64_t p_lobby_id) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	SteamLoopbackNetwork::Lobby *lobby = network->get_lobby(p_lobby_id);
+	return lobby ? (int)lobby->members.size() : 0;
+}
+
+uint64_t SteamLoopbackEndpoint::get_lobby_member_by_index(uint64_t p_lobby_id, int p_member) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	SteamLoopbackNetwork::Lobby *lobby = network->get_lobby(p_lobby_id);
+	if (!lobby || p_member < 0 || p_member >= (int)lobby->members.size()) {
+		return 0;
+	}
+	return lobby->members[p_member];
+}
+
+int SteamLoopbackEndpoint::get_lobby_member_limit(uint64_t p_lobby_id) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	SteamLoopbackNetwork::Lobby *lobby = network->get_lobby(p_lobby_id);
+	return lobby ? lobby->member_limit : 0;
+}
+
+// Only equality filters are simulated, anything else matches every lobby.
+void SteamLoopbackEndpoint::add_lobby_list_string_filter(const char *p_key, const char *p_value, int p_comparison) {
+	if (p_comparison != k_ELobbyComparisonEqual) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(network->mutex);
+	lobby_filters.push_back(std::make_pair(std::string(p_key), std::string(p_value)));
+}
+
+void SteamLoopbackEndpoint::add_lobby_list_distance_filter(int p_distance) {
+}
+
+void SteamLoopbackEndpoint::request_lobby_list() {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	lobby_results.clear();
+	for (std::unordered_map<uint64_t, SteamLoopbackNetwork::Lobby>::const_iterator it = network->lobbies.begin(); it != network->lobbies.end(); ++it) {
+		const SteamLoopbackNetwork::Lobby &lobby = it->second;
+		if (lobby.type == k_ELobbyTypePrivate || lobby.type == k_ELobbyTypeInvisible) {
+			continue;
+		}
+		bool matches = true;
+		for (size_t f = 0; f < lobby_filters.size() && matches; f++) {
+			std::map<std::string, std::string>::const_iterator value = lobby.data.find(lobby_filters[f].first);
+			matches = value != lobby.data.end() && value->second == lobby_filters[f].second;
+		}
+		if (matches) {
+			lobby_results.push_back(it->first);
+		}
+	}
+	lobby_filters.clear();
+	LobbyMatchList_t match_list;
+	match_list.m_nLobbiesMatching = lobby_results.size();
+	queue_callback(match_list);
+}
+
+uint64_t SteamLoopbackEndpoint::get_lobby_by_index(int p_lobby) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	if (p_lobby < 0 || p_lobby >= (int)lobby_results.size()) {
+		return 0;
+	}
+	return lobby_results[p_lobby];
+}
+
+bool SteamLoopbackEndpoint::send_lobby_chat_message(uint64_t p_lobby_id, const void *p_data, int p_size) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	SteamLoopbackNetwork::Lobby *lobby = network->get_lobby(p_lobby_id);
+	if (!lobby || p_size < 0 || std::find(lobby->members.begin(), lobby->members.end(), steam_id) == lobby->members.end()) {
+		return false;
+	}
+	LobbyChatMsg_t message;
+	message.m_ulSteamIDLobby = p_lobby_id;
+	message.m_ulSteamIDUser = steam_id;
+	message.m_eChatEntryType = k_EChatEntryTypeChatMsg;
+	message.m_iChatID = lobby->chat.size();
+	lobby->chat.push_back(std::make_pair(steam_id, std::string((const char *)p_data, p_size)));
+	for (size_t i = 0; i < lobby->members.size(); i++) {
+		network->find_endpoint(lobby->members[i])->queue_callback(message);
+	}
+	return true;
+}
+
+int SteamLoopbackEndpoint::get_lobby_chat_entry(uint64_t p_lobby_id, int p_chat_id, uint64_t *r_user, void *r_buffer, int p_size, int *r_type) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	SteamLoopbackNetwork::Lobby *lobby = network->get_lobby(p_lobby_id);
+	if (!lobby || p_chat_id < 0 || p_chat_id >= (int)lobby->chat.size()) {
+		return 0;
+	}
+	const std::pair<uint64_t, std::string> &entry = lobby->chat[p_chat_id];
+	int size = std::min<int>(p_size, entry.second.size());
+	memcpy(r_buffer, entry.second.data(), size);
+	*r_user = entry.first;
+	*r_type = k_EChatEntryTypeChatMsg;
+	return size;
+}
+
+// Owns its payload, Release() deletes the whole thing.
+struct LoopbackMessage : public SteamNetworkingMessage_t {
+	std::vector<uint8_t> payload;
+
+	static void release(SteamNetworkingMessage_t *p_message) {
+		delete static_cast<LoopbackMessage *>(p_message);
+	}
+};
+
+bool SteamLoopbackEndpoint::accept_message_session(uint64_t p_steam_id) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	message_sessions.insert(p_steam_id);
+	network->accept_session(message_session_requests, message_inbound, p_steam_id);
+	return true;
+}
+
+bool SteamLoopbackEndpoint::close_message_session(uint64_t p_steam_id) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	network->drop_session_request(message_session_requests, p_steam_id);
+	return message_sessions.erase(p_steam_id) > 0;
+}
+
+int SteamLoopbackEndpoint::send_message(uint64_t p_steam_id, const void *p_data, uint32_t p_size, int p_flags, int p_channel) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	int send_type = (p_flags & k_nSteamNetworkingSend_Reliable) ? k_EP2PSendReliable : k_EP2PSendUnreliable;
+	return network->send(this, p_steam_id, p_data, p_size, send_type, p_channel, true) ? k_EResultOK : k_EResultLimitExceeded;
+}
+
+int SteamLoopbackEndpoint::receive_messages(int p_channel, SteamNetworkingMessage_t **r_messages, int p_max) {
+	std::lock_guard<std::mutex> lock(network->mutex);
+	std::unordered_map<int, std::multimap<uint64_t, Packet>>::iterator queue = message_inbound.find(p_channel);
+	if (queue == message_inbound.end()) {
+		return 0;
+	}
+	uint64_t now = SteamLoopbackNetwork::get_ticks_usec();
+	int count = 0;
+	while (count < p_max && !queue->second.empty() && queue->second.begin()->first <= now) {
+		Packet &packet = queue->second.begin()->second;
+		LoopbackMessage *message = new LoopbackMessage;
+		message->payload.swap(packet.data);
+		message->m_pData = message->payload.data();
+		message->m_cbSize = message->payload.size();
+		message->m_conn = k_HSteamNetConnection_Invalid;
+		message->m_identityPeer.SetSteamID64(packet.steam_id);
+		message->m_nConnUserData = 0;
+		message->m_usecTimeReceived = now;
+		message->m_nMessageNumber = 0;
+		message->m_pfnFreeData = nullptr;
+		message->m_pfnRelease = &LoopbackMessage::release;
+		message->m_nChannel = p_channel;
+		message->m_nFlags = 0;
+		message->m_nUserData = 0;
+		message->m_idxLane = 0;
+		r_messages[count++] = message;
+		queue->second.erase(queue->second.begin());
+		network->packets_delivered++;
+	}
+	return count;
+}
+
+// SteamLoopbackNetwork
+void SteamLoopbackNetwork::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_latency_msec", "latency"), &SteamLoopbackNetwork::set_latency_msec);
+	ClassDB::bind_method(D_METHOD("get_latency_msec"), &SteamLoopbackNetwork::get_latency_msec);
+	ClassDB::bind_method(D_METHOD("set_jitter_msec", "jitter"), &SteamLoopbackNetwork::set_jitter_msec);
+	ClassDB::bind_method(D_METHOD("get_jitter_msec"), &SteamLoopbackNetwork::get_jitter_msec);
+	ClassDB::bind_method(D_METHOD("set_loss", "loss"), &SteamLoopbackNetwork::set_loss);
+	ClassDB::bind_method(D_METHOD("get_loss"), &SteamLoopbackNetwork::get_loss);
+	ClassDB::bind_method(D_METHOD("set_reorder", "reorder"), &SteamLoopbackNetwork::set_reorder);
+	ClassDB::bind_method(D_METHOD("get_reorder"), &SteamLoopbackNetwork::get_reorder);
+	ClassDB::bind_method(D_METHOD("set_bandwidth", "bytes_per_second"), &SteamLoopbackNetwork::set_bandwidth);
+	ClassDB::bind_method(D_METHOD("get_bandwidth"), &SteamLoopbackNetwork::get_bandwidth);
+	ClassDB::bind_method(D_METHOD("set_seed", "seed"), &SteamLoopbackNetwork::set_seed);
+	ClassDB::bind_method(D_METHOD("get_peers"), &SteamLoopbackNetwork::get_peers);
+	ClassDB::bind_method(D_METHOD("get_stats"), &SteamLoopbackNetwork::get_stats);
+	ClassDB::bind_method(D_METHOD("reset_stats"), &SteamLoopbackNetwork::reset_stats);
+
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "latency_msec"), "set_latency_msec", "get_latency_msec");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "jitter_msec"), "set_jitter_msec", "get_jitter_msec");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "loss"), "set_loss", "get_loss");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "reorder"), "set_reorder", "get_reorder");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "bandwidth"), "set_bandwidth", "get_bandwidth");
+}
+
+SteamLoopbackNetwork::SteamLoopbackNetwork() :
+	random(0x5733) {
+}
+
+SteamLoopbackNetwork::~SteamLoopbackNetwork() {
+}
+
+uint64_t SteamLoopbackNetwork::get_ticks_usec() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double SteamLoopbackNetwork::random_unit() {
+	return std::uniform_real_distribution<double>(0.0, 1.0)(random);
+}
+
+SteamLoopbackEndpoint *SteamLoopbackNetwork::find_endpoint(uint64_t p_steam_id) {
+	std::unique_ptr<SteamLoopbackEndpoint> &endpoint = endpoints[p_steam_id];
+	if (!endpoint) {
+		endpoint.reset(new SteamLoopbackEndpoint);
+		endpoint->network = this;
+		endpoint->steam_id = p_steam_id;
+	}
+	return endpoint.get();
+}
+
+SteamLoopbackEndpoint *SteamLoopbackNetwork::get_endpoint(uint64_t p_steam_id) {
+	std::lock_guard<std::mutex> lock(mutex);
+	return find_endpoint(p_steam_id);
+}
+
+SteamLoopbackNetwork::Lobby *SteamLoopbackNetwork::get_lobby(uint64_t p_lobby_id) {
+	std::unordered_map<uint64_t, Lobby>::iterator lobby = lobbies.find(p_lobby_id);
+	return lobby == lobbies.end() ? nullptr : &lobby->second;
+}
+
+void SteamLoopbackNetwork::broadcast_chat_update(const Lobby &p_lobby, uint64_t p_lobby_id, uint64_t p_changed, uint32_t p_state) {
+	LobbyChatUpdate_t update;
+	update.m_ulSteamIDLobby = p_lobby_id;
+	update.m_ulSteamIDUserChanged = p_changed;
+	update.m_ulSteamIDMakingChange = p_changed;
+	update.m_rgfChatMemberStateChange = p_state;
+	for (size_t i = 0; i < p_lobby.members.size(); i++) {
+		if (p_lobby.members[i] != p_changed) {
+			find_endpoint(p_lobby.members[i])->queue_callback(update);
+		}
+	}
+}
+
+bool SteamLoopbackNetwork::send(SteamLoopbackEndpoint *p_from, uint64_t p_to, const void *p_data, uint32_t p_size, int p_send_type, int p_channel, bool p_message) {
+	bool reliable = p_send_type == k_EP2PSendReliable || p_send_type == k_EP2PSendReliableWithBuffering;
+	uint32_t max_size = p_message ? LOOPBACK_MESSAGE_MAX_SIZE : (reliable ? LOOPBACK_RELIABLE_MAX_SIZE : LOOPBACK_UNRELIABLE_MAX_SIZE);
+	if (p_size > max_size) {
+		return false;
+	}
+	packets_sent++;
+	bytes_sent += p_size;
+	std::unordered_map<uint64_t, std::unique_ptr<SteamLoopbackEndpoint>>::iterator target = endpoints.find(p_to);
+	if (target == endpoints.end()) {
+		// Steam accepts the send and fails the session later, we just lose it.
+		packets_dropped++;
+		return true;
+	}
+	uint64_t now = get_ticks_usec();
+
+	// The sender's uplink serializes packets at the configured bandwidth.
+	uint64_t depart = std::max(now, p_from->link_free_usec);
+	if (bandwidth > 0) {
+		if (!reliable && depart - now > LOOPBACK_MAX_QUEUE_USEC) {
+			packets_dropped++;
+			return true;
+		}
+		p_from->link_free_usec = depart + (uint64_t)p_size * 1000000 / bandwidth;
+		depart = p_from->link_free_usec;
+	}
+	double delay_msec = latency_msec + (random_unit() * 2.0 - 1.0) * jitter_msec;
+	if (random_unit() < loss) {
+		if (!reliable) {
+			packets_dropped++;
+			return true;
+		}
+		// Reliable traffic is resent after roughly a round trip.
+		delay_msec += latency_msec * 2.0;
+	}
+	if (!reliable && random_unit() < reorder) {
+		delay_msec += MAX(latency_msec, 1.0);
+	}
+	uint64_t deliver = depart + (uint64_t)(MAX(delay_msec, 0.0) * 1000.0);
+	if (reliable) {
+		// Reliable packets on a channel arrive in order.
+		std::string key = std::to_string(p_from->steam_id) + ":" + std::to_string(p_to) + (p_message ? ":m" : ":") + std::to_string(p_channel);
+		uint64_t &last = reliable_order[key];
+		deliver = std::max(deliver, last);
+		last = deliver;
+	}
+
+	SteamLoopbackEndpoint *to = target->second.get();
+	SteamLoopbackEndpoint::Packet packet;
+	packet.steam_id = p_from->steam_id;
+	packet.data.assign((const uint8_t *)p_data, (const uint8_t *)p_data + p_size);
+	// On first contact the remote side has to accept, like with real Steam.
+	// Until it does, packets are held back and delivered on acceptance.
+	std::unordered_set<uint64_t> &sessions = p_message ? to->message_sessions : to->sessions;
+	std::unordered_map<uint64_t, SteamLoopbackEndpoint::SessionRequest> &requests = p_message ? to->message_session_requests : to->session_requests;
+	(p_message ? p_from->message_sessions : p_from->sessions).insert(p_to);
+	if (!sessions.count(p_from->steam_id)) {
+		std::unordered_map<uint64_t, SteamLoopbackEndpoint::SessionRequest>::iterator request = requests.find(p_from->steam_id);
+		if (request != requests.end() && now - request->second.time_usec > LOOPBACK_SESSION_REQUEST_TIMEOUT_USEC) {
+			drop_session_request(requests, p_from->steam_id);
+			request = requests.end();
+		}
+		if (request == requests.end()) {
+			request = requests.insert(std::make_pair(p_from->steam_id, SteamLoopbackEndpoint::SessionRequest())).first;
+			request->second.time_usec = now;
+			if (p_message) {
+				SteamNetworkingMessagesSessionRequest_t callback;
+				callback.m_identityRemote.SetSteamID64(p_from->steam_id);
+				to->queue_callback(callback);
+			} else {
+				P2PSessionRequest_t callback;
+				callback.m_steamIDRemote = CSteamID((uint64)p_from->steam_id);
+				to->queue_callback(callback);
+			}
+		}
+		request->second.packets.push_back(std::make_pair(p_channel, std::make_pair(deliver, std::move(packet))));
+		return true;
+	}
+	(p_message ? to->message_inbound : to->inbound)[p_channel].insert(std::make_pair(deliver, std::move(packet)));
+	return true;
+}
+
+// Held packets keep their delivery time, ones that are due arrive right away.
+void SteamLoopbackNetwork::accept_session(std::unordered_map<uint64_t, SteamLoopbackEndpoint::SessionRequest> &p_requests, std::unordered_map<int, std::multimap<uint64_t, SteamLoopbackEndpoint::Packet>> &p_inbound, uint64_t p_steam_id) {
+	std::unordered_map<uint64_t, SteamLoopbackEndpoint::SessionRequest>::iterator request = p_requests.find(p_steam_id);
+	if (request == p_requests.end()) {
+		return;
+	}
+	for (size_t i = 0; i < request->second.packets.size(); i++) {
+		std::pair<int, std::pair<uint64_t, SteamLoopbackEndpoint::Packet>> &held = request->second.packets[i];
+		p_inbound[held.first].insert(std::make_pair(held.second.first, std::move(held.second.second)));
+	}
+	p_requests.erase(request);
+}
+
+void SteamLoopbackNetwork::drop_session_request(std::unordered_map<uint64_t, SteamLoopbackEndpoint::SessionRequest> &p_requests, uint64_t p_steam_id) {
+	std::unordered_map<uint64_t, SteamLoopbackEndpoint::SessionRequest>::iterator request = p_requests.find(p_steam_id);
+	if (request == p_requests.end()) {
+		return;
+	}
+	packets_dropped += request->second.packets.size();
+	p_requests.erase(request);
+}
+
+void SteamLoopbackNetwork::set_latency_msec(double p_latency) {
+	std::lock_guard<std::mutex> lock(mutex);
+	latency_msec = MAX(p_latency, 0.0);
+}
+
+double SteamLoopbackNetwork::get_latency_msec() const {
+	return latency_msec;
+}
+
+void SteamLoopbackNetwork::set_jitter_msec(double p_jitter) {
+	std::lock_guard<std::mutex> lock(mutex);
+	jitter_msec = MAX(p_jitter, 0.0);
+}
+
+double SteamLoopbackNetwork::get_jitter_msec() const {
+	return jitter_msec;
+}
+
+void SteamLoopbackNetwork::set_loss(double p_loss) {
+	std::lock_guard<std::mutex> lock(mutex);
+	loss = CLAMP(p_loss, 0.0, 1.0);
+}
+
+double SteamLoopbackNetwork::get_loss() const {
+	return loss;
+}
+
+void SteamLoopbackNetwork::set_reorder(double p_reorder) {
+	std::lock_guard<std::mutex> lock(mutex);
+	reorder = CLAMP(p_reorder, 0.0, 1.0);
+}
+
+double SteamLoopbackNetwork::get_reorder() const {
+	return reorder;
+}
+
+void SteamLoopbackNetwork::set_bandwidth(int64_t p_bytes_per_second) {
+	std::lock_guard<std::mutex> lock(mutex);
+	bandwidth = MAX(p_bytes_per_second, (int64_t)0);
+}
+
+int64_t SteamLoopbackNetwork::get_bandwidth() const {
+	return bandwidth;
+}
+
+void SteamLoopbackNetwork::set_seed(int64_t p_seed) {
+	std::lock_guard<std::mutex> lock(mutex);
+	random.seed((std::mt19937::result_type)p_seed);
+}
+
+PackedInt64Array SteamLoopbackNetwork::get_peers() {
+	std::lock_guard<std::mutex> lock(mutex);
+	PackedInt64Array peers;
+	for (std::unordered_map<uint64_t, std::unique_ptr<SteamLoopbackEndpoint>>::const_iterator it = endpoints.begin(); it != endpoints.end(); ++it) {
+		peers.append(it->first);
+	}
+	return peers;
+}
+
+Dictionary SteamLoopbackNetwork::get_stats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	Dictionary stats;
+	stats["packets_sent"] = packets_sent;
+	stats["packets_dropped"] = packets_dropped;
+	stats["packets_delivered"] = packets_delivered;
+	stats["bytes_sent"] = bytes_sent;
+	stats["lobbies"] = (int64_t)lobbies.size();
+	return stats;
+}
+
+void SteamLoopbackNetwork::reset_stats() {
+	std::lock_guard<std::mutex> lock(mutex);
+	packets_sent = 0;
+	packets_dropped = 0;
+	packets_delivered = 0;
+	bytes_sent = 0;
+}
@@ -0,0 +1,213 @@
+/*************************************************************************/
+/*  steam_loopback_network.h                                             */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_LOOPBACK_NETWORK_H
+#define STEAM_LOOPBACK_NETWORK_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "steam_backend.h"
+
+using namespace godot;
+
+class SteamLoopbackNetwork;
+
+// One virtual Steam user on a SteamLoopbackNetwork. Every Steam object (or
+// SteamMultiplayerPeer) bound to the same Steam ID shares one endpoint, like
+// objects in one process share the real Steam client.
+class SteamLoopbackEndpoint : public SteamBackend {
+	friend class SteamLoopbackNetwork;
+
+	struct Packet {
+		uint64_t steam_id = 0;
+		std::vector<uint8_t> data;
+	};
+	struct Callback {
+		int id = 0;
+		std::vector<uint8_t> data;
+	};
+	// A sender waiting to be accepted, its packets are held until then.
+	struct SessionRequest {
+		uint64_t time_usec = 0;
+		std::vector<std::pair<int, std::pair<uint64_t, Packet>>> packets;
+	};
+
+	SteamLoopbackNetwork *network = nullptr;
+	uint64_t steam_id = 0;
+	SteamCallbackDispatcher dispatcher;
+	// Packets in flight towards us, per channel, keyed by delivery time.
+	std::unordered_map<int, std::multimap<uint64_t, Packet>> inbound;
+	std::unordered_set<uint64_t> sessions;
+	std::unordered_map<uint64_t, SessionRequest> session_requests;
+	// Same for ISteamNetworkingMessages, which has its own sessions and channels.
+	std::unordered_map<int, std::multimap<uint64_t, Packet>> message_inbound;
+	std::unordered_set<uint64_t> message_sessions;
+	std::unordered_map<uint64_t, SessionRequest> message_session_requests;
+	std::deque<Callback> callbacks;
+	std::vector<uint64_t> lobby_results;
+	// Copies handed out by get_lobby_data(), by lobby and key, only replaced
+	// when the value changes.
+	std::unordered_map<std::string, std::string> lobby_data_values;
+	std::vector<std::pair<std::string, std::string>> lobby_filters;
+	uint64_t link_free_usec = 0;
+
+	template <class T>
+	void queue_callback(const T &p_data) {
+		Callback callback;
+		callback.id = T::k_iCallback;
+		callback.data.resize(sizeof(T));
+		memcpy(callback.data.data(), &p_data, sizeof(T));
+		callbacks.push_back(callback);
+	}
+
+public:
+	void add_sink(SteamCallbackSink *p_sink, bool p_any_thread = false);
+	void remove_sink(SteamCallbackSink *p_sink);
+
+	virtual void run_callbacks(bool p_main_thread = true) override;
+	virtual void dispatch_deferred() override;
+	virtual bool can_run_callbacks_off_main_thread() override;
+	virtual uint64_t get_steam_id() override;
+
+	virtual bool accept_p2p_session(uint64_t p_steam_id) override;
+	virtual bool close_p2p_session(uint64_t p_steam_id) override;
+	virtual bool allow_p2p_packet_relay(bool p_allow) override;
+	virtual bool is_p2p_packet_available(uint32_t *r_size, int p_channel) override;
+	virtual bool read_p2p_packet(void *r_buffer, uint32_t p_size, uint32_t *r_read, uint64_t *r_steam_id, int p_channel) override;
+	virtual bool send_p2p_packet(uint64_t p_steam_id, const void *p_data, uint32_t p_size, int p_send_type, int p_channel) override;
+
+	virtual void create_lobby(int p_lobby_type, int p_max_members) override;
+	virtual void join_lobby(uint64_t p_lobby_id) override;
+	virtual void leave_lobby(uint64_t p_lobby_id) override;
+	virtual bool set_lobby_data(uint64_t p_lobby_id, const char *p_key, const char *p_value) override;
+	virtual const char *get_lobby_data(uint64_t p_lobby_id, const char *p_key) override;
+	virtual uint64_t get_lobby_owner(uint64_t p_lobby_id) override;
+	virtual int get_num_lobby_members(uint64_t p_lobby_id) override;
+	virtual uint64_t get_lobby_member_by_index(uint64_t p_lobby_id, int p_member) override;
+	virtual int get_lobby_member_limit(uint64_t p_lobby_id) override;
+	virtual void add_lobby_list_string_filter(const char *p_key, const char *p_value, int p_comparison) override;
+	virtual void add_lobby_list_distance_filter(int p_distance) override;
+	virtual void request_lobby_list() override;
+	virtual uint64_t get_lobby_by_index(int p_lobby) override;
+	virtual bool send_lobby_chat_message(uint64_t p_lobby_id, const void *p_data, int p_size) override;
+	virtual int get_lobby_chat_entry(uint64_t p_lobby_id, int p_chat_id, uint64_t *r_user, void *r_buffer, int p_size, int *r_type) override;
+
+	virtual bool accept_message_session(uint64_t p_steam_id) override;
+	virtual bool close_message_session(uint64_t p_steam_id) override;
+	virtual int send_message(uint64_t p_steam_id, const void *p_data, uint32_t p_size, int p_flags, int p_channel) override;
+	virtual int receive_messages(int p_channel, SteamNetworkingMessage_t **r_messages, int p_max) override;
+};
+
+// In-process stand-in for Steam P2P and lobbies, for load tests and CI
+// machines without a Steam client. Links are modelled per sender with
+// latency, jitter, loss, reordering and a bandwidth cap. Reliable sends are
+// never lost or reordered, loss only delays them by a retransmit.
+class SteamLoopbackNetwork : public RefCounted {
+	GDCLASS(SteamLoopbackNetwork, RefCounted);
+	friend class SteamLoopbackEndpoint;
+
+	struct Lobby {
+		uint64_t owner = 0;
+		int type = 0;
+		int member_limit = 0;
+		std::vector<uint64_t> members;
+		std::map<std::string, std::string> data;
+		std::vector<std::pair<uint64_t, std::string>> chat;
+	};
+
+private:
+	std::mutex mutex;
+	std::mt19937 random;
+	std::unordered_map<uint64_t, std::unique_ptr<SteamLoopbackEndpoint>> endpoints;
+	std::unordered_map<uint64_t, Lobby> lobbies;
+	uint32_t next_lobby = 1;
+	std::unordered_map<std::string, uint64_t> reliable_order;
+
+	double latency_msec = 0.0;
+	double jitter_msec = 0.0;
+	double loss = 0.0;
+	double reorder = 0.0;
+	int64_t bandwidth = 0;
+
+	uint64_t packets_sent = 0;
+	uint64_t packets_dropped = 0;
+	uint64_t packets_delivered = 0;
+	uint64_t bytes_sent = 0;
+
+	double random_unit();
+	SteamLoopbackEndpoint *find_endpoint(uint64_t p_steam_id);
+	bool send(SteamLoopbackEndpoint *p_from, uint64_t p_to, const void *p_data, uint32_t p_size, int p_send_type, int p_channel, bool p_message = false);
+	void accept_session(std::unordered_map<uint64_t, SteamLoopbackEndpoint::SessionRequest> &p_requests, std::unordered_map<int, std::multimap<uint64_t, SteamLoopbackEndpoint::Packet>> &p_inbound, uint64_t p_steam_id);
+	void drop_session_request(std::unordered_map<uint64_t, SteamLoopbackEndpoint::SessionRequest> &p_requests, uint64_t p_steam_id);
+	Lobby *get_lobby(uint64_t p_lobby_id);
+	void broadcast_chat_update(const Lobby &p_lobby, uint64_t p_lobby_id, uint64_t p_changed, uint32_t p_state);
+
+protected:
+	static void _bind_methods();
+
+public:
+	static uint64_t get_ticks_usec();
+
+	SteamLoopbackEndpoint *get_endpoint(uint64_t p_steam_id);
+
+	void set_latency_msec(double p_latency);
+	double get_latency_msec() const;
+	void set_jitter_msec(double p_jitter);
+	double get_jitter_msec() const;
+	void set_loss(double p_loss);
+	double get_loss() const;
+	void set_reorder(double p_reorder);
+	double get_reorder() const;
+	void set_bandwidth(int64_t p_bytes_per_second);
+	int64_t get_bandwidth() const;
+	void set_seed(int64_t p_seed);
+
+	PackedInt64Array get_peers();
+	Dictionary get_stats();
+	void reset_stats();
+
+	SteamLoopbackNetwork();
+	~SteamLoopbackNetwork();
+};
+
+#endif // ! STEAM_LOOPBACK_NETWORK_H
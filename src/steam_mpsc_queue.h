@@ -0,0 +1,121 @@
+/*************************************************************************/
+/*  steam_mpsc_queue.h                                                   */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_MPSC_QUEUE_H
+#define STEAM_MPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free ring for any number of producer threads and exactly one
+// consumer. Every cell carries a sequence number telling producers and the
+// consumer whose turn it is, so a producer that claimed a cell but hasn't
+// written it yet only holds up the consumer, never other producers.
+// Capacity is rounded up to a power of two.
+template <class T>
+class SteamMPSCQueue {
+	struct Cell {
+		std::atomic<size_t> sequence{ 0 };
+		T value;
+	};
+
+	std::unique_ptr<Cell[]> cells;
+	size_t mask = 0;
+	alignas(64) std::atomic<size_t> tail{ 0 };
+	alignas(64) std::atomic<size_t> head{ 0 };
+
+public:
+	explicit SteamMPSCQueue(size_t p_capacity) {
+		size_t capacity = 1;
+		while (capacity < p_capacity) {
+			capacity <<= 1;
+		}
+		cells.reset(new Cell[capacity]);
+		for (size_t i = 0; i < capacity; i++) {
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		mask = capacity - 1;
+	}
+
+	SteamMPSCQueue(const SteamMPSCQueue &) = delete;
+	SteamMPSCQueue &operator=(const SteamMPSCQueue &) = delete;
+
+	// Producer side, any thread.
+	bool push(const T &p_value) {
+		size_t position = tail.load(std::memory_order_relaxed);
+		Cell *cell;
+		while (true) {
+			cell = &cells[position & mask];
+			size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+			if (difference == 0) {
+				if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+					break;
+				}
+			} else if (difference < 0) {
+				return false;
+			} else {
+				position = tail.load(std::memory_order_relaxed);
+			}
+		}
+		cell->value = p_value;
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side. The popped cell is reset so it doesn't keep the value alive.
+	bool pop(T &r_value) {
+		const size_t position = head.load(std::memory_order_relaxed);
+		Cell &cell = cells[position & mask];
+		if (cell.sequence.load(std::memory_order_acquire) != position + 1) {
+			return false;
+		}
+		r_value = cell.value;
+		cell.value = T();
+		cell.sequence.store(position + mask + 1, std::memory_order_release);
+		head.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Claimed cells included, so it can run ahead of what pop() returns.
+	size_t size() const {
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+	size_t capacity() const {
+		return mask + 1;
+	}
+};
+
+#endif // ! STEAM_MPSC_QUEUE_H
@@ -0,0 +1,557 @@
+/*************************************************************************/
+/*  steam_multiplayer_peer.cpp                                           */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_multiplayer_peer.h"
+
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+
+#include <chrono>
+#include <cstring>
+
+using namespace godot;
+
+// Unreliable ISteamNetworking packets are capped at 1200 bytes, reliable ones at 1MB.
+#define STEAM_P2P_RELIABLE_MAX_SIZE 1048576
+#define STEAM_P2P_UNRELIABLE_MAX_SIZE 1200
+// Data packets start with the transfer mode, ordered packets add a 16 bit sequence.
+#define STEAM_PEER_HEADER_SIZE 1
+#define STEAM_PEER_ORDERED_HEADER_SIZE 3
+// Clients repeat CONTROL_CONNECT until the host answers or they give up.
+#define STEAM_PEER_CONNECT_RETRY_USEC 250000
+#define STEAM_PEER_CONNECT_TIMEOUT_USEC 10000000
+
+static uint64_t get_ticks_usec() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SteamMultiplayerPeer::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("create_server", "max_clients", "channel_count"), &SteamMultiplayerPeer::create_server, DEFVAL(32), DEFVAL(4));
+	ClassDB::bind_method(D_METHOD("create_client", "host_steam_id", "channel_count"), &SteamMultiplayerPeer::create_client, DEFVAL(4));
+	ClassDB::bind_method(D_METHOD("set_steam_channel_base", "channel"), &SteamMultiplayerPeer::set_steam_channel_base);
+	ClassDB::bind_method(D_METHOD("get_steam_channel_base"), &SteamMultiplayerPeer::get_steam_channel_base);
+	ClassDB::bind_method(D_METHOD("get_peer_steam_id", "peer_id"), &SteamMultiplayerPeer::get_peer_steam_id);
+	ClassDB::bind_method(D_METHOD("use_loopback_backend", "network", "steam_id"), &SteamMultiplayerPeer::use_loopback_backend);
+	ClassDB::bind_method(D_METHOD("use_steamworks_backend"), &SteamMultiplayerPeer::use_steamworks_backend);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "steam_channel_base"), "set_steam_channel_base", "get_steam_channel_base");
+}
+
+SteamMultiplayerPeer::SteamMultiplayerPeer() {
+	backend = SteamworksBackend::get_singleton();
+	SteamworksBackend::get_singleton()->add_sink(this);
+}
+
+SteamMultiplayerPeer::~SteamMultiplayerPeer() {
+	SteamworksBackend::get_singleton()->remove_sink(this);
+	// No signals, their handlers would see a half destroyed peer.
+	close_connection(false);
+	detach_loopback_backend();
+}
+
+// Internal
+int32_t SteamMultiplayerPeer::peer_id_for(uint64_t steam_id) {
+	CSteamID converted_steam_id = (uint64)steam_id;
+	return (int32_t)(converted_steam_id.GetAccountID() & 0x7FFFFFFF);
+}
+
+void SteamMultiplayerPeer::add_peer(int32_t peer_id, uint64_t steam_id) {
+	Peer &peer = peers[peer_id];
+	peer.steam_id = steam_id;
+	peer.send_sequence.assign(channel_count, 0);
+	peer.receive_sequence.assign(channel_count, 0);
+	steam_to_peer[steam_id] = peer_id;
+}
+
+void SteamMultiplayerPeer::remove_peer(int32_t peer_id) {
+	std::unordered_map<int32_t, Peer>::iterator it = peers.find(peer_id);
+	if (it == peers.end()) {
+		return;
+	}
+	steam_to_peer.erase(it->second.steam_id);
+	peers.erase(it);
+}
+
+bool SteamMultiplayerPeer::send_control(uint64_t steam_id, ControlMessage message) {
+	uint8_t data = (uint8_t)message;
+	return backend->send_p2p_packet(steam_id, &data, 1, k_EP2PSendReliable, steam_channel_base);
+}
+
+void SteamMultiplayerPeer::handle_control(uint64_t steam_id, const uint8_t *data, uint32_t size) {
+	if (size < 1) {
+		return;
+	}
+	std::unordered_map<uint64_t, int32_t>::iterator known = steam_to_peer.find(steam_id);
+	switch ((ControlMessage)data[0]) {
+		case CONTROL_CONNECT: {
+			if (!server) {
+				return;
+			}
+			if (known != steam_to_peer.end()) {
+				// A retry that crossed our accept, or the accept was lost.
+				send_control(steam_id, CONTROL_ACCEPT);
+				return;
+			}
+			int32_t peer_id = peer_id_for(steam_id);
+			if (refuse_connections || (int)peers.size() >= max_clients || peer_id <= 1 || peers.count(peer_id)) {
+				send_control(steam_id, CONTROL_DISCONNECT);
+				return;
+			}
+			add_peer(peer_id, steam_id);
+			send_control(steam_id, CONTROL_ACCEPT);
+			emit_signal("peer_connected", peer_id);
+		} break;
+		case CONTROL_ACCEPT: {
+			if (server || steam_id != host_steam_id || connection_status != CONNECTION_CONNECTING) {
+				return;
+			}
+			add_peer(1, steam_id);
+			connection_status = CONNECTION_CONNECTED;
+			emit_signal("peer_connected", 1);
+		} break;
+		case CONTROL_DISCONNECT: {
+			if (!server && steam_id == host_steam_id) {
+				_close();
+				return;
+			}
+			if (known == steam_to_peer.end()) {
+				return;
+			}
+			int32_t peer_id = known->second;
+			remove_peer(peer_id);
+			backend->close_p2p_session(steam_id);
+			emit_signal("peer_disconnected", peer_id);
+		} break;
+	}
+}
+
+void SteamMultiplayerPeer::receive_control() {
+	uint8_t data[16];
+	uint32_t packet_size = 0;
+	while (backend->is_p2p_packet_available(&packet_size, steam_channel_base)) {
+		uint64_t steam_id = 0;
+		uint32_t bytesRead = 0;
+		if (!backend->read_p2p_packet(data, sizeof(data), &bytesRead, &steam_id, steam_channel_base)) {
+			return;
+		}
+		handle_control(steam_id, data, MIN(bytesRead, (uint32_t)sizeof(data)));
+		if (connection_status == CONNECTION_DISCONNECTED) {
+			return;
+		}
+	}
+}
+
+void SteamMultiplayerPeer::receive_channel(int channel) {
+	int steam_channel = steam_channel_base + 1 + channel;
+	uint32_t packet_size = 0;
+	while (backend->is_p2p_packet_available(&packet_size, steam_channel)) {
+		int handle = receive_pool.acquire();
+		if (handle < 0) {
+			// Pool exhausted until the multiplayer API drains, keep the rest queued in Steam.
+			return;
+		}
+		uint64_t steam_id = 0;
+		uint32_t bytesRead = 0;
+		uint8_t *data = receive_pool.reserve(handle, packet_size);
+		if (!backend->read_p2p_packet(data, packet_size, &bytesRead, &steam_id, steam_channel)) {
+			receive_pool.release(handle);
+			return;
+		}
+		std::unordered_map<uint64_t, int32_t>::iterator known = steam_to_peer.find(steam_id);
+		if (known == steam_to_peer.end() || bytesRead < STEAM_PEER_HEADER_SIZE || data[0] > TRANSFER_MODE_RELIABLE) {
+			receive_pool.release(handle);
+			continue;
+		}
+		Packet packet;
+		packet.handle = handle;
+		packet.peer_id = known->second;
+		packet.channel = channel;
+		packet.mode = (TransferMode)data[0];
+		packet.offset = STEAM_PEER_HEADER_SIZE;
+		if (packet.mode == TRANSFER_MODE_UNRELIABLE_ORDERED) {
+			if (bytesRead < STEAM_PEER_ORDERED_HEADER_SIZE) {
+				receive_pool.release(handle);
+				continue;
+			}
+			// Steam has no unreliable ordered mode, drop anything older than what we already delivered.
+			uint16_t sequence = (uint16_t)(data[1] | (data[2] << 8));
+			uint16_t &last = peers[packet.peer_id].receive_sequence[channel];
+			if ((int16_t)(sequence - last) <= 0) {
+				receive_pool.release(handle);
+				continue;
+			}
+			last = sequence;
+			packet.offset = STEAM_PEER_ORDERED_HEADER_SIZE;
+		}
+		receive_pool.get(handle).size = bytesRead;
+		incoming.push_back(packet);
+	}
+}
+
+Error SteamMultiplayerPeer::send_to(Peer &peer, const uint8_t *buffer, int32_t size) {
+	uint32_t header_size = STEAM_PEER_HEADER_SIZE;
+	EP2PSend send_type = k_EP2PSendReliable;
+	send_buffer.resize(size + STEAM_PEER_ORDERED_HEADER_SIZE);
+	send_buffer[0] = (uint8_t)transfer_mode;
+	if (transfer_mode == TRANSFER_MODE_UNRELIABLE_ORDERED) {
+		uint16_t sequence = ++peer.send_sequence[transfer_channel];
+		send_buffer[1] = sequence & 0xFF;
+		send_buffer[2] = sequence >> 8;
+		header_size = STEAM_PEER_ORDERED_HEADER_SIZE;
+	}
+	if (transfer_mode != TRANSFER_MODE_RELIABLE) {
+		send_type = k_EP2PSendUnreliable;
+	}
+	memcpy(send_buffer.data() + header_size, buffer, size);
+	bool sent = backend->send_p2p_packet(peer.steam_id, send_buffer.data(), size + header_size, send_type, steam_channel_base + 1 + transfer_channel);
+	return sent ? OK : ERR_CONNECTION_ERROR;
+}
+
+void SteamMultiplayerPeer::release_current_packet() {
+	if (current_packet >= 0) {
+		receive_pool.release(current_packet);
+		current_packet = -1;
+	}
+}
+
+// Setup
+Error SteamMultiplayerPeer::create_server(int p_max_clients, int p_channel_count) {
+	ERR_FAIL_COND_V_MSG(connection_status != CONNECTION_DISCONNECTED, ERR_ALREADY_IN_USE, "The multiplayer instance is already active.");
+	ERR_FAIL_COND_V(p_channel_count <= 0, ERR_INVALID_PARAMETER);
+	uint64_t steam_id = backend->get_steam_id();
+	if (steam_id == 0) {
+		return ERR_UNAVAILABLE;
+	}
+	server = true;
+	unique_id = 1;
+	max_clients = p_max_clients;
+	channel_count = p_channel_count;
+	host_steam_id = steam_id;
+	receive_pool.configure(256, STEAM_P2P_UNRELIABLE_MAX_SIZE);
+	connection_status = CONNECTION_CONNECTED;
+	return OK;
+}
+
+Error SteamMultiplayerPeer::create_client(uint64_t p_host_steam_id, int p_channel_count) {
+	ERR_FAIL_COND_V_MSG(connection_status != CONNECTION_DISCONNECTED, ERR_ALREADY_IN_USE, "The multiplayer instance is already active.");
+	ERR_FAIL_COND_V(p_channel_count <= 0, ERR_INVALID_PARAMETER);
+	uint64_t steam_id = backend->get_steam_id();
+	if (steam_id == 0) {
+		return ERR_UNAVAILABLE;
+	}
+	server = false;
+	unique_id = peer_id_for(steam_id);
+	channel_count = p_channel_count;
+	host_steam_id = p_host_steam_id;
+	receive_pool.configure(256, STEAM_P2P_UNRELIABLE_MAX_SIZE);
+	if (!send_control(host_steam_id, CONTROL_CONNECT)) {
+		receive_pool.clear();
+		return ERR_CANT_CONNECT;
+	}
+	connect_start_usec = get_ticks_usec();
+	connect_sent_usec = connect_start_usec;
+	connection_status = CONNECTION_CONNECTING;
+	return OK;
+}
+
+void SteamMultiplayerPeer::set_steam_channel_base(int channel) {
+	ERR_FAIL_COND_MSG(connection_status != CONNECTION_DISCONNECTED, "The Steam channel base can't be changed while active.");
+	steam_channel_base = channel;
+}
+
+int SteamMultiplayerPeer::get_steam_channel_base() const {
+	return steam_channel_base;
+}
+
+uint64_t SteamMultiplayerPeer::get_peer_steam_id(int32_t peer_id) const {
+	std::unordered_map<int32_t, Peer>::const_iterator it = peers.find(peer_id);
+	return it == peers.end() ? 0 : it->second.steam_id;
+}
+
+// Runs this peer as `steam_id` on a SteamLoopbackNetwork instead of Steam.
+// Loopback callbacks are pumped from poll().
+bool SteamMultiplayerPeer::use_loopback_backend(const Ref<SteamLoopbackNetwork> &network, uint64_t steam_id) {
+	ERR_FAIL_COND_V_MSG(network.is_null(), false, "A SteamLoopbackNetwork is required.");
+	ERR_FAIL_COND_V_MSG(connection_status != CONNECTION_DISCONNECTED, false, "The backend can't be changed while active.");
+	detach_loopback_backend();
+	loopback_network = network;
+	loopback_endpoint = network->get_endpoint(steam_id);
+	loopback_endpoint->add_sink(this);
+	backend = loopback_endpoint;
+	return true;
+}
+
+void SteamMultiplayerPeer::use_steamworks_backend() {
+	ERR_FAIL_COND_MSG(connection_status != CONNECTION_DISCONNECTED, "The backend can't be changed while active.");
+	detach_loopback_backend();
+}
+
+void SteamMultiplayerPeer::detach_loopback_backend() {
+	if (loopback_endpoint) {
+		loopback_endpoint->remove_sink(this);
+		loopback_endpoint = nullptr;
+	}
+	loopback_network.unref();
+	backend = SteamworksBackend::get_singleton();
+}
+
+void SteamMultiplayerPeer::dispatch_callback(int callback, void *data) {
+	switch (callback) {
+		case P2PSessionRequest_t::k_iCallback:
+			p2p_session_request((P2PSessionRequest_t *)data);
+			break;
+		case P2PSessionConnectFail_t::k_iCallback:
+			p2p_session_connect_fail((P2PSessionConnectFail_t *)data);
+			break;
+		default:
+			break;
+	}
+}
+
+// MultiplayerPeerExtension
+Error SteamMultiplayerPeer::_get_packet(const uint8_t **r_buffer, int32_t *r_buffer_size) {
+	// The previous buffer only has to stay valid until the next call.
+	release_current_packet();
+	ERR_FAIL_COND_V(incoming.empty(), ERR_UNAVAILABLE);
+	Packet packet = incoming.front();
+	incoming.pop_front();
+	current_packet = packet.handle;
+	const SteamPacketPool::Slot &slot = receive_pool.get(packet.handle);
+	*r_buffer = slot.data.ptr() + packet.offset;
+	*r_buffer_size = slot.size - packet.offset;
+	return OK;
+}
+
+Error SteamMultiplayerPeer::_put_packet(const uint8_t *p_buffer, int32_t p_buffer_size) {
+	ERR_FAIL_COND_V(connection_status != CONNECTION_CONNECTED, ERR_UNCONFIGURED);
+	ERR_FAIL_COND_V(transfer_channel < 0 || transfer_channel >= channel_count, ERR_INVALID_PARAMETER);
+	ERR_FAIL_COND_V(p_buffer_size > _get_max_packet_size(), ERR_OUT_OF_MEMORY);
+	if (target_peer > 0) {
+		std::unordered_map<int32_t, Peer>::iterator it = peers.find(target_peer);
+		ERR_FAIL_COND_V_MSG(it == peers.end(), ERR_INVALID_PARAMETER, "Invalid target peer.");
+		return send_to(it->second, p_buffer, p_buffer_size);
+	}
+	// Broadcast (0) or everyone but -target_peer.
+	Error error = OK;
+	for (std::unordered_map<int32_t, Peer>::iterator it = peers.begin(); it != peers.end(); ++it) {
+		if (target_peer < 0 && it->first == -target_peer) {
+			continue;
+		}
+		Error peer_error = send_to(it->second, p_buffer, p_buffer_size);
+		if (peer_error != OK) {
+			error = peer_error;
+		}
+	}
+	return error;
+}
+
+int32_t SteamMultiplayerPeer::_get_available_packet_count() const {
+	return (int32_t)incoming.size();
+}
+
+int32_t SteamMultiplayerPeer::_get_max_packet_size() const {
+	if (transfer_mode == TRANSFER_MODE_RELIABLE) {
+		return STEAM_P2P_RELIABLE_MAX_SIZE - STEAM_PEER_HEADER_SIZE;
+	}
+	return STEAM_P2P_UNRELIABLE_MAX_SIZE - STEAM_PEER_ORDERED_HEADER_SIZE;
+}
+
+int32_t SteamMultiplayerPeer::_get_packet_channel() const {
+	ERR_FAIL_COND_V(incoming.empty(), 0);
+	return incoming.front().channel;
+}
+
+MultiplayerPeer::TransferMode SteamMultiplayerPeer::_get_packet_mode() const {
+	ERR_FAIL_COND_V(incoming.empty(), TRANSFER_MODE_RELIABLE);
+	return incoming.front().mode;
+}
+
+void SteamMultiplayerPeer::_set_transfer_channel(int32_t p_channel) {
+	transfer_channel = p_channel;
+}
+
+int32_t SteamMultiplayerPeer::_get_transfer_channel() const {
+	return transfer_channel;
+}
+
+void SteamMultiplayerPeer::_set_transfer_mode(TransferMode p_mode) {
+	transfer_mode = p_mode;
+}
+
+MultiplayerPeer::TransferMode SteamMultiplayerPeer::_get_transfer_mode() const {
+	return transfer_mode;
+}
+
+void SteamMultiplayerPeer::_set_target_peer(int32_t p_peer) {
+	target_peer = p_peer;
+}
+
+int32_t SteamMultiplayerPeer::_get_packet_peer() const {
+	ERR_FAIL_COND_V(incoming.empty(), 0);
+	return incoming.front().peer_id;
+}
+
+bool SteamMultiplayerPeer::_is_server() const {
+	return server;
+}
+
+void SteamMultiplayerPeer::_poll() {
+	if (connection_status == CONNECTION_DISCONNECTED) {
+		return;
+	}
+	if (loopback_endpoint) {
+		// Steam's own callbacks are run by the game, loopback ones are ours to pump.
+		loopback_endpoint->run_callbacks();
+		if (connection_status == CONNECTION_DISCONNECTED) {
+			return;
+		}
+	}
+	receive_control();
+	if (connection_status == CONNECTION_DISCONNECTED) {
+		return;
+	}
+	if (connection_status == CONNECTION_CONNECTING) {
+		uint64_t now = get_ticks_usec();
+		if (now - connect_start_usec > STEAM_PEER_CONNECT_TIMEOUT_USEC) {
+			// MultiplayerAPI reports the drop from CONNECTING as connection_failed.
+			close_connection(true);
+			return;
+		}
+		if (now - connect_sent_usec >= STEAM_PEER_CONNECT_RETRY_USEC) {
+			send_control(host_steam_id, CONTROL_CONNECT);
+			connect_sent_usec = now;
+		}
+	}
+	for (int channel = 0; channel < channel_count; channel++) {
+		receive_channel(channel);
+	}
+}
+
+void SteamMultiplayerPeer::_close() {
+	close_connection(true);
+}
+
+void SteamMultiplayerPeer::close_connection(bool emit_signals) {
+	if (connection_status == CONNECTION_DISCONNECTED) {
+		return;
+	}
+	for (std::unordered_map<int32_t, Peer>::iterator it = peers.begin(); it != peers.end(); ++it) {
+		send_control(it->second.steam_id, CONTROL_DISCONNECT);
+		backend->close_p2p_session(it->second.steam_id);
+	}
+	if (!server && peers.empty()) {
+		// Still connecting, let the host drop its half of the session too.
+		send_control(host_steam_id, CONTROL_DISCONNECT);
+	}
+	std::vector<int32_t> peer_ids;
+	for (std::unordered_map<int32_t, Peer>::iterator it = peers.begin(); it != peers.end(); ++it) {
+		peer_ids.push_back(it->first);
+	}
+	peers.clear();
+	steam_to_peer.clear();
+	incoming.clear();
+	current_packet = -1;
+	receive_pool.clear();
+	connection_status = CONNECTION_DISCONNECTED;
+	server = false;
+	unique_id = 0;
+	host_steam_id = 0;
+	for (size_t i = 0; emit_signals && i < peer_ids.size(); i++) {
+		emit_signal("peer_disconnected", peer_ids[i]);
+	}
+}
+
+void SteamMultiplayerPeer::_disconnect_peer(int32_t p_peer, bool p_force) {
+	std::unordered_map<int32_t, Peer>::iterator it = peers.find(p_peer);
+	ERR_FAIL_COND(it == peers.end());
+	uint64_t steam_id = it->second.steam_id;
+	if (!server) {
+		// Clients only know the host, dropping it ends the session.
+		_close();
+		return;
+	}
+	if (!p_force) {
+		send_control(steam_id, CONTROL_DISCONNECT);
+	}
+	backend->close_p2p_session(steam_id);
+	remove_peer(p_peer);
+	emit_signal("peer_disconnected", p_peer);
+}
+
+int32_t SteamMultiplayerPeer::_get_unique_id() const {
+	return unique_id;
+}
+
+void SteamMultiplayerPeer::_set_refuse_new_connections(bool p_enable) {
+	refuse_connections = p_enable;
+}
+
+bool SteamMultiplayerPeer::_is_refusing_new_connections() const {
+	return refuse_connections;
+}
+
+bool SteamMultiplayerPeer::_is_server_relay_supported() const {
+	return true;
+}
+
+MultiplayerPeer::ConnectionStatus SteamMultiplayerPeer::_get_connection_status() const {
+	return connection_status;
+}
+
+// Callbacks
+void SteamMultiplayerPeer::p2p_session_request(P2PSessionRequest_t* call_data){
+	if (connection_status == CONNECTION_DISCONNECTED) {
+		return;
+	}
+	uint64_t steam_id_remote = call_data->m_steamIDRemote.ConvertToUint64();
+	// Clients only talk to the host, the host takes anyone while accepting connections.
+	if ((server && !refuse_connections) || steam_id_remote == host_steam_id) {
+		backend->accept_p2p_session(steam_id_remote);
+	}
+}
+
+void SteamMultiplayerPeer::p2p_session_connect_fail(P2PSessionConnectFail_t* call_data){
+	if (connection_status == CONNECTION_DISCONNECTED) {
+		return;
+	}
+	uint64_t steam_id_remote = call_data->m_steamIDRemote.ConvertToUint64();
+	if (!server && steam_id_remote == host_steam_id) {
+		_close();
+		return;
+	}
+	std::unordered_map<uint64_t, int32_t>::iterator known = steam_to_peer.find(steam_id_remote);
+	if (known == steam_to_peer.end()) {
+		return;
+	}
+	int32_t peer_id = known->second;
+	remove_peer(peer_id);
+	emit_signal("peer_disconnected", peer_id);
+}
@@ -0,0 +1,162 @@
+/*************************************************************************/
+/*  steam_multiplayer_peer.h                                             */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_MULTIPLAYER_PEER_H
+#define STEAM_MULTIPLAYER_PEER_H
+
+#include <godot_cpp/classes/multiplayer_peer.hpp>
+#include <godot_cpp/classes/multiplayer_peer_extension.hpp>
+
+#include <steam/steam_api.h>
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "steam_backend.h"
+#include "steam_loopback_network.h"
+#include "steam_packet_pool.h"
+
+using namespace godot;
+
+// MultiplayerPeer running on top of ISteamNetworking P2P sessions.
+// The lobby host is peer 1, every other peer is identified by its Steam
+// account ID. Control messages travel on `steam_channel_base`, Godot channel
+// N is carried on Steam channel `steam_channel_base + 1 + N`.
+class SteamMultiplayerPeer : public MultiplayerPeerExtension, public SteamCallbackSink {
+	GDCLASS(SteamMultiplayerPeer, MultiplayerPeerExtension);
+
+	enum ControlMessage {
+		CONTROL_CONNECT,
+		CONTROL_ACCEPT,
+		CONTROL_DISCONNECT,
+	};
+
+	struct Peer {
+		uint64_t steam_id = 0;
+		std::vector<uint16_t> send_sequence;
+		std::vector<uint16_t> receive_sequence;
+	};
+
+	struct Packet {
+		int handle = -1;
+		int32_t peer_id = 0;
+		int32_t channel = 0;
+		TransferMode mode = TRANSFER_MODE_RELIABLE;
+		uint32_t offset = 0;
+	};
+
+private:
+	void p2p_session_request(P2PSessionRequest_t *call_data);
+	void p2p_session_connect_fail(P2PSessionConnectFail_t *call_data);
+
+	SteamBackend *backend = nullptr;
+	Ref<SteamLoopbackNetwork> loopback_network;
+	SteamLoopbackEndpoint *loopback_endpoint = nullptr;
+	void detach_loopback_backend();
+
+	ConnectionStatus connection_status = CONNECTION_DISCONNECTED;
+	bool server = false;
+	bool refuse_connections = false;
+	int32_t unique_id = 0;
+	int max_clients = 0;
+	int channel_count = 0;
+	int steam_channel_base = 0;
+	uint64_t host_steam_id = 0;
+	uint64_t connect_start_usec = 0;
+	uint64_t connect_sent_usec = 0;
+
+	int32_t target_peer = 0;
+	int32_t transfer_channel = 0;
+	TransferMode transfer_mode = TRANSFER_MODE_RELIABLE;
+
+	std::unordered_map<int32_t, Peer> peers;
+	std::unordered_map<uint64_t, int32_t> steam_to_peer;
+
+	SteamPacketPool receive_pool;
+	std::deque<Packet> incoming;
+	int current_packet = -1;
+	std::vector<uint8_t> send_buffer;
+
+	static int32_t peer_id_for(uint64_t steam_id);
+	void add_peer(int32_t peer_id, uint64_t steam_id);
+	void remove_peer(int32_t peer_id);
+	void close_connection(bool emit_signals);
+	bool send_control(uint64_t steam_id, ControlMessage message);
+	void handle_control(uint64_t steam_id, const uint8_t *data, uint32_t size);
+	void receive_control();
+	void receive_channel(int channel);
+	Error send_to(Peer &peer, const uint8_t *buffer, int32_t size);
+	void release_current_packet();
+
+protected:
+	static void _bind_methods();
+
+public:
+	Error create_server(int max_clients = 32, int channel_count = 4);
+	Error create_client(uint64_t host_steam_id, int channel_count = 4);
+	void set_steam_channel_base(int channel);
+	int get_steam_channel_base() const;
+	uint64_t get_peer_steam_id(int32_t peer_id) const;
+	bool use_loopback_backend(const Ref<SteamLoopbackNetwork> &network, uint64_t steam_id);
+	void use_steamworks_backend();
+
+	virtual void dispatch_callback(int callback, void *data) override;
+
+	// MultiplayerPeerExtension
+	virtual Error _get_packet(const uint8_t **r_buffer, int32_t *r_buffer_size) override;
+	virtual Error _put_packet(const uint8_t *p_buffer, int32_t p_buffer_size) override;
+	virtual int32_t _get_available_packet_count() const override;
+	virtual int32_t _get_max_packet_size() const override;
+	virtual int32_t _get_packet_channel() const override;
+	virtual TransferMode _get_packet_mode() const override;
+	virtual void _set_transfer_channel(int32_t p_channel) override;
+	virtual int32_t _get_transfer_channel() const override;
+	virtual void _set_transfer_mode(TransferMode p_mode) override;
+	virtual TransferMode _get_transfer_mode() const override;
+	virtual void _set_target_peer(int32_t p_peer) override;
+	virtual int32_t _get_packet_peer() const override;
+	virtual bool _is_server() const override;
+	virtual void _poll() override;
+	virtual void _close() override;
+	virtual void _disconnect_peer(int32_t p_peer, bool p_force) override;
+	virtual int32_t _get_unique_id() const override;
+	virtual void _set_refuse_new_connections(bool p_enable) override;
+	virtual bool _is_refusing_new_connections() const override;
+	virtual bool _is_server_relay_supported() const override;
+	virtual ConnectionStatus _get_connection_status() const override;
+
+	SteamMultiplayerPeer();
+	~SteamMultiplayerPeer();
+};
+
+#endif // ! STEAM_MULTIPLAYER_PEER_H
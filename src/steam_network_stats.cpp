@@ -0,0 +1,189 @@
+/*************************************************************************/
+/*  steam_network_stats.cpp                                              */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_network_stats.h"
+
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <godot_cpp/variant/packed_int64_array.hpp>
+
+#include <thread>
+
+using namespace godot;
+
+const uint32_t SteamNetworkStats::histogram_bounds[STEAM_STATS_HISTOGRAM_BUCKETS - 1] = { 32, 64, 128, 256, 512, 1024, 1200 };
+
+static const char *counter_names[SteamNetworkStats::COUNTER_MAX] = {
+	"packets_sent",
+	"bytes_sent",
+	"packets_received",
+	"bytes_received",
+	"send_failures",
+};
+
+SteamNetworkStats::Counters::Counters() {
+	reset();
+}
+
+void SteamNetworkStats::Counters::reset() {
+	for (int i = 0; i < COUNTER_MAX; i++) {
+		values[i].store(0, std::memory_order_relaxed);
+	}
+	for (int i = 0; i < STEAM_STATS_HISTOGRAM_BUCKETS; i++) {
+		sent_sizes[i].store(0, std::memory_order_relaxed);
+		received_sizes[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+Dictionary SteamNetworkStats::Counters::to_dictionary() const {
+	Dictionary result;
+	for (int i = 0; i < COUNTER_MAX; i++) {
+		result[counter_names[i]] = (int64_t)values[i].load(std::memory_order_relaxed);
+	}
+	PackedInt64Array sent;
+	PackedInt64Array received;
+	sent.resize(STEAM_STATS_HISTOGRAM_BUCKETS);
+	received.resize(STEAM_STATS_HISTOGRAM_BUCKETS);
+	for (int i = 0; i < STEAM_STATS_HISTOGRAM_BUCKETS; i++) {
+		sent.set(i, sent_sizes[i].load(std::memory_order_relaxed));
+		received.set(i, received_sizes[i].load(std::memory_order_relaxed));
+	}
+	result["sent_sizes"] = sent;
+	result["received_sizes"] = received;
+	return result;
+}
+
+SteamNetworkStats::SteamNetworkStats() :
+	entries(new Entry[STEAM_STATS_MAX_ENTRIES]) {
+}
+
+int SteamNetworkStats::bucket_for(uint32_t p_size) {
+	int bucket = 0;
+	while (bucket < STEAM_STATS_HISTOGRAM_BUCKETS - 1 && p_size > histogram_bounds[bucket]) {
+		bucket++;
+	}
+	return bucket;
+}
+
+SteamNetworkStats::Counters &SteamNetworkStats::find(uint64_t p_steam_id, int p_channel) {
+	uint64_t hash = (p_steam_id ^ ((uint64_t)p_channel << 32)) * 0x9E3779B97F4A7C15ULL;
+	uint32_t index = (uint32_t)(hash >> 32) & (STEAM_STATS_MAX_ENTRIES - 1);
+	for (int probe = 0; probe < STEAM_STATS_MAX_ENTRIES; probe++) {
+		Entry &entry = entries[index];
+		int state = entry.state.load(std::memory_order_acquire);
+		if (state == ENTRY_EMPTY) {
+			if (entry.state.compare_exchange_strong(state, ENTRY_CLAIMED, std::memory_order_acq_rel)) {
+				entry.steam_id = p_steam_id;
+				entry.channel = p_channel;
+				entry.state.store(ENTRY_READY, std::memory_order_release);
+				return entry.counters;
+			}
+		}
+		// Only two stores away from ready, and only on the first packet of a peer.
+		while (state == ENTRY_CLAIMED) {
+			std::this_thread::yield();
+			state = entry.state.load(std::memory_order_acquire);
+		}
+		if (entry.steam_id == p_steam_id && entry.channel == p_channel) {
+			return entry.counters;
+		}
+		index = (index + 1) & (STEAM_STATS_MAX_ENTRIES - 1);
+	}
+	return overflow;
+}
+
+void SteamNetworkStats::record_send(uint64_t p_steam_id, int p_channel, uint32_t p_size, bool p_sent) {
+	if (!enabled.load(std::memory_order_relaxed)) {
+		return;
+	}
+	Counters &counters = find(p_steam_id, p_channel);
+	if (!p_sent) {
+		counters.values[SEND_FAILURES].fetch_add(1, std::memory_order_relaxed);
+		totals.values[SEND_FAILURES].fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	int bucket = bucket_for(p_size);
+	counters.values[PACKETS_SENT].fetch_add(1, std::memory_order_relaxed);
+	counters.values[BYTES_SENT].fetch_add(p_size, std::memory_order_relaxed);
+	counters.sent_sizes[bucket].fetch_add(1, std::memory_order_relaxed);
+	totals.values[PACKETS_SENT].fetch_add(1, std::memory_order_relaxed);
+	totals.values[BYTES_SENT].fetch_add(p_size, std::memory_order_relaxed);
+	totals.sent_sizes[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void SteamNetworkStats::record_receive(uint64_t p_steam_id, int p_channel, uint32_t p_size) {
+	if (!enabled.load(std::memory_order_relaxed)) {
+		return;
+	}
+	Counters &counters = find(p_steam_id, p_channel);
+	int bucket = bucket_for(p_size);
+	counters.values[PACKETS_RECEIVED].fetch_add(1, std::memory_order_relaxed);
+	counters.values[BYTES_RECEIVED].fetch_add(p_size, std::memory_order_relaxed);
+	counters.received_sizes[bucket].fetch_add(1, std::memory_order_relaxed);
+	totals.values[PACKETS_RECEIVED].fetch_add(1, std::memory_order_relaxed);
+	totals.values[BYTES_RECEIVED].fetch_add(p_size, std::memory_order_relaxed);
+	totals.received_sizes[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void SteamNetworkStats::reset() {
+	for (int i = 0; i < STEAM_STATS_MAX_ENTRIES; i++) {
+		entries[i].counters.reset();
+	}
+	totals.reset();
+	overflow.reset();
+}
+
+// { "total": counters, "overflow": counters, "histogram_bounds": PackedInt32Array,
+//   "peers": { steam_id: { channel: counters } } }
+// where counters holds every Counter by name plus "sent_sizes" and
+// "received_sizes" histograms.
+Dictionary SteamNetworkStats::get_snapshot() const {
+	Dictionary peers;
+	for (int i = 0; i < STEAM_STATS_MAX_ENTRIES; i++) {
+		const Entry &entry = entries[i];
+		if (entry.state.load(std::memory_order_acquire) != ENTRY_READY) {
+			continue;
+		}
+		Dictionary channels = peers.get(entry.steam_id, Dictionary());
+		channels[entry.channel] = entry.counters.to_dictionary();
+		peers[entry.steam_id] = channels;
+	}
+	PackedInt32Array bounds;
+	for (int i = 0; i < STEAM_STATS_HISTOGRAM_BUCKETS - 1; i++) {
+		bounds.append(histogram_bounds[i]);
+	}
+	Dictionary snapshot;
+	snapshot["total"] = totals.to_dictionary();
+	snapshot["overflow"] = overflow.to_dictionary();
+	snapshot["histogram_bounds"] = bounds;
+	snapshot["peers"] = peers;
+	return snapshot;
+}
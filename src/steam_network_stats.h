@@ -0,0 +1,111 @@
+/*************************************************************************/
+/*  steam_network_stats.h                                                */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_NETWORK_STATS_H
+#define STEAM_NETWORK_STATS_H
+
+#include <godot_cpp/variant/dictionary.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+using namespace godot;
+
+#define STEAM_STATS_HISTOGRAM_BUCKETS 8
+// Power of two. Peers/channels past this share one "overflow" entry.
+#define STEAM_STATS_MAX_ENTRIES 1024
+
+// Wire level P2P counters per remote Steam ID and channel. Recording is
+// lock-free (a short open addressing probe plus relaxed atomic adds), so the
+// main thread and the network thread can both record without contention.
+// Entries are never removed, reset() only zeroes them.
+class SteamNetworkStats {
+public:
+	enum Counter {
+		PACKETS_SENT,
+		BYTES_SENT,
+		PACKETS_RECEIVED,
+		BYTES_RECEIVED,
+		SEND_FAILURES,
+		COUNTER_MAX
+	};
+
+	// Upper bounds (inclusive) of the packet size histogram buckets, the last
+	// bucket takes everything bigger.
+	static const uint32_t histogram_bounds[STEAM_STATS_HISTOGRAM_BUCKETS - 1];
+
+private:
+	struct Counters {
+		std::atomic<uint64_t> values[COUNTER_MAX];
+		std::atomic<uint64_t> sent_sizes[STEAM_STATS_HISTOGRAM_BUCKETS];
+		std::atomic<uint64_t> received_sizes[STEAM_STATS_HISTOGRAM_BUCKETS];
+
+		Counters();
+		void reset();
+		Dictionary to_dictionary() const;
+	};
+	enum EntryState {
+		ENTRY_EMPTY,
+		ENTRY_CLAIMED,
+		ENTRY_READY,
+	};
+	struct Entry {
+		std::atomic<int> state{ ENTRY_EMPTY };
+		uint64_t steam_id = 0;
+		int channel = 0;
+		Counters counters;
+	};
+
+	std::unique_ptr<Entry[]> entries;
+	Counters totals;
+	Counters overflow;
+	std::atomic<bool> enabled{ true };
+
+	Counters &find(uint64_t p_steam_id, int p_channel);
+	static int bucket_for(uint32_t p_size);
+
+public:
+	void record_send(uint64_t p_steam_id, int p_channel, uint32_t p_size, bool p_sent);
+	void record_receive(uint64_t p_steam_id, int p_channel, uint32_t p_size);
+	void reset();
+
+	void set_enabled(bool p_enabled) { enabled.store(p_enabled, std::memory_order_relaxed); }
+	bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+	uint64_t get_total(Counter p_counter) const { return totals.values[p_counter].load(std::memory_order_relaxed); }
+
+	Dictionary get_snapshot() const;
+
+	SteamNetworkStats();
+};
+
+#endif // ! STEAM_NETWORK_STATS_H
@@ -0,0 +1,127 @@
+/*************************************************************************/
+/*  steam_packet_pool.cpp                                                */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_packet_pool.h"
+
+void SteamPacketPool::configure(int p_buffer_count, uint32_t p_max_packet_size) {
+	clear();
+	if (p_buffer_count <= 0) {
+		return;
+	}
+	max_packet_size = p_max_packet_size;
+	slots.resize(p_buffer_count);
+	free_slots.reserve(p_buffer_count);
+	// Hand out low indices first so a lightly used pool stays cache friendly.
+	for (int i = p_buffer_count - 1; i >= 0; i--) {
+		slots[i].data.resize(max_packet_size);
+		free_slots.push_back(i);
+	}
+}
+
+void SteamPacketPool::clear() {
+	slots.clear();
+	free_slots.clear();
+	max_packet_size = 0;
+}
+
+int SteamPacketPool::acquire() {
+	if (free_slots.empty()) {
+		return -1;
+	}
+	int handle = free_slots.back();
+	free_slots.pop_back();
+	Slot &slot = slots[handle];
+	slot.in_use = true;
+	slot.size = 0;
+	slot.steam_id_remote = 0;
+	slot.channel = 0;
+	return handle;
+}
+
+void SteamPacketPool::release(int p_handle) {
+	if (!is_valid(p_handle)) {
+		return;
+	}
+	slots[p_handle].in_use = false;
+	free_slots.push_back(p_handle);
+}
+
+int SteamPacketPool::detach() {
+	if (free_slots.empty()) {
+		return -1;
+	}
+	int handle = free_slots.back();
+	free_slots.pop_back();
+	slots[handle].detached = true;
+	return handle;
+}
+
+void SteamPacketPool::attach(int p_handle) {
+	if (p_handle < 0 || p_handle >= (int)slots.size()) {
+		return;
+	}
+	slots[p_handle].in_use = false;
+	slots[p_handle].detached = false;
+	free_slots.push_back(p_handle);
+}
+
+void SteamPacketPool::mark_in_use(int p_handle) {
+	slots[p_handle].in_use = true;
+}
+
+bool SteamPacketPool::is_valid(int p_handle) const {
+	return p_handle >= 0 && p_handle < (int)slots.size() && slots[p_handle].in_use;
+}
+
+SteamPacketPool::Slot &SteamPacketPool::get(int p_handle) {
+	return slots[p_handle];
+}
+
+const SteamPacketPool::Slot &SteamPacketPool::get(int p_handle) const {
+	return slots[p_handle];
+}
+
+uint8_t *SteamPacketPool::reserve(int p_handle, uint32_t p_size) {
+	Slot &slot = slots[p_handle];
+	if (slot.data.size() < p_size) {
+		slot.data.resize(p_size);
+	}
+	// ptrw() only copies if a script still holds on to the previous contents.
+	return slot.data.ptrw();
+}
+
+void SteamPacketPool::shrink(int p_handle) {
+	Slot &slot = slots[p_handle];
+	if (slot.data.size() > max_packet_size) {
+		slot.data.resize(max_packet_size);
+	}
+}
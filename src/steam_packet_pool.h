@@ -0,0 +1,89 @@
+/*************************************************************************/
+/*  steam_packet_pool.h                                                  */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_PACKET_POOL_H
+#define STEAM_PACKET_POOL_H
+
+#include <godot_cpp/variant/packed_byte_array.hpp>
+
+#include <vector>
+
+using namespace godot;
+
+// Fixed set of preallocated receive buffers. Packets are read straight into a
+// slot and handed out by index, so steady-state receiving never allocates.
+// Slot buffers keep their full capacity, only the first `size` bytes are valid.
+class SteamPacketPool {
+public:
+	struct Slot {
+		PackedByteArray data;
+		uint32_t size = 0;
+		uint64_t steam_id_remote = 0;
+		int channel = 0;
+		bool in_use = false;
+		bool detached = false;
+	};
+
+private:
+	std::vector<Slot> slots;
+	std::vector<int> free_slots;
+	uint32_t max_packet_size = 0;
+
+public:
+	void configure(int p_buffer_count, uint32_t p_max_packet_size);
+	void clear();
+
+	int acquire();
+	void release(int p_handle);
+
+	// Hand slots over to an external owner (the network thread) and back.
+	// Detached slots are neither free nor in use from the pool's point of view.
+	int detach();
+	void attach(int p_handle);
+	void mark_in_use(int p_handle);
+
+	bool is_valid(int p_handle) const;
+	Slot &get(int p_handle);
+	const Slot &get(int p_handle) const;
+
+	// Grows a single slot when a packet does not fit, instead of dropping it.
+	uint8_t *reserve(int p_handle, uint32_t p_size);
+	// Gives back what reserve() grew a slot beyond the configured packet size.
+	void shrink(int p_handle);
+
+	bool is_configured() const { return !slots.empty(); }
+	int get_buffer_count() const { return (int)slots.size(); }
+	int get_free_count() const { return (int)free_slots.size(); }
+	uint32_t get_max_packet_size() const { return max_packet_size; }
+};
+
+#endif // ! STEAM_PACKET_POOL_H
@@ -0,0 +1,197 @@
+/*************************************************************************/
+/*  steam_packet_reader.cpp                                              */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_packet_reader.h"
+
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+
+#include <cstring>
+
+void SteamPacketReader::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_data", "data"), &SteamPacketReader::set_data);
+	ClassDB::bind_method(D_METHOD("get_sender"), &SteamPacketReader::get_sender);
+	ClassDB::bind_method(D_METHOD("has_error"), &SteamPacketReader::has_error);
+	ClassDB::bind_method(D_METHOD("get_remaining_bits"), &SteamPacketReader::get_remaining_bits);
+	ClassDB::bind_method(D_METHOD("align"), &SteamPacketReader::align);
+	ClassDB::bind_method(D_METHOD("read_bool"), &SteamPacketReader::read_bool);
+	ClassDB::bind_method(D_METHOD("read_bits", "bits"), &SteamPacketReader::read_bits);
+	ClassDB::bind_method(D_METHOD("read_u8"), &SteamPacketReader::read_u8);
+	ClassDB::bind_method(D_METHOD("read_u16"), &SteamPacketReader::read_u16);
+	ClassDB::bind_method(D_METHOD("read_u32"), &SteamPacketReader::read_u32);
+	ClassDB::bind_method(D_METHOD("read_u64"), &SteamPacketReader::read_u64);
+	ClassDB::bind_method(D_METHOD("read_varint"), &SteamPacketReader::read_varint);
+	ClassDB::bind_method(D_METHOD("read_signed_varint"), &SteamPacketReader::read_signed_varint);
+	ClassDB::bind_method(D_METHOD("read_delta", "baseline"), &SteamPacketReader::read_delta);
+	ClassDB::bind_method(D_METHOD("read_float"), &SteamPacketReader::read_float);
+	ClassDB::bind_method(D_METHOD("read_double"), &SteamPacketReader::read_double);
+	ClassDB::bind_method(D_METHOD("read_quantized_float", "min", "max", "bits"), &SteamPacketReader::read_quantized_float);
+	ClassDB::bind_method(D_METHOD("read_quantized_vector2", "min", "max", "bits"), &SteamPacketReader::read_quantized_vector2);
+	ClassDB::bind_method(D_METHOD("read_quantized_vector3", "min", "max", "bits"), &SteamPacketReader::read_quantized_vector3);
+	ClassDB::bind_method(D_METHOD("read_bytes"), &SteamPacketReader::read_bytes);
+	ClassDB::bind_method(D_METHOD("read_string"), &SteamPacketReader::read_string);
+}
+
+uint8_t *SteamPacketReader::reserve(uint32_t size) {
+	source = PackedByteArray();
+	if (storage.size() < size) {
+		storage.resize(size);
+	}
+	return storage.data();
+}
+
+void SteamPacketReader::set_received(uint32_t size, uint64_t steam_id_remote) {
+	stream.set_data(storage.data(), size);
+	sender = steam_id_remote;
+}
+
+// Keeps a reference to `data` instead of copying it.
+void SteamPacketReader::set_data(const PackedByteArray &data) {
+	source = data;
+	stream.set_data(source.ptr(), source.size());
+	sender = 0;
+}
+
+uint64_t SteamPacketReader::get_sender() {
+	return sender;
+}
+
+bool SteamPacketReader::has_error() {
+	return stream.has_error();
+}
+
+int SteamPacketReader::get_remaining_bits() {
+	return stream.get_remaining_bits();
+}
+
+void SteamPacketReader::align() {
+	stream.align();
+}
+
+bool SteamPacketReader::read_bool() {
+	return stream.read_bits(1) != 0;
+}
+
+int64_t SteamPacketReader::read_bits(int bits) {
+	ERR_FAIL_COND_V_MSG(bits < 1 || bits > 64, 0, "Bit count must be between 1 and 64.");
+	return (int64_t)stream.read_bits(bits);
+}
+
+int SteamPacketReader::read_u8() {
+	return (int)stream.read_bits(8);
+}
+
+int SteamPacketReader::read_u16() {
+	return (int)stream.read_bits(16);
+}
+
+int64_t SteamPacketReader::read_u32() {
+	return (int64_t)stream.read_bits(32);
+}
+
+int64_t SteamPacketReader::read_u64() {
+	return (int64_t)stream.read_bits(64);
+}
+
+int64_t SteamPacketReader::read_varint() {
+	return (int64_t)stream.read_varint();
+}
+
+int64_t SteamPacketReader::read_signed_varint() {
+	return SteamBitWriter::zigzag_decode(stream.read_varint());
+}
+
+int64_t SteamPacketReader::read_delta(int64_t baseline) {
+	return (int64_t)((uint64_t)baseline + (uint64_t)SteamBitWriter::zigzag_decode(stream.read_varint()));
+}
+
+double SteamPacketReader::read_float() {
+	uint32_t bits = (uint32_t)stream.read_bits(32);
+	float single;
+	memcpy(&single, &bits, sizeof(single));
+	return single;
+}
+
+double SteamPacketReader::read_double() {
+	uint64_t bits = stream.read_bits(64);
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+double SteamPacketReader::read_quantized_float(double min, double max, int bits) {
+	ERR_FAIL_COND_V_MSG(bits < 1 || bits > 32, 0.0, "Bit count must be between 1 and 32.");
+	return SteamBitWriter::dequantize(stream.read_bits(bits), min, max, bits);
+}
+
+Vector2 SteamPacketReader::read_quantized_vector2(double min, double max, int bits) {
+	ERR_FAIL_COND_V_MSG(bits < 1 || bits > 32, Vector2(), "Bit count must be between 1 and 32.");
+	Vector2 value;
+	value.x = SteamBitWriter::dequantize(stream.read_bits(bits), min, max, bits);
+	value.y = SteamBitWriter::dequantize(stream.read_bits(bits), min, max, bits);
+	return value;
+}
+
+Vector3 SteamPacketReader::read_quantized_vector3(double min, double max, int bits) {
+	ERR_FAIL_COND_V_MSG(bits < 1 || bits > 32, Vector3(), "Bit count must be between 1 and 32.");
+	Vector3 value;
+	value.x = SteamBitWriter::dequantize(stream.read_bits(bits), min, max, bits);
+	value.y = SteamBitWriter::dequantize(stream.read_bits(bits), min, max, bits);
+	value.z = SteamBitWriter::dequantize(stream.read_bits(bits), min, max, bits);
+	return value;
+}
+
+PackedByteArray SteamPacketReader::read_bytes() {
+	PackedByteArray data;
+	uint64_t size = stream.read_varint();
+	if (size > stream.get_remaining_bits() / 8) {
+		stream.set_error();
+		return data;
+	}
+	data.resize(size);
+	stream.read_bytes(data.ptrw(), size);
+	return data;
+}
+
+String SteamPacketReader::read_string() {
+	uint64_t size = stream.read_varint();
+	if (size > stream.get_remaining_bits() / 8) {
+		stream.set_error();
+		return String();
+	}
+	if (size == 0) {
+		return String();
+	}
+	std::vector<char> utf8(size);
+	stream.read_bytes((uint8_t *)utf8.data(), size);
+	return String::utf8(utf8.data(), size);
+}
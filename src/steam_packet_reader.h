@@ -0,0 +1,91 @@
+/*************************************************************************/
+/*  steam_packet_reader.h                                                */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_PACKET_READER_H
+#define STEAM_PACKET_READER_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/vector2.hpp>
+#include <godot_cpp/variant/vector3.hpp>
+
+#include <vector>
+
+#include "steam_bit_stream.h"
+
+using namespace godot;
+
+// Reads messages written with SteamPacketWriter, in the same order with the
+// same arguments. Steam.read_p2p_packet_into() fills it straight from the
+// receive path into a buffer it keeps between messages. Reading past the
+// end returns zeros and sets has_error(), check it once per message.
+class SteamPacketReader : public RefCounted {
+	GDCLASS(SteamPacketReader, RefCounted);
+
+	SteamBitReader stream;
+	std::vector<uint8_t> storage;
+	PackedByteArray source;
+	uint64_t sender = 0;
+
+protected:
+	static void _bind_methods();
+
+public:
+	// Used by Steam to read a packet in place, followed by set_received().
+	uint8_t *reserve(uint32_t size);
+	void set_received(uint32_t size, uint64_t steam_id_remote);
+
+	void set_data(const PackedByteArray &data);
+	uint64_t get_sender();
+	bool has_error();
+	int get_remaining_bits();
+	void align();
+
+	bool read_bool();
+	int64_t read_bits(int bits);
+	int read_u8();
+	int read_u16();
+	int64_t read_u32();
+	int64_t read_u64();
+	int64_t read_varint();
+	int64_t read_signed_varint();
+	int64_t read_delta(int64_t baseline);
+	double read_float();
+	double read_double();
+	double read_quantized_float(double min, double max, int bits);
+	Vector2 read_quantized_vector2(double min, double max, int bits);
+	Vector3 read_quantized_vector3(double min, double max, int bits);
+	PackedByteArray read_bytes();
+	String read_string();
+};
+
+#endif // ! STEAM_PACKET_READER_H
@@ -0,0 +1,172 @@
+/*************************************************************************/
+/*  steam_packet_writer.cpp                                              */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_packet_writer.h"
+
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+
+#include <cstring>
+
+void SteamPacketWriter::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("clear"), &SteamPacketWriter::clear);
+	ClassDB::bind_method(D_METHOD("get_size"), &SteamPacketWriter::get_size);
+	ClassDB::bind_method(D_METHOD("get_bit_size"), &SteamPacketWriter::get_bit_size);
+	ClassDB::bind_method(D_METHOD("get_data"), &SteamPacketWriter::get_data);
+	ClassDB::bind_method(D_METHOD("align"), &SteamPacketWriter::align);
+	ClassDB::bind_method(D_METHOD("write_bool", "value"), &SteamPacketWriter::write_bool);
+	ClassDB::bind_method(D_METHOD("write_bits", "value", "bits"), &SteamPacketWriter::write_bits);
+	ClassDB::bind_method(D_METHOD("write_u8", "value"), &SteamPacketWriter::write_u8);
+	ClassDB::bind_method(D_METHOD("write_u16", "value"), &SteamPacketWriter::write_u16);
+	ClassDB::bind_method(D_METHOD("write_u32", "value"), &SteamPacketWriter::write_u32);
+	ClassDB::bind_method(D_METHOD("write_u64", "value"), &SteamPacketWriter::write_u64);
+	ClassDB::bind_method(D_METHOD("write_varint", "value"), &SteamPacketWriter::write_varint);
+	ClassDB::bind_method(D_METHOD("write_signed_varint", "value"), &SteamPacketWriter::write_signed_varint);
+	ClassDB::bind_method(D_METHOD("write_delta", "value", "baseline"), &SteamPacketWriter::write_delta);
+	ClassDB::bind_method(D_METHOD("write_float", "value"), &SteamPacketWriter::write_float);
+	ClassDB::bind_method(D_METHOD("write_double", "value"), &SteamPacketWriter::write_double);
+	ClassDB::bind_method(D_METHOD("write_quantized_float", "value", "min", "max", "bits"), &SteamPacketWriter::write_quantized_float);
+	ClassDB::bind_method(D_METHOD("write_quantized_vector2", "value", "min", "max", "bits"), &SteamPacketWriter::write_quantized_vector2);
+	ClassDB::bind_method(D_METHOD("write_quantized_vector3", "value", "min", "max", "bits"), &SteamPacketWriter::write_quantized_vector3);
+	ClassDB::bind_method(D_METHOD("write_bytes", "data"), &SteamPacketWriter::write_bytes);
+	ClassDB::bind_method(D_METHOD("write_string", "value"), &SteamPacketWriter::write_string);
+}
+
+void SteamPacketWriter::clear() {
+	stream.clear();
+}
+
+int SteamPacketWriter::get_size() {
+	return stream.get_size();
+}
+
+int SteamPacketWriter::get_bit_size() {
+	return stream.get_bit_size();
+}
+
+PackedByteArray SteamPacketWriter::get_data() {
+	PackedByteArray data;
+	data.resize(stream.get_size());
+	if (data.size() > 0) {
+		memcpy(data.ptrw(), stream.get_data(), data.size());
+	}
+	return data;
+}
+
+void SteamPacketWriter::align() {
+	stream.align();
+}
+
+void SteamPacketWriter::write_bool(bool value) {
+	stream.write_bits(value ? 1 : 0, 1);
+}
+
+void SteamPacketWriter::write_bits(int64_t value, int bits) {
+	ERR_FAIL_COND_MSG(bits < 1 || bits > 64, "Bit count must be between 1 and 64.");
+	stream.write_bits((uint64_t)value, bits);
+}
+
+void SteamPacketWriter::write_u8(int value) {
+	stream.write_bits((uint64_t)value, 8);
+}
+
+void SteamPacketWriter::write_u16(int value) {
+	stream.write_bits((uint64_t)value, 16);
+}
+
+void SteamPacketWriter::write_u32(int64_t value) {
+	stream.write_bits((uint64_t)value, 32);
+}
+
+void SteamPacketWriter::write_u64(int64_t value) {
+	stream.write_bits((uint64_t)value, 64);
+}
+
+// Negative values take the full 10 bytes, use write_signed_varint() for those.
+void SteamPacketWriter::write_varint(int64_t value) {
+	stream.write_varint((uint64_t)value);
+}
+
+void SteamPacketWriter::write_signed_varint(int64_t value) {
+	stream.write_varint(SteamBitWriter::zigzag_encode(value));
+}
+
+// Counters and ids that move a little between messages cost a byte or two.
+void SteamPacketWriter::write_delta(int64_t value, int64_t baseline) {
+	stream.write_varint(SteamBitWriter::zigzag_encode((int64_t)((uint64_t)value - (uint64_t)baseline)));
+}
+
+void SteamPacketWriter::write_float(double value) {
+	float single = (float)value;
+	uint32_t bits;
+	memcpy(&bits, &single, sizeof(bits));
+	stream.write_bits(bits, 32);
+}
+
+void SteamPacketWriter::write_double(double value) {
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	stream.write_bits(bits, 64);
+}
+
+// Values are clamped to [min, max], the error is at most half a step,
+// (max - min) / (2^bits - 1) / 2.
+void SteamPacketWriter::write_quantized_float(double value, double min, double max, int bits) {
+	ERR_FAIL_COND_MSG(bits < 1 || bits > 32, "Bit count must be between 1 and 32.");
+	stream.write_bits(SteamBitWriter::quantize(value, min, max, bits), bits);
+}
+
+void SteamPacketWriter::write_quantized_vector2(const Vector2 &value, double min, double max, int bits) {
+	ERR_FAIL_COND_MSG(bits < 1 || bits > 32, "Bit count must be between 1 and 32.");
+	stream.write_bits(SteamBitWriter::quantize(value.x, min, max, bits), bits);
+	stream.write_bits(SteamBitWriter::quantize(value.y, min, max, bits), bits);
+}
+
+void SteamPacketWriter::write_quantized_vector3(const Vector3 &value, double min, double max, int bits) {
+	ERR_FAIL_COND_MSG(bits < 1 || bits > 32, "Bit count must be between 1 and 32.");
+	stream.write_bits(SteamBitWriter::quantize(value.x, min, max, bits), bits);
+	stream.write_bits(SteamBitWriter::quantize(value.y, min, max, bits), bits);
+	stream.write_bits(SteamBitWriter::quantize(value.z, min, max, bits), bits);
+}
+
+// Length prefixed as a varint.
+void SteamPacketWriter::write_bytes(const PackedByteArray &data) {
+	stream.write_varint(data.size());
+	stream.write_bytes(data.ptr(), data.size());
+}
+
+// UTF-8, length prefixed as a varint.
+void SteamPacketWriter::write_string(const String &value) {
+	CharString utf8 = value.utf8();
+	stream.write_varint(utf8.length());
+	stream.write_bytes((const uint8_t *)utf8.get_data(), utf8.length());
+}
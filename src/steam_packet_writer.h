@@ -0,0 +1,84 @@
+/*************************************************************************/
+/*  steam_packet_writer.h                                                */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_PACKET_WRITER_H
+#define STEAM_PACKET_WRITER_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/vector2.hpp>
+#include <godot_cpp/variant/vector3.hpp>
+
+#include "steam_bit_stream.h"
+
+using namespace godot;
+
+// Builds compact gameplay messages in a reusable native buffer: raw bits,
+// varints, zig-zag deltas and quantized floats instead of Variant encoded
+// values. Hand it to Steam.send_p2p_writer() to send it without copying it
+// into a PackedByteArray first, then clear() it for the next message.
+class SteamPacketWriter : public RefCounted {
+	GDCLASS(SteamPacketWriter, RefCounted);
+
+	SteamBitWriter stream;
+
+protected:
+	static void _bind_methods();
+
+public:
+	const SteamBitWriter &get_stream() const { return stream; }
+
+	void clear();
+	int get_size();
+	int get_bit_size();
+	PackedByteArray get_data();
+	void align();
+
+	void write_bool(bool value);
+	void write_bits(int64_t value, int bits);
+	void write_u8(int value);
+	void write_u16(int value);
+	void write_u32(int64_t value);
+	void write_u64(int64_t value);
+	void write_varint(int64_t value);
+	void write_signed_varint(int64_t value);
+	void write_delta(int64_t value, int64_t baseline);
+	void write_float(double value);
+	void write_double(double value);
+	void write_quantized_float(double value, double min, double max, int bits);
+	void write_quantized_vector2(const Vector2 &value, double min, double max, int bits);
+	void write_quantized_vector3(const Vector3 &value, double min, double max, int bits);
+	void write_bytes(const PackedByteArray &data);
+	void write_string(const String &value);
+};
+
+#endif // ! STEAM_PACKET_WRITER_H
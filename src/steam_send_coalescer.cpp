@@ -0,0 +1,138 @@
+/*************************************************************************/
+/*  steam_send_coalescer.cpp                                             */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_send_coalescer.h"
+
+#include <cstring>
+
+size_t SteamSendCoalescer::encode_varint(uint32_t p_value, uint8_t *r_buffer) {
+	size_t size = 0;
+	while (p_value >= 0x80) {
+		r_buffer[size++] = (uint8_t)(p_value | 0x80);
+		p_value >>= 7;
+	}
+	r_buffer[size++] = (uint8_t)p_value;
+	return size;
+}
+
+size_t SteamSendCoalescer::decode_varint(const uint8_t *p_buffer, size_t p_size, uint32_t *r_value) {
+	uint32_t value = 0;
+	for (size_t i = 0; i < p_size && i < 5; i++) {
+		value |= (uint32_t)(p_buffer[i] & 0x7F) << (7 * i);
+		if (!(p_buffer[i] & 0x80)) {
+			*r_value = value;
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+void SteamSendCoalescer::set_send_func(SendFunc p_func, void *p_userdata) {
+	send_func = p_func;
+	send_userdata = p_userdata;
+}
+
+void SteamSendCoalescer::set_prefix(const uint8_t *p_prefix, size_t p_size) {
+	flush();
+	prefix.assign(p_prefix, p_prefix + p_size);
+}
+
+SteamSendCoalescer::Batch &SteamSendCoalescer::get_batch(uint64_t p_steam_id, int p_channel, int p_send_type) {
+	// Few peers and channels are active at once, a linear scan beats hashing here.
+	for (size_t i = 0; i < batches.size(); i++) {
+		Batch &batch = batches[i];
+		if (batch.steam_id == p_steam_id && batch.channel == p_channel && batch.send_type == p_send_type) {
+			return batch;
+		}
+	}
+	batches.emplace_back();
+	Batch &batch = batches.back();
+	batch.steam_id = p_steam_id;
+	batch.channel = p_channel;
+	batch.send_type = p_send_type;
+	batch.data.reserve(max_packet_size);
+	return batch;
+}
+
+bool SteamSendCoalescer::send(Batch &p_batch) {
+	if (p_batch.data.size() <= prefix.size()) {
+		return true;
+	}
+	bool sent = send_func ? send_func(send_userdata, p_batch) : false;
+	p_batch.data.clear();
+	return sent;
+}
+
+bool SteamSendCoalescer::queue(uint64_t p_steam_id, int p_channel, int p_send_type, const uint8_t *p_data, uint32_t p_size) {
+	Batch &batch = get_batch(p_steam_id, p_channel, p_send_type);
+	uint8_t header[5];
+	size_t header_size = encode_varint(p_size, header);
+	if (batch.data.size() > prefix.size() && batch.data.size() + header_size + p_size > max_packet_size && !send(batch)) {
+		send_failed = true;
+	}
+	if (batch.data.empty()) {
+		batch.data.assign(prefix.begin(), prefix.end());
+	}
+	size_t offset = batch.data.size();
+	batch.data.resize(offset + header_size + p_size);
+	memcpy(batch.data.data() + offset, header, header_size);
+	if (p_size > 0) {
+		memcpy(batch.data.data() + offset + header_size, p_data, p_size);
+	}
+	return true;
+}
+
+bool SteamSendCoalescer::flush() {
+	bool sent = !send_failed;
+	send_failed = false;
+	for (size_t i = 0; i < batches.size(); i++) {
+		if (!send(batches[i])) {
+			sent = false;
+		}
+	}
+	return sent;
+}
+
+size_t SteamSendCoalescer::get_pending_bytes() const {
+	size_t pending = 0;
+	for (size_t i = 0; i < batches.size(); i++) {
+		if (batches[i].data.size() > prefix.size()) {
+			pending += batches[i].data.size() - prefix.size();
+		}
+	}
+	return pending;
+}
+
+void SteamSendCoalescer::clear() {
+	batches.clear();
+	send_failed = false;
+}
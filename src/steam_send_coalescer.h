@@ -0,0 +1,88 @@
+/*************************************************************************/
+/*  steam_send_coalescer.h                                               */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_SEND_COALESCER_H
+#define STEAM_SEND_COALESCER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Packs small messages headed for the same peer, channel and send type into
+// one packet. Every message is prefixed with its length as a LEB128 varint,
+// so a packet is simply `[length][payload][length][payload]...`.
+class SteamSendCoalescer {
+public:
+	struct Batch {
+		uint64_t steam_id = 0;
+		int channel = 0;
+		int send_type = 0;
+		std::vector<uint8_t> data;
+	};
+
+	// Called with every finished batch, returns whether Steam accepted it.
+	typedef bool (*SendFunc)(void *p_userdata, const Batch &p_batch);
+
+private:
+	std::vector<Batch> batches;
+	uint32_t max_packet_size = 1200;
+	std::vector<uint8_t> prefix;
+	SendFunc send_func = nullptr;
+	void *send_userdata = nullptr;
+	bool send_failed = false;
+
+	Batch &get_batch(uint64_t p_steam_id, int p_channel, int p_send_type);
+	bool send(Batch &p_batch);
+
+public:
+	static size_t encode_varint(uint32_t p_value, uint8_t *r_buffer);
+	// Returns the number of bytes consumed, 0 if the varint is truncated.
+	static size_t decode_varint(const uint8_t *p_buffer, size_t p_size, uint32_t *r_value);
+
+	void set_send_func(SendFunc p_func, void *p_userdata);
+	void set_max_packet_size(uint32_t p_size) { max_packet_size = p_size; }
+	// Bytes written at the start of every batch, e.g. a packet type tag.
+	void set_prefix(const uint8_t *p_prefix, size_t p_size);
+	uint32_t get_max_packet_size() const { return max_packet_size; }
+	// Bytes queued but not sent yet, prefixes not included.
+	size_t get_pending_bytes() const;
+
+	// Queues a message, sending the pending batch first if it would overflow.
+	// Always succeeds, a rejected early send is reported by the next flush().
+	bool queue(uint64_t p_steam_id, int p_channel, int p_send_type, const uint8_t *p_data, uint32_t p_size);
+	// Sends every non-empty batch. Buffers are kept for reuse. Returns false
+	// if any batch since the last flush was rejected.
+	bool flush();
+	void clear();
+};
+
+#endif // ! STEAM_SEND_COALESCER_H
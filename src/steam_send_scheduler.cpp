@@ -0,0 +1,234 @@
+/*************************************************************************/
+/*  steam_send_scheduler.cpp                                             */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_send_scheduler.h"
+
+#include <algorithm>
+#include <cstring>
+
+void SteamSendScheduler::set_send_func(SendFunc p_func, void *p_userdata) {
+	send_func = p_func;
+	send_userdata = p_userdata;
+}
+
+void SteamSendScheduler::set_default_rate(uint32_t p_bytes_per_second, uint32_t p_burst_bytes) {
+	default_rate = std::max<uint32_t>(p_bytes_per_second, 1);
+	default_burst = std::max<uint32_t>(p_burst_bytes, 1);
+}
+
+void SteamSendScheduler::set_peer_rate(uint64_t p_steam_id, uint32_t p_bytes_per_second, uint32_t p_burst_bytes) {
+	Peer &peer = get_peer(p_steam_id, 0);
+	peer.rate = p_bytes_per_second;
+	peer.burst = p_bytes_per_second > 0 ? std::max<uint32_t>(p_burst_bytes, 1) : 0;
+}
+
+SteamSendScheduler::Peer &SteamSendScheduler::get_peer(uint64_t p_steam_id, uint64_t p_now_usec) {
+	for (size_t i = 0; i < peers.size(); i++) {
+		if (peers[i].steam_id == p_steam_id) {
+			return peers[i];
+		}
+	}
+	peers.emplace_back();
+	Peer &peer = peers.back();
+	peer.steam_id = p_steam_id;
+	peer.tokens = default_burst;
+	peer.refill_usec = p_now_usec;
+	return peer;
+}
+
+void SteamSendScheduler::refill(Peer &p_peer, uint64_t p_now_usec) {
+	uint32_t rate = p_peer.rate > 0 ? p_peer.rate : default_rate;
+	uint32_t burst = p_peer.rate > 0 ? p_peer.burst : default_burst;
+	if (p_now_usec > p_peer.refill_usec) {
+		p_peer.tokens += (p_now_usec - p_peer.refill_usec) * (double)rate / 1000000.0;
+	}
+	p_peer.tokens = std::min(p_peer.tokens, (double)burst);
+	p_peer.refill_usec = p_now_usec;
+}
+
+// Removes a message, keeping its buffer around for the next queue().
+void SteamSendScheduler::release(Peer &p_peer, int p_priority, size_t p_index) {
+	std::deque<Message> &queue = p_peer.queues[p_priority];
+	p_peer.queued_bytes -= queue[p_index].data.size();
+	if (spare_buffers.size() < 256) {
+		queue[p_index].data.clear();
+		spare_buffers.push_back(std::move(queue[p_index].data));
+	}
+	queue.erase(queue.begin() + p_index);
+}
+
+// Drops the oldest unreliable message of the lowest class at or below
+// p_min_priority. Returns false if there was none.
+bool SteamSendScheduler::drop_unreliable(Peer &p_peer, int p_min_priority) {
+	for (int priority = PRIORITY_MAX - 1; priority >= p_min_priority; priority--) {
+		std::deque<Message> &queue = p_peer.queues[priority];
+		for (size_t i = 0; i < queue.size(); i++) {
+			if (!queue[i].reliable) {
+				release(p_peer, priority, i);
+				dropped++;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool SteamSendScheduler::queue(uint64_t p_steam_id, int p_channel, int p_send_type, bool p_reliable, int p_priority, const uint8_t *p_data, uint32_t p_size, uint64_t p_now_usec) {
+	int priority = std::min(std::max(p_priority, (int)PRIORITY_CRITICAL), (int)PRIORITY_MAX - 1);
+	Peer &peer = get_peer(p_steam_id, p_now_usec);
+	while (peer.queued_bytes + p_size > max_queued_bytes) {
+		if (drop_unreliable(peer, priority)) {
+			continue;
+		}
+		if (!p_reliable) {
+			dropped++;
+			return false;
+		}
+		break;
+	}
+	peer.queues[priority].emplace_back();
+	Message &message = peer.queues[priority].back();
+	if (!spare_buffers.empty()) {
+		message.data = std::move(spare_buffers.back());
+		spare_buffers.pop_back();
+	}
+	message.steam_id = p_steam_id;
+	message.channel = p_channel;
+	message.send_type = p_send_type;
+	message.reliable = p_reliable;
+	message.attempts = 0;
+	message.queued_usec = p_now_usec;
+	message.data.assign(p_data, p_data + p_size);
+	peer.queued_bytes += p_size;
+	return true;
+}
+
+int SteamSendScheduler::flush_peer(Peer &p_peer, uint64_t p_now_usec, bool p_unlimited) {
+	refill(p_peer, p_now_usec);
+	// Stale unreliable data is worth nothing, drop it before it uses budget.
+	for (int priority = 0; priority < PRIORITY_MAX && !p_unlimited; priority++) {
+		std::deque<Message> &queue = p_peer.queues[priority];
+		for (size_t i = 0; i < queue.size();) {
+			if (!queue[i].reliable && p_now_usec - queue[i].queued_usec > max_unreliable_age_usec) {
+				release(p_peer, priority, i);
+				dropped++;
+			} else {
+				i++;
+			}
+		}
+	}
+	int sent = 0;
+	// A message larger than the whole burst still goes out once the bucket
+	// is positive, leaving it in debt, so nothing can block a peer forever.
+	while (p_unlimited || p_peer.tokens > 0.0) {
+		int best = -1;
+		int64_t best_class = 0;
+		for (int priority = 0; priority < PRIORITY_MAX; priority++) {
+			if (p_peer.queues[priority].empty()) {
+				continue;
+			}
+			uint64_t age = p_now_usec - p_peer.queues[priority].front().queued_usec;
+			int64_t effective = priority - (int64_t)(age / aging_usec);
+			if (best < 0 || effective < best_class) {
+				best = priority;
+				best_class = effective;
+			}
+		}
+		if (best < 0) {
+			break;
+		}
+		Message &message = p_peer.queues[best].front();
+		if (!send_func || !send_func(send_userdata, message)) {
+			// A rejected reliable message stays in front, later ones on its
+			// channel must not overtake it. Steam is likely out of send
+			// buffer, so the peer waits for the next flush. drain() has no
+			// next flush and gives up right away.
+			if (message.reliable && !p_unlimited && ++message.attempts < STEAM_SCHEDULER_MAX_SEND_ATTEMPTS) {
+				break;
+			}
+			release(p_peer, best, 0);
+			failed++;
+			continue;
+		}
+		p_peer.tokens -= message.data.size();
+		release(p_peer, best, 0);
+		sent++;
+	}
+	return sent;
+}
+
+int SteamSendScheduler::flush(uint64_t p_now_usec) {
+	int sent = 0;
+	for (size_t i = 0; i < peers.size(); i++) {
+		sent += flush_peer(peers[i], p_now_usec, false);
+	}
+	return sent;
+}
+
+int SteamSendScheduler::drain(uint64_t p_now_usec) {
+	int sent = 0;
+	for (size_t i = 0; i < peers.size(); i++) {
+		sent += flush_peer(peers[i], p_now_usec, true);
+	}
+	return sent;
+}
+
+void SteamSendScheduler::remove_peer(uint64_t p_steam_id) {
+	for (size_t i = 0; i < peers.size(); i++) {
+		if (peers[i].steam_id == p_steam_id) {
+			peers.erase(peers.begin() + i);
+			return;
+		}
+	}
+}
+
+void SteamSendScheduler::clear() {
+	peers.clear();
+	spare_buffers.clear();
+}
+
+size_t SteamSendScheduler::get_queued_bytes() const {
+	size_t queued = 0;
+	for (size_t i = 0; i < peers.size(); i++) {
+		queued += peers[i].queued_bytes;
+	}
+	return queued;
+}
+
+size_t SteamSendScheduler::get_queued_bytes(uint64_t p_steam_id) const {
+	for (size_t i = 0; i < peers.size(); i++) {
+		if (peers[i].steam_id == p_steam_id) {
+			return peers[i].queued_bytes;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,129 @@
+/*************************************************************************/
+/*  steam_send_scheduler.h                                               */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_SEND_SCHEDULER_H
+#define STEAM_SEND_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Reliable messages Steam rejects are retried on later flushes, this many times.
+#define STEAM_SCHEDULER_MAX_SEND_ATTEMPTS 8
+
+// Holds outgoing messages per peer and releases them once per tick within a
+// token bucket bandwidth budget. Messages go out by priority class, and
+// every aging interval a message waits raises it one class, so low priority
+// traffic is delayed under congestion but never starved. Unreliable messages
+// that wait too long, or that don't fit in the peer's queue, are dropped,
+// lowest priority first. Reliable messages are only ever deferred.
+class SteamSendScheduler {
+public:
+	enum Priority {
+		PRIORITY_CRITICAL,
+		PRIORITY_HIGH,
+		PRIORITY_NORMAL,
+		PRIORITY_LOW,
+		PRIORITY_MAX,
+	};
+
+	struct Message {
+		uint64_t steam_id = 0;
+		int channel = 0;
+		int send_type = 0;
+		bool reliable = false;
+		int attempts = 0;
+		uint64_t queued_usec = 0;
+		std::vector<uint8_t> data;
+	};
+
+	// Called with every released message, returns whether it was sent.
+	typedef bool (*SendFunc)(void *p_userdata, const Message &p_message);
+
+private:
+	struct Peer {
+		uint64_t steam_id = 0;
+		// 0 uses the default budget.
+		uint32_t rate = 0;
+		uint32_t burst = 0;
+		double tokens = 0.0;
+		uint64_t refill_usec = 0;
+		size_t queued_bytes = 0;
+		std::deque<Message> queues[PRIORITY_MAX];
+	};
+
+	std::vector<Peer> peers;
+	std::vector<std::vector<uint8_t>> spare_buffers;
+	uint32_t default_rate = 64 * 1024;
+	uint32_t default_burst = 16 * 1024;
+	uint64_t aging_usec = 50000;
+	uint64_t max_unreliable_age_usec = 200000;
+	size_t max_queued_bytes = 256 * 1024;
+	uint64_t dropped = 0;
+	uint64_t failed = 0;
+	SendFunc send_func = nullptr;
+	void *send_userdata = nullptr;
+
+	Peer &get_peer(uint64_t p_steam_id, uint64_t p_now_usec);
+	void refill(Peer &p_peer, uint64_t p_now_usec);
+	void release(Peer &p_peer, int p_priority, size_t p_index);
+	bool drop_unreliable(Peer &p_peer, int p_min_priority);
+	int flush_peer(Peer &p_peer, uint64_t p_now_usec, bool p_unlimited);
+
+public:
+	void set_send_func(SendFunc p_func, void *p_userdata);
+	void set_default_rate(uint32_t p_bytes_per_second, uint32_t p_burst_bytes);
+	// Overrides the budget for one peer, a rate of 0 goes back to the default.
+	void set_peer_rate(uint64_t p_steam_id, uint32_t p_bytes_per_second, uint32_t p_burst_bytes);
+	void set_aging_usec(uint64_t p_usec) { aging_usec = p_usec > 0 ? p_usec : 1; }
+	void set_max_unreliable_age_usec(uint64_t p_usec) { max_unreliable_age_usec = p_usec; }
+	void set_max_queued_bytes(size_t p_bytes) { max_queued_bytes = p_bytes; }
+	uint32_t get_default_rate() const { return default_rate; }
+
+	// Returns false if the message was dropped to make room.
+	bool queue(uint64_t p_steam_id, int p_channel, int p_send_type, bool p_reliable, int p_priority, const uint8_t *p_data, uint32_t p_size, uint64_t p_now_usec);
+	// Releases what each peer's budget allows. Returns the messages sent.
+	int flush(uint64_t p_now_usec);
+	// Sends everything queued regardless of budget.
+	int drain(uint64_t p_now_usec);
+	void remove_peer(uint64_t p_steam_id);
+	void clear();
+
+	size_t get_queued_bytes() const;
+	size_t get_queued_bytes(uint64_t p_steam_id) const;
+	uint64_t get_dropped_count() const { return dropped; }
+	// Messages Steam rejected and that were given up on.
+	uint64_t get_failed_count() const { return failed; }
+};
+
+#endif // ! STEAM_SEND_SCHEDULER_H
@@ -0,0 +1,363 @@
+/*************************************************************************/
+/*  steam_snapshot_replicator.cpp                                        */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_snapshot_replicator.h"
+
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+#include <godot_cpp/core/object.hpp>
+
+#include <cstring>
+
+#include "steam_delta_codec.h"
+#include "steam_send_coalescer.h"
+
+using namespace godot;
+
+// [type u8][sequence u32] then the snapshot (full) or
+// [baseline u32][size varint][delta] (delta). Acks are [type u8][sequence u32].
+#define SNAPSHOT_HEADER_SIZE 5
+#define SNAPSHOT_DELTA_HEADER_SIZE 9
+
+static void write_u32(uint8_t *r_buffer, uint32_t p_value) {
+	r_buffer[0] = p_value & 0xFF;
+	r_buffer[1] = (p_value >> 8) & 0xFF;
+	r_buffer[2] = (p_value >> 16) & 0xFF;
+	r_buffer[3] = p_value >> 24;
+}
+
+static uint32_t read_u32(const uint8_t *p_buffer) {
+	return p_buffer[0] | (p_buffer[1] << 8) | (p_buffer[2] << 16) | ((uint32_t)p_buffer[3] << 24);
+}
+
+// Sequence comparison that survives wrapping.
+static bool sequence_newer(uint32_t p_a, uint32_t p_b) {
+	return (int32_t)(p_a - p_b) > 0;
+}
+
+void SteamSnapshotReplicator::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_steam", "steam"), &SteamSnapshotReplicator::set_steam);
+	ClassDB::bind_method(D_METHOD("get_steam"), &SteamSnapshotReplicator::get_steam);
+	ClassDB::bind_method(D_METHOD("set_data_channel", "channel"), &SteamSnapshotReplicator::set_data_channel);
+	ClassDB::bind_method(D_METHOD("get_data_channel"), &SteamSnapshotReplicator::get_data_channel);
+	ClassDB::bind_method(D_METHOD("set_ack_channel", "channel"), &SteamSnapshotReplicator::set_ack_channel);
+	ClassDB::bind_method(D_METHOD("get_ack_channel"), &SteamSnapshotReplicator::get_ack_channel);
+	ClassDB::bind_method(D_METHOD("set_send_type", "send_type"), &SteamSnapshotReplicator::set_send_type);
+	ClassDB::bind_method(D_METHOD("get_send_type"), &SteamSnapshotReplicator::get_send_type);
+	ClassDB::bind_method(D_METHOD("set_history_size", "size"), &SteamSnapshotReplicator::set_history_size);
+	ClassDB::bind_method(D_METHOD("get_history_size"), &SteamSnapshotReplicator::get_history_size);
+	ClassDB::bind_method(D_METHOD("set_max_snapshot_size", "size"), &SteamSnapshotReplicator::set_max_snapshot_size);
+	ClassDB::bind_method(D_METHOD("get_max_snapshot_size"), &SteamSnapshotReplicator::get_max_snapshot_size);
+	ClassDB::bind_method(D_METHOD("send_snapshot", "steam_id_remote", "snapshot"), &SteamSnapshotReplicator::send_snapshot);
+	ClassDB::bind_method(D_METHOD("poll"), &SteamSnapshotReplicator::poll);
+	ClassDB::bind_method(D_METHOD("get_latest_snapshot", "steam_id_remote"), &SteamSnapshotReplicator::get_latest_snapshot);
+	ClassDB::bind_method(D_METHOD("remove_peer", "steam_id_remote"), &SteamSnapshotReplicator::remove_peer);
+	ClassDB::bind_method(D_METHOD("clear"), &SteamSnapshotReplicator::clear);
+	ClassDB::bind_method(D_METHOD("get_stats"), &SteamSnapshotReplicator::get_stats);
+
+	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "steam", PROPERTY_HINT_NODE_TYPE, "Steam"), "set_steam", "get_steam");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "data_channel"), "set_data_channel", "get_data_channel");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "ack_channel"), "set_ack_channel", "get_ack_channel");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "send_type"), "set_send_type", "get_send_type");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "history_size"), "set_history_size", "get_history_size");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "max_snapshot_size"), "set_max_snapshot_size", "get_max_snapshot_size");
+
+	ADD_SIGNAL(MethodInfo("snapshot_received", PropertyInfo(Variant::INT, "steam_id_remote"), PropertyInfo(Variant::INT, "sequence"), PropertyInfo(Variant::PACKED_BYTE_ARRAY, "snapshot")));
+}
+
+// Setup
+void SteamSnapshotReplicator::set_steam(Steam *steam) {
+	steam_object = steam ? ObjectID(steam->get_instance_id()) : ObjectID();
+}
+
+Steam *SteamSnapshotReplicator::get_steam() const {
+	return Object::cast_to<Steam>(ObjectDB::get_instance(steam_object));
+}
+
+void SteamSnapshotReplicator::set_data_channel(int channel) {
+	data_channel = channel;
+}
+
+int SteamSnapshotReplicator::get_data_channel() const {
+	return data_channel;
+}
+
+void SteamSnapshotReplicator::set_ack_channel(int channel) {
+	ack_channel = channel;
+}
+
+int SteamSnapshotReplicator::get_ack_channel() const {
+	return ack_channel;
+}
+
+// Snapshots over 1200 bytes need an unreliable send type with
+// Steam.set_p2p_fragmentation() enabled, or a reliable one.
+void SteamSnapshotReplicator::set_send_type(int type) {
+	send_type = type;
+}
+
+int SteamSnapshotReplicator::get_send_type() const {
+	return send_type;
+}
+
+// How many sent snapshots wait for an ack, and how many received ones are
+// kept as possible baselines. Must match on both ends.
+void SteamSnapshotReplicator::set_history_size(int size) {
+	ERR_FAIL_COND_MSG(!peers.empty(), "The history size can't be changed while peers are tracked.");
+	history_size = MAX(size, 1);
+}
+
+int SteamSnapshotReplicator::get_history_size() const {
+	return history_size;
+}
+
+// Larger snapshots aren't sent, and received ones claiming a larger size are
+// dropped before anything is allocated for them. Must match on both ends.
+void SteamSnapshotReplicator::set_max_snapshot_size(int size) {
+	max_snapshot_size = MAX(size, 0);
+}
+
+int SteamSnapshotReplicator::get_max_snapshot_size() const {
+	return max_snapshot_size;
+}
+
+// Sending
+bool SteamSnapshotReplicator::send_snapshot(uint64_t steam_id_remote, const PackedByteArray &snapshot) {
+	Steam *steam = get_steam();
+	ERR_FAIL_NULL_V_MSG(steam, false, "No Steam object set.");
+	ERR_FAIL_COND_V_MSG(snapshot.size() > max_snapshot_size, false, "Snapshot is larger than max_snapshot_size.");
+	Peer &peer = peers[steam_id_remote];
+	uint32_t sequence = peer.next_sequence++;
+	uint32_t size = snapshot.size();
+	const uint8_t *data = snapshot.ptr();
+
+	packet_buffer.clear();
+	bool delta = peer.has_baseline && (int64_t)(sequence - peer.baseline.sequence) < history_size;
+	if (delta) {
+		packet_buffer.resize(SNAPSHOT_DELTA_HEADER_SIZE);
+		packet_buffer[0] = PACKET_DELTA;
+		write_u32(packet_buffer.data() + 1, sequence);
+		write_u32(packet_buffer.data() + 5, peer.baseline.sequence);
+		uint8_t varint[5];
+		packet_buffer.insert(packet_buffer.end(), varint, varint + SteamSendCoalescer::encode_varint(size, varint));
+		SteamDeltaCodec::encode(peer.baseline.data.data(), peer.baseline.data.size(), data, size, packet_buffer);
+		// Nothing gained on a snapshot that changed completely.
+		delta = packet_buffer.size() < SNAPSHOT_HEADER_SIZE + size;
+	}
+	if (!delta) {
+		packet_buffer.resize(SNAPSHOT_HEADER_SIZE + size);
+		packet_buffer[0] = PACKET_FULL;
+		write_u32(packet_buffer.data() + 1, sequence);
+		if (size > 0) {
+			memcpy(packet_buffer.data() + SNAPSHOT_HEADER_SIZE, data, size);
+		}
+		full_snapshots_sent++;
+	}
+
+	Snapshot sent;
+	sent.sequence = sequence;
+	sent.data.assign(data, data + size);
+	peer.sent.push_back(std::move(sent));
+	while ((int)peer.sent.size() > history_size) {
+		peer.sent.pop_front();
+	}
+
+	PackedByteArray packet;
+	packet.resize(packet_buffer.size());
+	memcpy(packet.ptrw(), packet_buffer.data(), packet_buffer.size());
+	snapshots_sent++;
+	raw_bytes += size;
+	encoded_bytes += packet_buffer.size();
+	return steam->send_p2p_packet(steam_id_remote, packet, send_type, data_channel);
+}
+
+void SteamSnapshotReplicator::handle_ack(uint64_t steam_id, const uint8_t *data, uint32_t size) {
+	std::unordered_map<uint64_t, Peer>::iterator it = peers.find(steam_id);
+	if (it == peers.end() || size < SNAPSHOT_HEADER_SIZE || data[0] != PACKET_ACK) {
+		return;
+	}
+	Peer &peer = it->second;
+	uint32_t sequence = read_u32(data + 1);
+	if (peer.has_baseline && !sequence_newer(sequence, peer.baseline.sequence)) {
+		return;
+	}
+	while (!peer.sent.empty() && !sequence_newer(peer.sent.front().sequence, sequence)) {
+		if (peer.sent.front().sequence == sequence) {
+			peer.baseline = std::move(peer.sent.front());
+			peer.has_baseline = true;
+		}
+		peer.sent.pop_front();
+	}
+}
+
+// Receiving
+const SteamSnapshotReplicator::Snapshot *SteamSnapshotReplicator::find_snapshot(const std::deque<Snapshot> &history, uint32_t sequence) const {
+	for (std::deque<Snapshot>::const_reverse_iterator it = history.rbegin(); it != history.rend(); ++it) {
+		if (it->sequence == sequence) {
+			return &*it;
+		}
+	}
+	return nullptr;
+}
+
+// A peer is only tracked once one of its snapshots decoded, stray packets
+// on the data channel leave nothing behind.
+void SteamSnapshotReplicator::handle_snapshot(uint64_t steam_id, const uint8_t *data, uint32_t size) {
+	if (size < SNAPSHOT_HEADER_SIZE || data[0] > PACKET_DELTA) {
+		return;
+	}
+	std::unordered_map<uint64_t, Peer>::iterator it = peers.find(steam_id);
+	Peer *known = it != peers.end() ? &it->second : nullptr;
+	uint32_t sequence = read_u32(data + 1);
+	if (known && find_snapshot(known->received, sequence)) {
+		// Duplicate, the ack for it may have been lost though.
+		known->ack_pending = true;
+		known->ack_sequence = sequence;
+		return;
+	}
+	if (data[0] == PACKET_FULL) {
+		if (size - SNAPSHOT_HEADER_SIZE > (uint32_t)max_snapshot_size) {
+			snapshots_dropped++;
+			return;
+		}
+		decode_buffer.assign(data + SNAPSHOT_HEADER_SIZE, data + size);
+	} else {
+		uint32_t total_size = 0;
+		size_t used = size > SNAPSHOT_DELTA_HEADER_SIZE ? SteamSendCoalescer::decode_varint(data + SNAPSHOT_DELTA_HEADER_SIZE, size - SNAPSHOT_DELTA_HEADER_SIZE, &total_size) : 0;
+		const Snapshot *baseline = known ? find_snapshot(known->received, read_u32(data + 5)) : nullptr;
+		uint32_t offset = SNAPSHOT_DELTA_HEADER_SIZE + used;
+		if (used == 0 || !baseline || total_size > (uint32_t)max_snapshot_size || !SteamDeltaCodec::decode(baseline->data.data(), baseline->data.size(), data + offset, size - offset, total_size, decode_buffer)) {
+			snapshots_dropped++;
+			return;
+		}
+	}
+	Peer &peer = known ? *known : peers[steam_id];
+	snapshots_received++;
+
+	Snapshot received;
+	received.sequence = sequence;
+	received.data = decode_buffer;
+	peer.received.push_back(std::move(received));
+	while ((int)peer.received.size() > history_size) {
+		peer.received.pop_front();
+	}
+	if (!peer.ack_pending || sequence_newer(sequence, peer.ack_sequence)) {
+		peer.ack_pending = true;
+		peer.ack_sequence = sequence;
+	}
+	if (peer.has_delivered && !sequence_newer(sequence, peer.last_delivered)) {
+		// Arrived late, it is only kept as a baseline.
+		return;
+	}
+	peer.has_delivered = true;
+	peer.last_delivered = sequence;
+	PackedByteArray snapshot;
+	snapshot.resize(decode_buffer.size());
+	if (!decode_buffer.empty()) {
+		memcpy(snapshot.ptrw(), decode_buffer.data(), decode_buffer.size());
+	}
+	emit_signal("snapshot_received", steam_id, sequence, snapshot);
+}
+
+// Reads everything pending on both channels. Only the newest snapshot of a
+// peer is acked per poll, an ack covers every older one too.
+void SteamSnapshotReplicator::poll() {
+	Steam *steam = get_steam();
+	ERR_FAIL_NULL_MSG(steam, "No Steam object set.");
+	Dictionary acks = steam->read_p2p_packets(ack_channel, 0);
+	PackedByteArray ack_data = acks["data"];
+	PackedInt64Array ack_senders = acks["steam_id_remote"];
+	PackedInt32Array ack_offsets = acks["offsets"];
+	PackedInt32Array ack_sizes = acks["sizes"];
+	for (int i = 0; i < ack_sizes.size(); i++) {
+		handle_ack(ack_senders[i], ack_data.ptr() + ack_offsets[i], ack_sizes[i]);
+	}
+
+	Dictionary snapshots = steam->read_p2p_packets(data_channel, 0);
+	PackedByteArray data = snapshots["data"];
+	PackedInt64Array senders = snapshots["steam_id_remote"];
+	PackedInt32Array offsets = snapshots["offsets"];
+	PackedInt32Array sizes = snapshots["sizes"];
+	for (int i = 0; i < sizes.size(); i++) {
+		handle_snapshot(senders[i], data.ptr() + offsets[i], sizes[i]);
+	}
+
+	PackedByteArray ack;
+	ack.resize(SNAPSHOT_HEADER_SIZE);
+	for (std::unordered_map<uint64_t, Peer>::iterator it = peers.begin(); it != peers.end(); ++it) {
+		if (!it->second.ack_pending) {
+			continue;
+		}
+		ack.set(0, PACKET_ACK);
+		write_u32(ack.ptrw() + 1, it->second.ack_sequence);
+		// Late acks inflate every following delta, keep them ahead of bulk data.
+		steam->send_p2p_packet(it->first, ack, k_EP2PSendUnreliable, ack_channel, Steam::P2P_PRIORITY_HIGH);
+		it->second.ack_pending = false;
+	}
+}
+
+PackedByteArray SteamSnapshotReplicator::get_latest_snapshot(uint64_t steam_id_remote) const {
+	PackedByteArray snapshot;
+	std::unordered_map<uint64_t, Peer>::const_iterator it = peers.find(steam_id_remote);
+	if (it == peers.end() || !it->second.has_delivered) {
+		return snapshot;
+	}
+	const Snapshot *latest = find_snapshot(it->second.received, it->second.last_delivered);
+	if (latest) {
+		snapshot.resize(latest->data.size());
+		if (!latest->data.empty()) {
+			memcpy(snapshot.ptrw(), latest->data.data(), latest->data.size());
+		}
+	}
+	return snapshot;
+}
+
+void SteamSnapshotReplicator::remove_peer(uint64_t steam_id_remote) {
+	peers.erase(steam_id_remote);
+}
+
+void SteamSnapshotReplicator::clear() {
+	peers.clear();
+}
+
+// "raw_bytes" against "encoded_bytes" is the compression achieved.
+Dictionary SteamSnapshotReplicator::get_stats() const {
+	Dictionary stats;
+	stats["snapshots_sent"] = snapshots_sent;
+	stats["full_snapshots_sent"] = full_snapshots_sent;
+	stats["snapshots_received"] = snapshots_received;
+	stats["snapshots_dropped"] = snapshots_dropped;
+	stats["raw_bytes"] = raw_bytes;
+	stats["encoded_bytes"] = encoded_bytes;
+	stats["peers"] = (int64_t)peers.size();
+	return stats;
+}
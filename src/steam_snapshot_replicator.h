@@ -0,0 +1,129 @@
+/*************************************************************************/
+/*  steam_snapshot_replicator.h                                          */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_SNAPSHOT_REPLICATOR_H
+#define STEAM_SNAPSHOT_REPLICATOR_H
+
+#include <godot_cpp/classes/ref_counted.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "steam.h"
+
+using namespace godot;
+
+// Sends state snapshots as deltas against the last snapshot the peer
+// acknowledged, over a Steam object's P2P functions. Snapshots go out on
+// `data_channel`, acks come back on `ack_channel`. Call poll() every frame
+// to process both. A delta is only made against a baseline the receiver
+// confirmed, so lost snapshots never break decoding. Full snapshots are sent
+// until the first ack and whenever the baseline falls out of the history.
+class SteamSnapshotReplicator : public RefCounted {
+	GDCLASS(SteamSnapshotReplicator, RefCounted);
+
+	enum PacketType {
+		PACKET_FULL,
+		PACKET_DELTA,
+		PACKET_ACK,
+	};
+
+	struct Snapshot {
+		uint32_t sequence = 0;
+		std::vector<uint8_t> data;
+	};
+
+	struct Peer {
+		// Sending
+		uint32_t next_sequence = 1;
+		bool has_baseline = false;
+		Snapshot baseline;
+		std::deque<Snapshot> sent;
+		// Receiving
+		std::deque<Snapshot> received;
+		bool has_delivered = false;
+		uint32_t last_delivered = 0;
+		bool ack_pending = false;
+		uint32_t ack_sequence = 0;
+	};
+
+private:
+	ObjectID steam_object;
+	int data_channel = 0;
+	int ack_channel = 1;
+	int send_type = k_EP2PSendUnreliable;
+	int history_size = 32;
+	int max_snapshot_size = 1024 * 1024;
+
+	std::unordered_map<uint64_t, Peer> peers;
+	std::vector<uint8_t> packet_buffer;
+	std::vector<uint8_t> decode_buffer;
+
+	uint64_t snapshots_sent = 0;
+	uint64_t full_snapshots_sent = 0;
+	uint64_t snapshots_received = 0;
+	uint64_t snapshots_dropped = 0;
+	uint64_t raw_bytes = 0;
+	uint64_t encoded_bytes = 0;
+
+	void handle_ack(uint64_t steam_id, const uint8_t *data, uint32_t size);
+	void handle_snapshot(uint64_t steam_id, const uint8_t *data, uint32_t size);
+	const Snapshot *find_snapshot(const std::deque<Snapshot> &history, uint32_t sequence) const;
+
+protected:
+	static void _bind_methods();
+
+public:
+	void set_steam(Steam *steam);
+	Steam *get_steam() const;
+	void set_data_channel(int channel);
+	int get_data_channel() const;
+	void set_ack_channel(int channel);
+	int get_ack_channel() const;
+	void set_send_type(int type);
+	int get_send_type() const;
+	void set_history_size(int size);
+	int get_history_size() const;
+	void set_max_snapshot_size(int size);
+	int get_max_snapshot_size() const;
+
+	bool send_snapshot(uint64_t steam_id_remote, const PackedByteArray &snapshot);
+	void poll();
+	PackedByteArray get_latest_snapshot(uint64_t steam_id_remote) const;
+	void remove_peer(uint64_t steam_id_remote);
+	void clear();
+	Dictionary get_stats() const;
+};
+
+#endif // ! STEAM_SNAPSHOT_REPLICATOR_H
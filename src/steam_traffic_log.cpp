@@ -0,0 +1,236 @@
+/*************************************************************************/
+/*  steam_traffic_log.cpp                                                */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#include "steam_traffic_log.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const char traffic_log_magic[4] = { 'G', 'S', 'T', 'L' };
+static const size_t traffic_log_header_size = 5;
+static const size_t traffic_log_flush_size = 64 * 1024;
+
+size_t SteamTrafficRecorder::encode_varint(uint64_t p_value, uint8_t *r_buffer) {
+	size_t size = 0;
+	while (p_value >= 0x80) {
+		r_buffer[size++] = (uint8_t)(p_value | 0x80);
+		p_value >>= 7;
+	}
+	r_buffer[size++] = (uint8_t)p_value;
+	return size;
+}
+
+size_t SteamTrafficRecorder::decode_varint(const uint8_t *p_buffer, size_t p_size, uint64_t *r_value) {
+	uint64_t value = 0;
+	for (size_t i = 0; i < p_size && i < 10; i++) {
+		value |= (uint64_t)(p_buffer[i] & 0x7F) << (7 * i);
+		if (!(p_buffer[i] & 0x80)) {
+			*r_value = value;
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+bool SteamTrafficRecorder::open(const String &p_path, uint64_t p_now_usec) {
+	close();
+	std::lock_guard<std::mutex> lock(mutex);
+	file = FileAccess::open(p_path, FileAccess::WRITE);
+	if (file.is_null()) {
+		return false;
+	}
+	buffer.clear();
+	buffer.reserve(traffic_log_flush_size * 2);
+	buffer.insert(buffer.end(), traffic_log_magic, traffic_log_magic + sizeof(traffic_log_magic));
+	buffer.push_back(STEAM_TRAFFIC_LOG_VERSION);
+	last_usec = p_now_usec;
+	record_count = 0;
+	return true;
+}
+
+void SteamTrafficRecorder::write_buffer() {
+	if (!buffer.empty()) {
+		chunk.resize(buffer.size());
+		memcpy(chunk.ptrw(), buffer.data(), buffer.size());
+		file->store_buffer(chunk);
+		buffer.clear();
+	}
+}
+
+void SteamTrafficRecorder::close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (file.is_null()) {
+		return;
+	}
+	write_buffer();
+	chunk = PackedByteArray();
+	file.unref();
+}
+
+void SteamTrafficRecorder::record(SteamTrafficDirection p_direction, uint64_t p_now_usec, uint64_t p_steam_id, int p_channel, int p_send_type, const void *p_data, uint32_t p_size) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (file.is_null()) {
+		return;
+	}
+	// Send and receive threads can race on the clock, never go backwards.
+	uint64_t delta = p_now_usec > last_usec ? p_now_usec - last_usec : 0;
+	last_usec += delta;
+	size_t offset = buffer.size();
+	buffer.resize(offset + 1 + 10 + 8 + 5 + 1 + 5 + p_size);
+	uint8_t *out = buffer.data() + offset;
+	size_t written = 0;
+	out[written++] = (uint8_t)p_direction;
+	written += encode_varint(delta, out + written);
+	for (int i = 0; i < 8; i++) {
+		out[written++] = (uint8_t)(p_steam_id >> (8 * i));
+	}
+	written += encode_varint((uint32_t)p_channel, out + written);
+	out[written++] = (uint8_t)p_send_type;
+	written += encode_varint(p_size, out + written);
+	if (p_size > 0) {
+		memcpy(out + written, p_data, p_size);
+	}
+	buffer.resize(offset + written + p_size);
+	record_count++;
+	if (buffer.size() >= traffic_log_flush_size) {
+		write_buffer();
+	}
+}
+
+SteamTrafficRecorder::~SteamTrafficRecorder() {
+	close();
+}
+
+bool SteamTrafficReplay::open(const String &p_path, double p_speed, uint64_t p_now_usec) {
+	close();
+	data = FileAccess::get_file_as_bytes(p_path);
+	if (data.size() < (int64_t)traffic_log_header_size || memcmp(data.ptr(), traffic_log_magic, sizeof(traffic_log_magic)) != 0 || data[4] != STEAM_TRAFFIC_LOG_VERSION) {
+		close();
+		return false;
+	}
+	// Index the received packets per channel, a truncated tail is ignored.
+	size_t offset = traffic_log_header_size;
+	uint64_t time_usec = 0;
+	size_t data_size = data.size();
+	while (offset < data_size) {
+		const uint8_t *in = data.ptr() + offset;
+		size_t left = data_size - offset;
+		size_t used = 1;
+		uint64_t delta = 0, channel = 0, size = 0;
+		size_t length = SteamTrafficRecorder::decode_varint(in + used, left - used, &delta);
+		if (length == 0 || (used += length) + 8 > left) {
+			break;
+		}
+		uint64_t steam_id = 0;
+		for (int i = 0; i < 8; i++) {
+			steam_id |= (uint64_t)in[used++] << (8 * i);
+		}
+		length = SteamTrafficRecorder::decode_varint(in + used, left - used, &channel);
+		if (length == 0 || (used += length) + 1 > left) {
+			break;
+		}
+		used++;
+		length = SteamTrafficRecorder::decode_varint(in + used, left - used, &size);
+		if (length == 0 || (used += length) + size > left) {
+			break;
+		}
+		if (channel >= STEAM_TRAFFIC_MAX_CHANNELS) {
+			close();
+			return false;
+		}
+		time_usec += delta;
+		if (in[0] == STEAM_TRAFFIC_RECEIVED) {
+			Packet packet;
+			packet.time_usec = time_usec;
+			packet.steam_id = steam_id;
+			packet.offset = offset + used;
+			packet.size = (uint32_t)size;
+			if (channel >= channels.size()) {
+				channels.resize(channel + 1);
+			}
+			channels[channel].push_back(packets.size());
+			packets.push_back(packet);
+		}
+		offset += used + size;
+	}
+	cursors.assign(channels.size(), 0);
+	start_usec = p_now_usec;
+	speed = std::max(p_speed, 0.0);
+	remaining = packets.size();
+	active = true;
+	return true;
+}
+
+void SteamTrafficReplay::close() {
+	data = PackedByteArray();
+	packets.clear();
+	channels.clear();
+	cursors.clear();
+	remaining = 0;
+	active = false;
+}
+
+const SteamTrafficReplay::Packet *SteamTrafficReplay::peek(int p_channel, uint64_t p_now_usec) const {
+	if (!active || p_channel < 0 || p_channel >= (int)channels.size() || cursors[p_channel] >= channels[p_channel].size()) {
+		return nullptr;
+	}
+	const Packet &packet = packets[channels[p_channel][cursors[p_channel]]];
+	if (speed > 0.0 && (double)(p_now_usec - start_usec) * speed < (double)packet.time_usec) {
+		return nullptr;
+	}
+	return &packet;
+}
+
+bool SteamTrafficReplay::is_packet_available(int p_channel, uint64_t p_now_usec, uint32_t *r_size) const {
+	const Packet *packet = peek(p_channel, p_now_usec);
+	if (!packet) {
+		return false;
+	}
+	*r_size = packet->size;
+	return true;
+}
+
+bool SteamTrafficReplay::read_packet(int p_channel, uint64_t p_now_usec, void *r_buffer, uint32_t p_size, uint32_t *r_read, uint64_t *r_steam_id) {
+	const Packet *packet = peek(p_channel, p_now_usec);
+	if (!packet) {
+		return false;
+	}
+	uint32_t size = std::min(p_size, packet->size);
+	if (size > 0) {
+		memcpy(r_buffer, data.ptr() + packet->offset, size);
+	}
+	*r_read = size;
+	*r_steam_id = packet->steam_id;
+	cursors[p_channel]++;
+	remaining--;
+	return true;
+}
@@ -0,0 +1,122 @@
+/*************************************************************************/
+/*  steam_traffic_log.h                                                  */
+/*************************************************************************/
+/*                       This file is part of:                           */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2007-2022 Juan Linietsky, Ariel Manzur.                 */
+/* Copyright (c) 2014-2022 Godot Engine contributors (cf. AUTHORS.md).   */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+
+
+
+#ifndef STEAM_TRAFFIC_LOG_H
+#define STEAM_TRAFFIC_LOG_H
+
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+using namespace godot;
+
+// A capture starts with "GSTL" and a version byte, followed by one record
+// per packet on the wire:
+// [direction u8][usec since previous record varint][steam id u64]
+// [channel varint][send type u8][size varint][payload]
+#define STEAM_TRAFFIC_LOG_VERSION 1
+// Captures using higher channels are refused on replay.
+#define STEAM_TRAFFIC_MAX_CHANNELS 256
+
+enum SteamTrafficDirection {
+	STEAM_TRAFFIC_SENT,
+	STEAM_TRAFFIC_RECEIVED,
+};
+
+// Appends packets to a capture file. Records are built in memory and written
+// in large chunks, so recording a packet costs a copy and a lock.
+class SteamTrafficRecorder {
+	std::mutex mutex;
+	Ref<FileAccess> file;
+	std::vector<uint8_t> buffer;
+	PackedByteArray chunk;
+	uint64_t last_usec = 0;
+	uint64_t record_count = 0;
+
+	void write_buffer();
+
+public:
+	static size_t encode_varint(uint64_t p_value, uint8_t *r_buffer);
+	// Returns the number of bytes consumed, 0 if the varint is truncated.
+	static size_t decode_varint(const uint8_t *p_buffer, size_t p_size, uint64_t *r_value);
+
+	bool open(const String &p_path, uint64_t p_now_usec);
+	void close();
+	bool is_open() const { return file.is_valid(); }
+	uint64_t get_record_count() const { return record_count; }
+
+	void record(SteamTrafficDirection p_direction, uint64_t p_now_usec, uint64_t p_steam_id, int p_channel, int p_send_type, const void *p_data, uint32_t p_size);
+
+	~SteamTrafficRecorder();
+};
+
+// Plays the received packets of a capture back, per channel, at the recorded
+// pace scaled by `speed`. A speed of 0 makes every packet available at once.
+class SteamTrafficReplay {
+	struct Packet {
+		uint64_t time_usec = 0;
+		uint64_t steam_id = 0;
+		size_t offset = 0;
+		uint32_t size = 0;
+	};
+
+	PackedByteArray data;
+	std::vector<Packet> packets;
+	std::vector<std::vector<uint32_t>> channels;
+	std::vector<size_t> cursors;
+	uint64_t start_usec = 0;
+	double speed = 1.0;
+	size_t remaining = 0;
+	bool active = false;
+
+	const Packet *peek(int p_channel, uint64_t p_now_usec) const;
+
+public:
+	// Fails if the file can't be read, isn't a capture or uses a channel past
+	// STEAM_TRAFFIC_MAX_CHANNELS.
+	bool open(const String &p_path, double p_speed, uint64_t p_now_usec);
+	void close();
+	bool is_active() const { return active; }
+	// Packets not read back yet.
+	size_t get_remaining() const { return remaining; }
+
+	bool is_packet_available(int p_channel, uint64_t p_now_usec, uint32_t *r_size) const;
+	// Packets larger than p_size are truncated, like ReadP2PPacket would.
+	bool read_packet(int p_channel, uint64_t p_now_usec, void *r_buffer, uint32_t p_size, uint32_t *r_read, uint64_t *r_steam_id);
+};
+
+#endif // ! STEAM_TRAFFIC_LOG_H